@@ -13,17 +13,33 @@ extern "C" {
     void _panic();
     void _outb(uint16_t addr, uint8_t data);
     uint8_t _inb(uint16_t addr);
+    void _insw(uint16_t addr, void *buffer, uint32_t count);
+    void _outsw(uint16_t addr, const void *buffer, uint32_t count);
     void _load_gdt(uint32_t addr);
     void _io_wait();
     void _load_idt(uint32_t);
     void _enable_interrupts();
     void _disable_interrupts();
+    void _interrupt_window();
     void _enable_paging();
     void _disable_paging();
     void _load_page_dir(uint32_t addr);
     void _flush_tlb(uint32_t addr);
     void _tss_flush(uint32_t addr);
     uint32_t _get_page_dir();
+    uint32_t _get_cr2();
+    void _pause();
+    uint32_t _get_cr0();
+    void _set_cr0(uint32_t value);
+    uint32_t _get_cr4();
+    void _set_cr4(uint32_t value);
+    uint32_t _cpuid_edx(uint32_t leaf);
+    uint64_t _rdtsc();
+    void _clts();
+    void _fninit();
+    void _fxsave(void *area);
+    void _fxrstor(void *area);
+    void _ldmxcsr(uint32_t value);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef _APIC_H_
+#define _APIC_H_
+
+#include <stdint.h>
+
+// https://wiki.osdev.org/APIC
+// https://wiki.osdev.org/APIC_timer
+
+#define LAPIC_DEFAULT_PHYS_ADDR  0xFEE00000
+#define LAPIC_VIRT_ADDR          0xC03FF000 // the very last page of the kernel's 4MB (page table 768)
+
+#define LAPIC_REG_ID             0x020      // local APIC ID
+#define LAPIC_REG_TPR            0x080      // task priority
+#define LAPIC_REG_EOI            0x0B0      // end of interrupt
+#define LAPIC_REG_SPURIOUS       0x0F0      // spurious interrupt vector
+#define LAPIC_REG_ICR_LOW        0x300      // interrupt command register (bits [0-31])
+#define LAPIC_REG_ICR_HIGH       0x310      // interrupt command register (bits [32-63])
+#define LAPIC_REG_LVT_TIMER      0x320      // local vector table - timer
+#define LAPIC_REG_TIMER_INITIAL  0x380      // timer initial count
+#define LAPIC_REG_TIMER_CURRENT  0x390      // timer current count
+#define LAPIC_REG_TIMER_DIVIDE   0x3E0      // timer divide configuration
+
+#define LAPIC_SOFTWARE_ENABLE    (1 << 8)
+#define LAPIC_TIMER_PERIODIC     (1 << 17)
+#define LAPIC_TIMER_MASKED       (1 << 16)
+#define LAPIC_TIMER_DIVIDE_BY_16 0x3
+
+#define LAPIC_ICR_INIT           (5 << 8)
+#define LAPIC_ICR_STARTUP        (6 << 8)
+#define LAPIC_ICR_DELIVERY_PENDING (1 << 12)
+#define LAPIC_ICR_ASSERT         (1 << 14)
+#define LAPIC_ICR_LEVEL_TRIGGER  (1 << 15)
+
+#define LAPIC_TIMER_VECTOR       0x30
+#define LAPIC_TLB_FLUSH_VECTOR   0x31
+#define LAPIC_SPURIOUS_VECTOR    0xFF
+
+int LAPIC_init(uint32_t phys_addr);
+void LAPIC_enable();
+uint32_t LAPIC_get_id();
+void LAPIC_send_EOI();
+void LAPIC_send_INIT(uint32_t lapic_id);
+void LAPIC_send_SIPI(uint32_t lapic_id, uint8_t vector);
+void LAPIC_send_IPI(uint32_t lapic_id, uint8_t vector);
+void LAPIC_timer_init();
+
+#endif
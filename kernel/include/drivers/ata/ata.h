@@ -0,0 +1,42 @@
+#ifndef _ATA_H_
+#define _ATA_H_
+
+#include <stdint.h>
+
+// Port definitions of the primary bus (https://wiki.osdev.org/ATA_PIO_Mode)
+#define ATA_DATA_PORT         0x1F0
+#define ATA_ERROR_PORT        0x1F1
+#define ATA_SECTOR_COUNT_PORT 0x1F2
+#define ATA_LBA_LOW_PORT      0x1F3
+#define ATA_LBA_MID_PORT      0x1F4
+#define ATA_LBA_HIGH_PORT     0x1F5
+#define ATA_DRIVE_PORT        0x1F6
+#define ATA_COMMAND_PORT      0x1F7   // reads as the status register
+#define ATA_CONTROL_PORT      0x3F6   // reads as the alternate status register
+
+#define ATA_CMD_READ_SECTORS  0x20
+#define ATA_CMD_WRITE_SECTORS 0x30
+#define ATA_CMD_CACHE_FLUSH   0xE7
+#define ATA_CMD_IDENTIFY      0xEC
+
+#define ATA_STATUS_ERR        (1 << 0)
+#define ATA_STATUS_DRQ        (1 << 3)
+#define ATA_STATUS_DF         (1 << 5)
+#define ATA_STATUS_BSY        (1 << 7)
+
+#define ATA_CONTROL_NIEN      (1 << 1) // the drive does not raise IRQ14 (it's polled)
+#define ATA_DRIVE_MASTER      0xA0
+#define ATA_DRIVE_LBA         0xE0     // master + LBA addressing (the top 4 bits of the LBA are or'ed in)
+
+#define ATA_SECTOR_SIZE       512
+#define ATA_MAX_SECTORS       128      // sectors transferred by a single command
+#define ATA_MAX_LBA28         (1 << 28)
+#define ATA_TIMEOUT           1000000  // status polls before the drive is considered dead
+
+int ata_init();
+uint32_t ata_get_sector_count();
+int ata_read(uint32_t lba, uint32_t count, void *buffer);
+int ata_write(uint32_t lba, uint32_t count, const void *buffer);
+int ata_flush();
+
+#endif
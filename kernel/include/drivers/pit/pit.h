@@ -1,12 +1,26 @@
 #ifndef _PIT_H_
 #define _PIT_H_
 
+#include <stdint.h>
+
 // http://www.osdever.net/bkerndev/Docs/pit.htm
 
 #define PIT0_DATA   0x40 // PIT0 data register
+#define PIT2_DATA   0x42 // PIT2 data register (used for busy waiting)
 #define PIT_CMD     0x43 // PIT command register
 #define FREQUENCY   100  // 100Hz
 
+#define PIT_BASE_FREQUENCY 1193180 // 1.19MHz
+#define PIT_MAX_WAIT_US    50000   // the counter is only 16 bits long (~54ms)
+
+#define PIT2_GATE_PORT     0x61    // bit 0 = gate of PIT2, bit 1 = speaker, bit 5 = output of PIT2
+#define PIT2_GATE          (1 << 0)
+#define PIT2_SPEAKER       (1 << 1)
+#define PIT2_OUTPUT        (1 << 5)
+
 int PIT_init();
+void PIT_wait(uint32_t microseconds);
+void PIT_tick();
+uint32_t PIT_get_uptime_ms();
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,35 @@
+#ifndef _FPU_H_
+#define _FPU_H_
+
+#include <stdint.h>
+#include <processes/process.h>
+
+// https://wiki.osdev.org/FPU
+// https://wiki.osdev.org/SSE
+
+#define FXSAVE_AREA_SIZE      512
+#define FXSAVE_AREA_ALIGNMENT 16
+#define MXCSR_DEFAULT         0x1F80    // all SIMD exceptions masked, round to nearest
+
+#define CR0_MP_BIT            (1 << 1)  // WAIT/FWAIT respects CR0.TS
+#define CR0_EM_BIT            (1 << 2)  // no FPU present (every FPU instruction raises #NM)
+#define CR0_TS_BIT            (1 << 3)  // task switched (the first FPU instruction raises #NM)
+#define CR0_NE_BIT            (1 << 5)  // report x87 exceptions natively (int 0x10)
+
+#define CR4_OSFXSR_BIT        (1 << 9)  // the OS supports FXSAVE/FXRSTOR (enables SSE)
+#define CR4_OSXMMEXCPT_BIT    (1 << 10) // the OS handles SIMD exceptions (int 0x13)
+
+#define CPUID_FEATURES        1
+#define CPUID_EDX_FXSR        (1 << 24)
+#define CPUID_EDX_SSE         (1 << 25)
+
+#define FPU_NO_CPU            0xFFFFFFFF
+
+int FPU_init();
+void FPU_init_process(PCB_t *pcb);
+void FPU_free_process(PCB_t *pcb);
+void FPU_switch_out(PCB_t *pcb);
+int FPU_device_not_available(PCB_t *pcb);
+void FPU_copy_state(PCB_t *dest, PCB_t *src);
+
+#endif
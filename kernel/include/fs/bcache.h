@@ -0,0 +1,42 @@
+#ifndef _BCACHE_H_
+#define _BCACHE_H_
+
+#include <stdint.h>
+
+#define BLOCK_SIZE             4096
+#define BCACHE_BLOCKS          256  // 1MB of cached blocks
+#define BCACHE_HASH_SIZE       512  // buckets of the index on the block numbers (a power of two)
+#define BCACHE_MAX_RUN         16   // consecutive blocks read ahead/written by a single command
+#define BCACHE_FLUSH_INTERVAL  1000 // ms between two write-backs done by an idle CPU
+#define BCACHE_FLUSH_BATCH     64   // blocks written back by an idle CPU at a time
+
+typedef struct buffer {
+    uint32_t block;
+    uint8_t valid : 1;              // the buffer holds a block
+    uint8_t dirty : 1;              // the block has changed since it was read/written
+    uint8_t *data;
+    struct buffer *prev;            // LRU list (the head is the most recently used block)
+    struct buffer *next;
+    struct buffer *hash_next;       // next block in the same bucket
+} buffer_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t readahead;             // blocks read in before they were asked for
+    uint32_t blocks_read;           // from the disk
+    uint32_t blocks_written;        // to the disk
+    uint32_t read_ms;               // time spent waiting on the disk
+    uint32_t write_ms;
+} bcache_stats_t;
+
+int bcache_init();
+uint32_t bcache_get_block_count();
+int bcache_read(uint32_t block, void *buffer);
+int bcache_write(uint32_t block, const void *buffer);
+uint32_t bcache_flush(uint32_t max_blocks, uint8_t wait);
+uint32_t bcache_get_dirty_count();
+void bcache_get_stats(bcache_stats_t *stats);
+void bcache_print_stats();
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef _FAT_H_
+#define _FAT_H_
+
+#include <fs/vfs.h>
+
+#define EOF_CLUSTER         0x0FFFFFFF
+#define FREE_CLUSTER        0x0FFFFFFE
+#define TAKEN_CLUSTER       0x0FFFFFFD
+#define FAT16_RESERVED      0xFFF0     // 16-bit entries from this value up are special (EOF, free, taken)
+
+#define FS_MIN_CLUSTER_SIZE 512
+#define FS_MAX_CLUSTER_SIZE 4096
+#define FS_MAX_CLUSTERS     (128 * 1024) // clusters get bigger until there's at most this many of them
+
+#define ROOT_FIRST_START_CLUSTER   0
+#define FILE_HASH_SIZE             64 // initial number of buckets of the hash index on the names within a dir
+#define DIR_MIN_CAPACITY           16 // initial number of entries the in-memory arrays of a dir can hold
+#define DIR_MAX_DIRTY_CLUSTERS     4  // changed clusters of a dir tracked before it's written back as a whole
+#define FILE_MIN_EXTENTS           4  // initial size of the array of runs of clusters of a file
+
+#define FS_DISK_MAGIC              0x53464C44 // "DLFS", the region has been stored on the disk
+#define FS_DISK_HEADER_BLOCK       0          // the header is followed by the region itself
+#define FS_DISK_FIRST_BLOCK        1
+
+typedef struct {
+    uint32_t size;                  // size of the region of the file system in B
+    uint32_t cluster_size;          // 512B - 4KB, depending on the size of the region
+    uint32_t cluster_count;
+    uint32_t fat_entry_size;        // 2B (FAT16) or 4B (FAT32), depending on the number of clusters
+    uint32_t bitmap_size;           // size of the bitmap of free clusters (in 32-bit words)
+    uint32_t cluster_start_addr;    // the clusters follow the FAT
+} fs_geometry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t size;                  // the region is only read back with the same geometry
+    uint32_t cluster_size;
+} fs_disk_header_t;
+
+typedef struct {
+    char name[FILE_NAME_LEN];       // file name
+    uint32_t start_cluster_index;   // start cluster
+    uint32_t size;                  // size of the file in B
+    uint8_t open : 1;               // flag if the file is open
+    uint8_t system: 1;              // flag if the file is a system file
+    uint8_t directory: 1;           // flag if the file is a directory (its data are the entries)
+} __attribute__((packed)) file_t;
+
+typedef struct {
+    uint32_t offset;                // offset of the run within the file in B
+    uint32_t start_cluster;         // first cluster of the run
+    uint32_t cluster_count;         // number of consecutive clusters
+} extent_t;
+
+typedef struct {
+    extent_t *extents;              // runs of clusters of a file in the order of the chain (NULL = not built yet)
+    uint32_t count;
+    uint32_t capacity;
+} file_extents_t;
+
+typedef struct {
+    uint32_t file_count;            // number of files in the directory
+    file_t *files;                  // the files themselves
+} __attribute__((packed)) folder_t;
+
+typedef struct dir {
+    folder_t folder;
+    uint32_t capacity;              // the arrays below double in size, so a new entry doesn't copy all of them
+    int32_t *hash;                  // index of the first entry of each bucket (-1 = empty)
+    uint32_t hash_size;             // number of buckets (a power of two, it doubles as the dir grows)
+    int32_t *hash_next;             // next entry in the same bucket
+    file_extents_t *extents;        // runs of clusters of each entry
+    struct dir **subdirs;           // subdirectories which have been looked up (NULL = not loaded yet)
+    uint32_t *clusters;             // data clusters of the dir in the order of the chain
+    uint32_t cluster_count;
+    uint32_t eof_cluster;
+    uint32_t dirty[DIR_MAX_DIRTY_CLUSTERS]; // positions (within clusters) to be written back
+    uint32_t dirty_count;
+    uint8_t all_dirty;
+} dir_t;
+
+extern const fs_ops_t fat_ops;
+
+fs_geometry_t *fat_init();
+uint32_t get_free_cluster_count();
+uint32_t get_cluster_size();
+uint32_t get_fat_entry_bits();
+uint32_t get_memory_available();
+
+// just for debugging purposes
+void print_FAT(uint32_t n);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _PIPE_H_
+#define _PIPE_H_
+
+#include <stdint.h>
+#include <spinlock.h>
+#include <processes/wait_queue.h>
+
+#define PIPE_BUFFER_SIZE 4096
+#define PIPE_EOF         0xFFFFFFFF // returned by pipe_read_line() once there's no writer left
+
+// anonymous pipe - a ring buffer shared by the processes holding its read/write ends
+typedef struct {
+    char buffer[PIPE_BUFFER_SIZE];
+    uint32_t head;              // position of the next byte to be read
+    uint32_t count;             // number of bytes in the buffer
+    uint32_t readers;           // number of open read ends
+    uint32_t writers;           // number of open write ends
+    wait_queue_t read_waiters;  // readers waiting for data (or the last writer to go away)
+    wait_queue_t write_waiters; // writers waiting for free space (or the last reader to go away)
+    spinlock_t lock;
+} pipe_t;
+
+pipe_t *pipe_create();
+void pipe_open_end(pipe_t *pipe, uint8_t write_end);
+void pipe_close_end(pipe_t *pipe, uint8_t write_end);
+uint32_t pipe_read(pipe_t *pipe, char *buffer, uint32_t len);
+uint32_t pipe_read_line(pipe_t *pipe, char *line, uint32_t max_len);
+uint32_t pipe_write(pipe_t *pipe, const char *buffer, uint32_t len);
+uint8_t pipe_is_ready(pipe_t *pipe, uint8_t write_end);
+wait_queue_t *pipe_get_wait_queue(pipe_t *pipe, uint8_t write_end);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _TMPFS_H_
+#define _TMPFS_H_
+
+#include <fs/vfs.h>
+
+#define TMPFS_PAGE_SIZE  4096
+#define TMPFS_HASH_SIZE  64   // buckets of the hash index on the names of the files
+
+// a file of the tmpfs - its data are held in pages allocated on the kernel heap
+typedef struct tmpfs_node {
+    char name[FILE_NAME_LEN];
+    uint32_t ino;                   // number of the inode (unique within the tmpfs)
+    uint32_t size;                  // size of the file in B
+    uint8_t open;                   // flag if the file is open
+    uint32_t page_count;
+    char **pages;                   // page i holds the bytes from i * TMPFS_PAGE_SIZE on
+    struct tmpfs_node *next;        // next file in the same bucket
+} tmpfs_node_t;
+
+// scratch file system kept in memory only (a single flat directory)
+typedef struct {
+    tmpfs_node_t *buckets[TMPFS_HASH_SIZE];
+    uint32_t file_count;
+    uint32_t page_count;            // pages held by all the files together
+    uint32_t last_ino;              // number given to the file created last
+} tmpfs_t;
+
+extern const fs_ops_t tmpfs_ops;
+
+tmpfs_t *tmpfs_create();
+
+#endif
@@ -5,40 +5,92 @@
 #include <math.h>
 
 #define FILE_NAME_LEN       16
-#define EOF_CLUSTER         0xFFF
-#define FREE_CLUSTER        0xFFE
-#define TAKEN_CLUSTER       0xFFD
-#define CLUSTER_SIZE        64
-#define CLUSTER_COUNT       (min(0xFFF, (FS_SIZE / (sizeof(fat12_t) + CLUSTER_SIZE))))
-#define FAT_TABLE_SIZE      (sizeof(fat12_t) * CLUSTER_COUNT)
-#define CLUSTER_START_ADDR  (FS_START_ADDR + FAT_TABLE_SIZE)
-#define ROOT_FOLDER_SIZE    (sizeof(uint32_t) + (root->file_count * sizeof(file_t)))
-#define CLUSTER_ADDR(index) (CLUSTER_START_ADDR + ((index) * CLUSTER_SIZE))
-
-#define ROOT_FIRST_START_CLUSTER   0
-#define MAX_FILES_IN_FIRST_CLUSTER ((CLUSTER_SIZE - sizeof(uint32_t)) / sizeof(file_t))
-#define MAX_FILES_IN_ONE_CLUSTER   (CLUSTER_SIZE / sizeof(file_t))
+#define MAX_PATH_LEN        128 // the names within a path are cut off at FILE_NAME_LEN each
+#define PATH_SEPARATOR      '/'
+#define DCACHE_SIZE         64  // slots of the cache of resolved paths
+#define MAX_MOUNTS          4   // the root file system + the ones mounted into its root dir
+#define VFS_COPY_CHUNK      4096 // bytes copied at a time by cp()
 
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+// a file as identified by the file system it's stored in (the meaning of the fields is up to the backend,
+// e.g. the dir and the position within it), it stays valid until a file is removed from the VFS
 typedef struct {
-    uint32_t value : 12;            // fat[i] value
-} __attribute__((packed)) fat12_t;
+    void *node;
+    uint32_t index;
+} inode_t;
 
 typedef struct {
-    char name[FILE_NAME_LEN];       // file name
-    uint32_t start_cluster_index;   // start cluster
+    uint32_t ino;                   // number of the inode within its file system
     uint32_t size;                  // size of the file in B
-    uint8_t open : 1;               // flag if the file is open
-    uint8_t system: 1;              // flag if the file is a system file
-} __attribute__((packed)) file_t;
+    uint8_t open;                   // flag if the file is open
+    uint8_t system;                 // flag if the file is a system file
+    uint8_t directory;              // flag if the file is a directory
+} vfs_attr_t;
+
+typedef struct {
+    char name[FILE_NAME_LEN];
+    vfs_attr_t attr;
+} dirent_t;
 
+// operations of a file system mounted into the VFS, they're called with the VFS lock held
+// (the names are relative to the mount point, "" stands for the root dir of the file system)
 typedef struct {
-    uint32_t file_count;            // number of files in the root dir
-    file_t *files;                  // the files themselves
-} __attribute__((packed)) folder_t;
+    const char *type;
+
+    // inode operations
+    int (*lookup)(void *fs, const char *name, inode_t *inode);                                          // 0 = found
+    int (*create)(void *fs, const char *name, uint8_t directory);                                       // 0 = created
+    int (*remove)(void *fs, inode_t *inode);                                                            // 0 = removed (dirs have to be empty)
+    void (*getattr)(void *fs, inode_t *inode, vfs_attr_t *attr);
+    int (*setattr)(void *fs, inode_t *inode, const vfs_attr_t *attr);                                   // 0 = the flags have been stored
+    int (*readdir)(void *fs, inode_t *inode, uint32_t *cursor, dirent_t *dirent);                       // 0 = an entry (cursor starts at 0)
+
+    // file operations (the hint is kept along with an open file for the backend to speed up sequential access)
+    uint32_t (*read)(void *fs, inode_t *inode, uint32_t *hint, char *buffer, uint32_t offset, uint32_t len); // bytes read, (uint32_t)-1
+    int (*write)(void *fs, inode_t *inode, uint32_t *hint, char *buffer, uint32_t offset, uint32_t len);     // 0 = written
+
+    // file system operations (NULL if the file system is kept in memory only)
+    int (*sync)(void *fs, uint32_t max_blocks);                                                         // 0 = nothing is left to be written
+} fs_ops_t;
+
+typedef struct {
+    char path[FILE_NAME_LEN];       // name of the mount point within the root dir ("" = the root itself)
+    const fs_ops_t *ops;
+    void *fs;                       // state of the file system passed to its operations
+} mount_t;
+
+typedef struct {
+    uint32_t hash;                  // hash of the path
+    uint32_t generation;            // the entry is valid as long as this matches the VFS
+    mount_t *mount;                 // NULL = an empty slot
+    inode_t inode;
+    char path[MAX_PATH_LEN];
+} dentry_t;
+
+typedef struct {
+    const fs_ops_t *ops;            // operations of the file system the file is stored in
+    void *fs;
+    inode_t inode;                  // valid as long as the generation matches the VFS
+    uint32_t generation;
+    uint32_t hint;                  // left to the backend (e.g. the run of clusters the last read/write ended in)
+    uint32_t position;              // current offset within the file in B
+    volatile uint32_t refs;         // number of file descriptors referring to it (dup2, fork)
+    char path[MAX_PATH_LEN];        // used to look the file up again once the inode is no longer valid
+} open_file_t;
 
 int fs_init();
-void ls();
+void fs_flush();
+int fs_sync();
+int mount(char *path, const fs_ops_t *ops, void *fs);
+void vfs_lock();
+void vfs_unlock();
+int ls(char *path);
 int touch(char *filename);
+int mkdir(char *path);
+int rmdir(char *path);
 int rm(char *filename);
 int cat(char *filename);
 int cp(char *src, char *des);
@@ -47,14 +99,15 @@ int write(char *filename, char *buffer, uint32_t offset, uint32_t len);
 int is_file_open(char *filename);
 int open_file(char *filename);
 int close_file(char *filename);
-uint32_t get_free_cluster_count();
 uint32_t get_file_size(char *filename);
-uint32_t get_memory_available();
 int file_exists(char *filename);
 int set_as_system_file(char *filename);
+open_file_t *open_fd(char *filename);
+void dup_fd(open_file_t *open_file);
+void close_fd(open_file_t *open_file);
+uint32_t read_fd(open_file_t *open_file, char *buffer, uint32_t len);
+uint32_t write_fd(open_file_t *open_file, char *buffer, uint32_t len);
+int32_t lseek(open_file_t *open_file, int32_t offset, uint32_t whence);
 int delete_system_file(char *filename);
 
-// just for debugging purposes
-void print_FAT(uint32_t n);
-
 #endif
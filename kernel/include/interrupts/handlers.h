@@ -16,7 +16,6 @@ typedef struct
 // interrupt handlers call from the assembly language
 extern "C" {
     void _generic_interrupt_handler(Interrupt_generic_registers_t regs);  // generic one
-    void _int0xE_handler(uint32_t pfla);                                  // Handler for Page Fault, only want the PFLA (Page Fault Linear Address = 32 bit)
 };
 
 #endif
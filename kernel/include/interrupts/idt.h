@@ -34,5 +34,6 @@ typedef struct {
 } __attribute__((packed)) IDT_descriptor_t;
 
 int IDT_init();
+void IDT_load();
 
 #endif
\ No newline at end of file
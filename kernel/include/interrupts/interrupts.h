@@ -9,6 +9,7 @@
 // the reason for this is to avoid optimizer corrupting the function
 // https://wiki.osdev.org/Interrupt_Service_Routines
 extern "C" {
+    void _isr7();  // Device not available
     void _isr8();  // Double Fault
     void _isrA();  // Invalid TSS
     void _isrB();  // Segment Not Present
@@ -20,8 +21,11 @@ extern "C" {
     void _isr13();  // SIMD Floating-Point Exception
     void _isr20();  // PIT (system timer)
     void _isr21();  // keyboard
+    void _isr30();  // local APIC timer
+    void _isr31();  // TLB shootdown
     void _isr80();  // system calls
     void _isr2C();  // system calls
+    void _isrFF();  // local APIC spurious interrupt
 }
 
 #endif
@@ -92,5 +92,7 @@ typedef struct {
 } __attribute__((packed)) TSS_entry_t;
 
 int GDT_init();
+int GDT_init_cpu(uint32_t cpu_index, uint32_t kernel_stack_top);
+void TSS_set_kernel_stack(uint32_t cpu_index, uint32_t kernel_stack_top);
 
 #endif
\ No newline at end of file
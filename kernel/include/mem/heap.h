@@ -2,6 +2,7 @@
 #define _HEAP_H_
 
 #include <stdint.h>
+#include <spinlock.h>
 
 typedef struct heap_block {
     struct heap_block *next;    // next block of memory within the heap
@@ -12,16 +13,24 @@ typedef struct heap_block {
 typedef struct {
     uint32_t addr;              // start addr of the heap
     uint32_t size;              // size of the heap
-} __attribute__((packed)) heap_t;
+    spinlock_t lock;            // the heap may be used by several CPUs at a time
+} heap_t;                       // not packed, so the lock stays aligned
 
 
 uint32_t get_kernel_heap_size();
 void heap_init(heap_t *heap, uint32_t addr, uint32_t size);
 void *heap_malloc(heap_t *heap, uint32_t size);
 void heap_free(heap_t *heap, void *ptr);
+void *heap_realloc(heap_t *heap, void *ptr, uint32_t size);
+void heap_grow(heap_t *heap, uint32_t size);
+uint32_t heap_shrink(heap_t *heap, uint32_t min_size, uint32_t threshold);
 
 int kernel_heap_init();
+void kernel_heap_trim();
+uint32_t get_kernel_heap_mapped_size();
 void *kmalloc(uint32_t size);
 void kfree(void *ptr);
+void *krealloc(void *ptr, uint32_t size);
+void *kcalloc(uint32_t count, uint32_t size);
 
 #endif
\ No newline at end of file
@@ -18,15 +18,23 @@
 #define ADDRESS_SPACE_SIZE      (4LL * 1024 * 1024 * 1024)                   // 4GB
 #define FRAMES_COUNT            (1 + (ADDRESS_SPACE_SIZE / FRAME_SIZE / 32)) // the size of a bitmap if we had all 4GB or RAM
 
-#define KERNEL_HEAP_SIZE        (20 * 1024 * 1024) // kernel heap is 20MB in size (should be table-aligned -> x * 4MB)
-#define KERNEL_HEAP_START_PAGE  769                // the very next page after the kernel page
-#define KERNEL_HEAP_END_PAGE    (KERNEL_HEAP_START_PAGE + KERNEL_HEAP_SIZE / (PAGE_TABLE_ENTRIES * FRAME_SIZE) - 1)
-#define KERNEL_HEAP_START_ADDR  (0xC0400000)       // 0xC0000000 + 4MB
+#define KERNEL_HEAP_MAX_SIZE      (128 * 1024 * 1024) // virtual space reserved for the kernel heap (should be table-aligned -> x * 4MB)
+#define KERNEL_HEAP_INITIAL_SIZE  (1024 * 1024)       // only this much is backed by frames at boot, the rest is mapped on demand
+#define KERNEL_HEAP_GROW_SIZE     (256 * 1024)        // the heap grows by at least this much at a time
+#define KERNEL_HEAP_TRIM_SIZE     (1024 * 1024)       // free memory at the end of the heap given back once the CPU is idle
+#define KERNEL_HEAP_START_PAGE    769                 // the very next page after the kernel page
+#define KERNEL_HEAP_END_PAGE      (KERNEL_HEAP_START_PAGE + KERNEL_HEAP_MAX_SIZE / (PAGE_TABLE_ENTRIES * FRAME_SIZE) - 1)
+#define KERNEL_HEAP_START_ADDR    (0xC0400000)        // 0xC0000000 + 4MB
+#define KERNEL_VIRTUAL_BASE       0xC0000000          // page table 768 maps the first 4MB of the RAM here
 
-#define FS_START_ADDR           (KERNEL_HEAP_START_ADDR + KERNEL_HEAP_SIZE)
-#define FS_SIZE                 (20 * 1024 * 1024)         // file system size (20 MB, should be table-aligned -> x * 4MB)
+#define FS_START_ADDR           (KERNEL_HEAP_START_ADDR + KERNEL_HEAP_MAX_SIZE)
+#define FS_MAX_SIZE             (128 * 1024 * 1024)        // virtual space reserved for the file system (table-aligned -> x * 4MB)
+#define FS_MIN_SIZE             (4 * 1024 * 1024)
+#define FS_RAM_SHARE            16                         // the file system takes up 1/16 of the RAM
 #define FS_START_PAGE           (KERNEL_HEAP_END_PAGE + 1) // the very next page after the kernel heap
-#define FS_END_PAGE             (FS_START_PAGE + FS_SIZE / (PAGE_TABLE_ENTRIES * FRAME_SIZE) - 1)
+#define FS_END_PAGE             (FS_START_PAGE + FS_MAX_SIZE / (PAGE_TABLE_ENTRIES * FRAME_SIZE) - 1)
+
+#define PAGE_FAULT_PROTECTION   (1 << 0) // error code of a page fault - the page was present (it's not a missing page)
 
 #define PAGE_TABLE_ADDR(pt_index) ((uint32_t)(pt_index) * PAGE_TABLE_ENTRIES * FRAME_SIZE)
 #define TOP_STACK_ADDR(pt_index) ((((uint32_t)(pt_index) + 1) * PAGE_TABLE_ENTRIES * FRAME_SIZE) - 1)
@@ -74,6 +82,12 @@ uint32_t allocate_frame();
 void frame_set_state(uint32_t frame_index, uint32_t occupied);
 uint32_t allocate_page(uint32_t user);
 void unmap_page(uint32_t virtual_addr);
+void detach_page(uint32_t virtual_addr);
+int map_kernel_heap_pages(uint32_t virtual_addr, uint32_t count);
+void unmap_kernel_heap_pages(uint32_t virtual_addr, uint32_t count);
+void map_mmio_page(uint32_t virtual_addr, uint32_t physical_addr);
+uint32_t get_physical_addr(uint32_t virtual_addr);
 uint32_t get_number_of_free_frames();
+uint32_t get_fs_size();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef _SCRATCH_H_
+#define _SCRATCH_H_
+
+#include <stdint.h>
+
+// Per-CPU bump allocator for short-lived kernel buffers. Everything allocated after
+// scratch_begin() goes away at the matching scratch_end(), or at the latest when the CPU
+// leaves the kernel. The code in between must not sleep, so preemption is disabled.
+
+#define SCRATCH_SIZE          (16 * 1024)
+#define SCRATCH_MAX_FALLBACKS 4          // bigger requests are served by the kernel heap
+
+typedef struct {
+    uint8_t *memory;
+    uint32_t top;                               // offset of the first free byte
+    void *fallbacks[SCRATCH_MAX_FALLBACKS];     // kmalloc'd blocks freed along with the scratch memory
+    uint32_t fallback_count;
+} scratch_arena_t;
+
+typedef struct {
+    uint32_t top;
+    uint32_t fallback_count;
+} scratch_mark_t;
+
+int scratch_init(scratch_arena_t *arena);
+scratch_mark_t scratch_begin();
+void *scratch_alloc(uint32_t size);
+void scratch_end(scratch_mark_t mark);
+void scratch_reset();
+
+#endif
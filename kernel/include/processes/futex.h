@@ -0,0 +1,27 @@
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+#include <stdint.h>
+#include <spinlock.h>
+#include <processes/process.h>
+
+// https://man7.org/linux/man-pages/man2/futex.2.html
+// https://www.akkadia.org/drepper/futex.pdf
+
+#define FUTEX_HASH_BITS 6
+#define FUTEX_HASH_SIZE (1 << FUTEX_HASH_BITS) // number of wait queues
+#define FUTEX_WAKE_ALL  0xFFFFFFFF
+
+// threads waiting on any of the futexes whose keys hash into the bucket
+typedef struct {
+    spinlock_t lock;
+    futex_node_t *first;            // linked through the futex nodes of the threads
+    futex_node_t *last;
+} futex_bucket_t;
+
+int futex_init();
+uint8_t futex_block(PCB_t *pcb, uint32_t key, volatile uint32_t *addr, uint32_t expected);
+uint32_t futex_wake_up(uint32_t key, uint32_t count);
+uint8_t futex_cancel(PCB_t *pcb);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _MQ_H_
+#define _MQ_H_
+
+#include <stdint.h>
+#include <spinlock.h>
+#include <processes/process.h>
+#include <processes/wait_queue.h>
+
+// https://man7.org/linux/man-pages/man7/mq_overview.7.html
+
+#define MQ_MAX_QUEUES 16
+#define MQ_NAME_LEN   16
+#define MQ_CAPACITY   16         // messages a queue can hold before the senders block
+#define MQ_SLOT_SIZE  256        // small messages are copied into the slots
+#define MQ_PAGE_SIZE  FRAME_SIZE // page-aligned pages are moved (remapped) instead of copied
+#define MQ_ERROR      0xFFFFFFFF
+
+typedef struct {
+    uint32_t len;
+    uint32_t frame;              // physical address of a moved page (0 if the data is in the slot)
+    char data[MQ_SLOT_SIZE];
+} mq_message_t;
+
+// named bounded queue (queues live as long as the system does)
+typedef struct {
+    char name[MQ_NAME_LEN];
+    mq_message_t slots[MQ_CAPACITY];
+    uint32_t head;
+    uint32_t count;
+    wait_queue_t senders;        // waiting for a free slot
+    wait_queue_t receivers;      // waiting for a message
+    spinlock_t lock;
+} mq_t;
+
+int mq_init();
+uint32_t mq_open(const char *name);
+uint8_t mq_send(process_t *process, uint32_t id, char *buffer, uint32_t len);
+uint32_t mq_receive(process_t *process, uint32_t id, char *buffer, uint32_t max_len);
+uint8_t mq_is_ready(uint32_t id);
+wait_queue_t *mq_get_wait_queue(uint32_t id);
+
+#endif
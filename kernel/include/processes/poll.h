@@ -0,0 +1,29 @@
+#ifndef _POLL_H_
+#define _POLL_H_
+
+#include <stdint.h>
+#include <processes/process.h>
+
+// https://man7.org/linux/man-pages/man2/poll.2.html
+
+#define POLL_KEYBOARD 1          // a line of input is available (id is not used)
+#define POLL_CHILD    2          // the process whose pid is id has terminated
+#define POLL_PIPE     3          // fd id can be read from/written into without blocking
+#define POLL_MQ       4          // message queue id holds a message
+
+#define POLL_NOT_READY 0
+#define POLL_READY     1
+#define POLL_INVALID   2         // e.g. the fd is not open (it counts as ready)
+
+#define POLL_INFINITE 0xFFFFFFFF // no timeout
+#define POLL_ERROR    0xFFFFFFFF
+
+typedef struct {
+    uint32_t type;
+    uint32_t id;
+    uint32_t ready;              // set by poll()
+} poll_entry_t;
+
+uint32_t poll(PCB_t *pcb, poll_entry_t *entries, uint32_t count, uint32_t timeout_ms);
+
+#endif
@@ -5,6 +5,11 @@
 #include <mem/heap.h>
 #include <mem/paging.h>
 #include <processes/list.h>
+#include <processes/wait_queue.h>
+#include <fs/pipe.h>
+#include <fs/vfs.h>
+#include <spinlock.h>
+#include <ring.h>
 
 #define PROCESS_STATE_NEW           1
 #define PROCESS_STATE_RUNNING       2
@@ -17,13 +22,32 @@
 #define EFLAGS_ALWAYS1_BIT           (1 << 1)
 #define EFLAGS_ENABLE_IF_BIT         (1 << 9)
 
-#define MAX_NUMBER_OF_PROCESSES       256
+#define MAX_NUMBER_OF_PROCESSES       4096 // must be a multiple of 32 (size of the pid bitmap)
+#define PID_BITMAP_SIZE               (MAX_NUMBER_OF_PROCESSES / 32)
+#define INVALID_PID                   0xFFFFFFFF
 #define PROCESS_STACK_PAGE_TABLE      767
 
 #define PROCESS_HEAP_SIZE_IN_4M       2 // 8 * 4MB = 8MB
 #define PROCESS_HEAP_SIZE             (PROCESS_HEAP_SIZE_IN_4M * 1024 * 4096)
 #define PROCESS_HEAP_START_PAGE_TABLE (PROCESS_STACK_PAGE_TABLE - PROCESS_HEAP_SIZE_IN_4M - 1)
 #define PROCESS_HEAP_END_PAGE_TABLE   (PROCESS_HEAP_START_PAGE_TABLE + PROCESS_HEAP_SIZE_IN_4M)
+#define PROCESS_HEAP_START_ADDR       PAGE_TABLE_ADDR(PROCESS_HEAP_START_PAGE_TABLE)
+#define PROCESS_HEAP_END_ADDR         (PROCESS_HEAP_START_ADDR + PROCESS_HEAP_SIZE) // the break cannot go past it
+
+#define PROCESS_KERNEL_STACK_SIZE 8192 // used whenever the process enters the kernel (syscalls, interrupts)
+
+// additional threads get their user stacks carved out of the bottom of the stack page table,
+// the main thread keeps using the top of it (so it must not grow over 2MB)
+#define MAX_THREADS_PER_PROCESS 8
+#define THREAD_STACK_SIZE       (256 * 1024)
+#define MAIN_THREAD_STACK_SLOT  MAX_THREADS_PER_PROCESS
+
+// file descriptors (so far only pipes), 0 and 1 fall back to the terminal unless redirected
+#define MAX_FDS   16
+#define STDIN_FD  0
+#define STDOUT_FD 1
+
+#define MAX_POLL_ENTRIES 8 // number of things a single poll() call can wait for
 
 #define PROCESS_NAME_LEN   16
 #define PROCESS_STDOUT_LEN 16
@@ -42,25 +66,82 @@ typedef struct {
     uint32_t eip;    // 40
 } __attribute__((packed)) regs_t;
 
+typedef struct {
+    pipe_t *pipe;       // NULL if the descriptor is not a pipe
+    uint8_t write_end;
+    open_file_t *file;  // NULL if the descriptor is not a file (shared after dup2/fork)
+} fd_t;
+
+// address space shared by all threads of a process
+typedef struct {
+    uint32_t cr3;                                   // physical address of the page directory
+    page_dir_t *page_dir_kernel_mapping;            // the same page directory mapped into the kernel
+    uint32_t brk;                                   // end of the heap (the pages below it are mapped once they're touched)
+    list_t *open_files;
+    fd_t fds[MAX_FDS];
+    list_t *page_tables;
+    uint32_t thread_count;                          // the address space goes away with the last thread
+    uint8_t thread_stacks[MAX_THREADS_PER_PROCESS]; // user stack slots taken by additional threads
+    spinlock_t lock;                                // protects open_files, fds, thread_count, thread_stacks, brk, and the page tables
+    ring_t *ring;                                   // submission/completion ring set up by the process (NULL if none)
+    volatile uint32_t ring_busy;                    // a thread is draining the ring
+} process_t;
+
+// links a thread into the queue of the futex bucket it's waiting in (no allocation is needed to wait)
+typedef struct futex_node {
+    struct futex_node *next;
+    struct futex_node *prev;
+    void *pcb;
+} futex_node_t;
+
+// schedulable thread (the main thread of a process is created along with the address space)
 typedef struct {
     uint32_t pid;
     uint32_t ppid;
     regs_t regs;
     char name[PROCESS_NAME_LEN];
     char stdout[PROCESS_STDOUT_LEN];
-    heap_t heap;
     uint8_t state;
     uint32_t shell_id;
-    page_dir_t *page_dir_kernel_mapping;
-    list_t *open_files;
-    list_t *page_tables;
+    process_t *process;         // address space the thread runs in
+    uint32_t thread_stack_slot; // slot of the user stack within process->thread_stacks
+    uint32_t cpu;            // index of the CPU whose run queue the process belongs to
+    uint8_t pending_kill;    // the process is to be killed once it's out of the kernel
+    uint32_t kernel_stack;   // bottom of the kernel stack of the process
+    uint32_t kernel_esp;     // saved kernel stack pointer if the process was preempted within the kernel (otherwise 0)
+    volatile uint8_t on_cpu; // a CPU is still using the kernel stack of the process
+    uint8_t *fpu_state;      // FXSAVE area (aligned to 16B, allocated once the process uses the FPU)
+    void *fpu_state_alloc;   // the allocation the FXSAVE area is part of
+    uint32_t fpu_cpu;        // CPU whose FPU registers last held the state of the process
+    uint32_t futex_key;      // physical address of the futex the thread is waiting on (0 if none)
+    futex_node_t futex_node; // links the thread into the queue of its futex bucket
+    wait_queue_node_t wait_node;  // links the thread into the wait queue it's sleeping on
+    wait_queue_t exit_waiters;    // threads waiting for this one to terminate
+    uint32_t exit_code;           // passed to exit_waiters (1 unless the thread exits on its own)
+    wait_queue_node_t poll_nodes[MAX_POLL_ENTRIES]; // link the thread into the queues it's polling
+    wait_queue_node_t timer_node; // links the thread into the timer queue (if poll() has a timeout)
+    uint32_t timer_deadline;      // uptime (in ms) at which the thread is woken up by the timer
 } PCB_t;
 
 int init_processes();
 PCB_t *create_process_virtual_addr_space(const char *filename, uint32_t ppid, const char *stdout, uint32_t shell_id);
+PCB_t *create_thread(PCB_t *creator, uint32_t entry, uint32_t fce, uint32_t arg);
+uint8_t release_thread(PCB_t *pcb);
 void print_registers(PCB_t *pcb);
 void print_pcb(void *data);
-void unmap_process(PCB_t *pcb);
+void unmap_process(process_t *process);
+uint32_t get_user_physical_addr(process_t *process, uint32_t virtual_addr);
+uint32_t replace_user_frame(process_t *process, uint32_t virtual_addr, uint32_t frame_addr);
+uint8_t map_user_heap_page(process_t *process, uint32_t virtual_addr);
+uint32_t set_user_brk(process_t *process, uint32_t new_brk);
+int fd_install(process_t *process, pipe_t *pipe, uint8_t write_end);
+int fd_install_file(process_t *process, open_file_t *file);
+pipe_t *fd_get_pipe(process_t *process, uint32_t fd, uint8_t *write_end);
+open_file_t *fd_get_file(process_t *process, uint32_t fd);
+int fd_close(process_t *process, uint32_t fd);
+int fd_dup2(process_t *process, uint32_t old_fd, uint32_t new_fd);
+void fd_copy_table(process_t *dest, process_t *src);
+void fd_close_all(process_t *process);
 uint32_t allocate_pid();
 void free_pid(uint32_t pid);
 
@@ -11,19 +11,33 @@
 PCB_t *get_running_process();
 PCB_t *get_latest_running_non_idle_process();
 PCB_t *create_process(const char *filename, uint32_t ppid, const char *stdout, uint32_t shell_id);
+PCB_t *create_user_thread(PCB_t *creator, uint32_t entry, uint32_t fce, uint32_t arg);
+uint8_t is_thread_of(uint32_t pid, PCB_t *pcb);
 void switch_to_next_process();
 void switch_process(PCB_t *pcb);
+void preempt_point();
 void save_process_context(PCB_t *pcb, Interrupt_generic_registers_t *regs);
 void init_process_scheduler();
 void set_process_as_ready(PCB_t *pcb);
 void kill_process(PCB_t *pcb);
 void print_all_processes();
-void block_process_on_another_process(PCB_t *pcb);
-void wake_up_parent_process(uint32_t ppid, uint32_t exit_code);
+void sleep_on(wait_queue_t *queue, PCB_t *pcb);
+uint8_t sleep_until_woken(wait_queue_t *queue, spinlock_t *lock);
+uint8_t wake_one(wait_queue_t *queue, uint32_t result);
+uint32_t wake_all(wait_queue_t *queue, uint32_t result);
+uint8_t block_process_on_another_process(PCB_t *pcb, uint32_t pid);
 uint8_t exists_process(uint32_t pid);
 void block_process_on_keyboard(PCB_t *pcb);
+uint8_t is_keyboard_line_pending(PCB_t *pcb);
+wait_queue_t *get_keyboard_wait_queue(PCB_t *pcb);
+uint8_t poll_begin(PCB_t *pcb);
+void poll_on_queue(PCB_t *pcb, uint32_t index, wait_queue_t *queue);
+uint8_t poll_on_process(PCB_t *pcb, uint32_t index, uint32_t pid);
+void poll_on_timer(PCB_t *pcb, uint32_t deadline);
+void poll_wake_up(PCB_t *pcb);
+void poll_sleep(PCB_t *pcb);
+void wake_up_expired_timers(uint32_t now);
 void wake_process_waiting_for_keyboard(char *data);
-uint8_t is_blocked_elsewhere(PCB_t *pcb, list_t *originalQueue);
 void switch_to_terminal(uint32_t pid);
 uint32_t get_focused_terminal();
 
@@ -1,11 +1,11 @@
 #ifndef _SYSCALL_H_
 #define _SYSCALL_H_
 
+#include <processes/process.h>
+
 #define SYSCALL_EXIT         100
 #define SYSCALL_PRINTF       101
 #define SYSCALL_READ_LINE    102
-#define SYSCALL_MALLOC       103
-#define SYSCALL_FREE         104
 #define SYSCALL_PID          105
 #define SYSCALL_PPID         106
 #define SYSCALL_EXEC         107
@@ -27,7 +27,30 @@
 #define FILE_APPEND          124
 #define SYSCALL_COLOR        125
 #define SYSCALL_SET_CURSOR   126
+#define SYSCALL_THREAD_CREATE 127
+#define SYSCALL_THREAD_JOIN  128
+#define SYSCALL_FUTEX_WAIT   129
+#define SYSCALL_FUTEX_WAKE   130
+#define SYSCALL_PIPE         131
+#define SYSCALL_FD_READ      132
+#define SYSCALL_FD_WRITE     133
+#define SYSCALL_FD_CLOSE     134
+#define SYSCALL_DUP2         135
+#define SYSCALL_MQ_OPEN      136
+#define SYSCALL_MQ_SEND      137
+#define SYSCALL_MQ_RECEIVE   138
+#define SYSCALL_UPTIME       139
+#define SYSCALL_POLL         140
+#define SYSCALL_RING_SETUP   141
+#define SYSCALL_RING_ENTER   142
+#define SYSCALL_BRK          143
+#define SYSCALL_FD_OPEN      144
+#define SYSCALL_LSEEK        145
+#define SYSCALL_MKDIR        146
+#define SYSCALL_RMDIR        147
+#define SYSCALL_SYNC         148
 
 void sys_callback();
+uint32_t ring_drain(PCB_t *pcb, uint8_t can_block);
 
 #endif
@@ -2,16 +2,41 @@
 #define _USER_PROGRAMS_H_
 
 #include <stdint.h>
+#include <boot/multiboot.h>
 
-#define PROGRAM_NAME_LEN 16
+#define PROGRAM_NAME_LEN    16
+#define MAX_PROGRAMS        128         // files the initrd can hold
+#define PROGRAM_HASH_SIZE   256         // buckets of the index on the names (a power of two)
+#define TAR_BLOCK_SIZE      512
+#define TAR_TYPE_FILE       '0'
+#define TAR_MAGIC           "ustar"
 
 typedef struct {
     char name[PROGRAM_NAME_LEN];
-    char *code;
+    char *code;                         // points right into the initrd
     uint32_t size;
+    int32_t hash_next;                  // next program in the same bucket (-1 = none)
 } program_t;
 
+// https://www.gnu.org/software/tar/manual/html_node/Standard.html
+typedef struct {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];                      // octal
+    char mtime[12];
+    char checksum[8];
+    char type;
+    char link_name[100];
+    char magic[6];                      // "ustar"
+} __attribute__((packed)) tar_header_t;
+
+int load_initrd(multiboot_info_t *multiboot_info);
+uint32_t get_initrd_addr();
+uint32_t get_initrd_size();
+uint32_t get_program_count();
 program_t *get_program(const char *name);
 void print_all_programs();
 
-#endif
\ No newline at end of file
+#endif
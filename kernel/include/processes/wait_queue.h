@@ -0,0 +1,34 @@
+#ifndef _WAIT_QUEUE_H_
+#define _WAIT_QUEUE_H_
+
+#include <stdint.h>
+
+// Intrusive FIFO of threads waiting for a resource (a child to exit, a line of input, ...).
+// A thread sleeps on at most one queue at a time, so its node is embedded in the PCB
+// and both putting it to sleep and taking it out of the queue (e.g. once it's killed)
+// take constant time. The queues are protected by the process lock of the scheduler.
+// A thread in poll() sleeps on several queues at once through its poll nodes, waking
+// those up only makes the thread check again, so they're never handed any resource.
+
+struct wait_queue;
+
+typedef struct wait_queue_node {
+    struct wait_queue_node *next;
+    struct wait_queue_node *prev;
+    struct wait_queue *queue; // the queue the thread is sleeping on (NULL if it's not sleeping)
+    void *pcb;                // the sleeping thread
+    uint8_t poll;             // the node belongs to a poll() call
+} wait_queue_node_t;
+
+typedef struct wait_queue {
+    wait_queue_node_t *first;
+    wait_queue_node_t *last;
+} wait_queue_t;
+
+void wait_queue_init(wait_queue_t *queue);
+void wait_queue_push(wait_queue_t *queue, wait_queue_node_t *node);
+void wait_queue_insert_before(wait_queue_t *queue, wait_queue_node_t *node, wait_queue_node_t *next);
+wait_queue_node_t *wait_queue_pop(wait_queue_t *queue);
+void wait_queue_remove(wait_queue_node_t *node);
+
+#endif
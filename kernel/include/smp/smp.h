@@ -0,0 +1,103 @@
+#ifndef _SMP_H_
+#define _SMP_H_
+
+#include <stdint.h>
+#include <spinlock.h>
+#include <processes/process.h>
+#include <processes/list.h>
+#include <mem/scratch.h>
+
+// https://wiki.osdev.org/Symmetric_Multiprocessing
+// https://pdos.csail.mit.edu/6.828/2008/readings/ia32/MPspec.pdf
+
+#define MAX_CPUS                 8
+#define BSP_INDEX                0       // the bootstrap processor is always the first CPU
+
+#define CPU_KERNEL_STACK_SIZE    4096    // same size as the initial stack of the BSP (loader.asm)
+
+#define AP_TRAMPOLINE_ADDR       0x8000  // where the AP trampoline gets copied to (must be < 1MB and 4KB-aligned)
+#define AP_TRAMPOLINE_VECTOR     (AP_TRAMPOLINE_ADDR >> 12)
+#define AP_STARTUP_TIMEOUT_US    100000  // 100ms
+
+#define SMP_ALL_ADDRESS_SPACES   0       // cr3 passed to SMP_flush_tlb() when the mapping is shared by all page dirs
+
+#define MP_FLOATING_POINTER_SIGNATURE "_MP_"
+#define MP_CONFIG_TABLE_SIGNATURE     "PCMP"
+#define MP_ENTRY_PROCESSOR            0
+#define MP_PROCESSOR_ENABLED          (1 << 0)
+#define MP_PROCESSOR_BSP              (1 << 1)
+
+#define BIOS_EBDA_SEGMENT_PTR    0x40E    // the segment of the extended BIOS data area is stored here
+#define BIOS_ROM_START           0xF0000
+#define BIOS_ROM_END             0x100000
+
+// MP floating pointer structure (found within the first 1MB)
+typedef struct {
+    char signature[4];          // "_MP_"
+    uint32_t config_table;      // physical address of the MP configuration table
+    uint8_t length;             // length of the structure in 16B paragraphs
+    uint8_t revision;
+    uint8_t checksum;           // all bytes must add up to 0
+    uint8_t features[5];
+} __attribute__((packed)) mp_floating_pointer_t;
+
+// MP configuration table header (followed by entry_count entries)
+typedef struct {
+    char signature[4];          // "PCMP"
+    uint16_t length;            // length of the base table in bytes (including the header)
+    uint8_t revision;
+    uint8_t checksum;           // all bytes must add up to 0
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_count;
+    uint32_t lapic_addr;        // physical address of the local APIC
+    uint16_t extended_table_length;
+    uint8_t extended_table_checksum;
+    uint8_t reserved;
+} __attribute__((packed)) mp_config_table_t;
+
+// processor entry of the MP configuration table (the other entries are 8B long)
+typedef struct {
+    uint8_t type;               // 0 = processor
+    uint8_t lapic_id;
+    uint8_t lapic_version;
+    uint8_t flags;              // bit 0 = enabled, bit 1 = bootstrap processor
+    uint32_t signature;
+    uint32_t feature_flags;
+    uint32_t reserved[2];
+} __attribute__((packed)) mp_processor_entry_t;
+
+// per-CPU data
+typedef struct {
+    uint32_t index;             // index of the CPU (0 = BSP)
+    uint32_t lapic_id;          // ID of the CPU's local APIC
+    volatile uint8_t online;    // set by the CPU itself once it's been initialized
+    uint32_t kernel_stack_top;  // stack the scheduler runs on (processes use their own kernel stacks)
+    PCB_t *running_process;     // process currently running on the CPU
+    PCB_t *idle_process;        // process to run when there's nothing else to do
+    list_t *ready_processes;    // run queue of the CPU
+    spinlock_t ready_lock;      // protects the run queue
+    uint32_t ticks;             // timer ticks since the last context switch
+    volatile uint32_t cr3;      // address space currently loaded on the CPU
+    uint32_t preempt_count;     // the running kernel code must not be preempted if > 0
+    uint8_t need_resched;       // the timer asked for a reschedule while the CPU was in the kernel
+    uint8_t in_preempt_point;   // interrupts are let in by preempt_point()
+    PCB_t *dead_process;        // killed process whose kernel stack is freed once the CPU leaves it
+    PCB_t *fpu_owner;           // process whose state was last loaded into the FPU registers
+    volatile uint32_t tlb_flush_requests; // bumped by other CPUs that have changed the mappings of cr3
+    volatile uint32_t tlb_flush_done;     // the last request the CPU has flushed its TLB for
+    scratch_arena_t scratch;    // short-lived buffers of the kernel code running on the CPU
+} cpu_t;
+
+int SMP_init();
+void SMP_release_APs();
+cpu_t *get_cpu();
+cpu_t *get_cpu_by_index(uint32_t index);
+uint32_t get_cpu_count();
+void wait_until_address_space_unused(uint32_t cr3);
+void SMP_flush_tlb(uint32_t cr3, uint32_t virtual_addr);
+void SMP_handle_tlb_flush();
+
+#endif
@@ -4,6 +4,7 @@
 #include <processes/scheduler.h>
 #include <drivers/screen/screen.h>
 #include <memory.h>
+#include <mem/scratch.h>
 
 void print_to_stream(char *buffer) {
     PCB_t *pcb = get_latest_running_non_idle_process();
@@ -21,6 +22,9 @@ void print_to_stream(PCB_t *pcb, char *buffer) {
 
 void print_to_stream(PCB_t *pcb, char *buffer, uint8_t addNewline) {
     uint32_t buffer_len = strlen(buffer);
+
+    // processes of the same terminal may be printing from different CPUs at the same time
+    vfs_lock();
     uint32_t file_size = get_file_size(pcb->stdout);
 
     write(pcb->stdout, buffer, file_size, buffer_len);
@@ -30,13 +34,19 @@ void print_to_stream(PCB_t *pcb, char *buffer, uint8_t addNewline) {
     file_size = get_file_size(pcb->stdout);
 
     if (file_size >= MAX_SHELL_FILE_SIZE) {
-        char *copy_buffer = (char *)kmalloc(MAX_SHELL_FILE_SIZE);
-        memset(copy_buffer, 0, MAX_SHELL_FILE_SIZE);
-        read(pcb->stdout, copy_buffer, file_size - MAX_SHELL_FILE_SIZE, MAX_SHELL_FILE_SIZE);
-        delete_system_file(pcb->stdout);
-        touch(pcb->stdout);
-        set_as_system_file(pcb->stdout);
-        write(pcb->stdout, copy_buffer, 0, MAX_SHELL_FILE_SIZE);
-        kfree(copy_buffer);
+        scratch_mark_t mark = scratch_begin();
+        char *copy_buffer = (char *)scratch_alloc(MAX_SHELL_FILE_SIZE);
+
+        // out of memory, the file is trimmed next time
+        if (copy_buffer != NULL) {
+            memset(copy_buffer, 0, MAX_SHELL_FILE_SIZE);
+            read(pcb->stdout, copy_buffer, file_size - MAX_SHELL_FILE_SIZE, MAX_SHELL_FILE_SIZE);
+            delete_system_file(pcb->stdout);
+            touch(pcb->stdout);
+            set_as_system_file(pcb->stdout);
+            write(pcb->stdout, copy_buffer, 0, MAX_SHELL_FILE_SIZE);
+        }
+        scratch_end(mark);
     }
+    vfs_unlock();
 }
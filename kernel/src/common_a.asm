@@ -18,6 +18,28 @@ _inb:
     in      al, dx              ; read a byte from the I/O port and store it in the al
     ret                         ; return
 
+[global _insw]
+_insw:
+    push    edi                 ; edi is callee-saved
+    mov     dx, [esp + 8]       ; move the address of the I/O port into the dx register
+    mov     edi, [esp + 12]     ; buffer the words are stored into
+    mov     ecx, [esp + 16]     ; number of words
+    cld
+    rep     insw                ; read the words from the I/O port one by one
+    pop     edi
+    ret                         ; return
+
+[global _outsw]
+_outsw:
+    push    esi                 ; esi is callee-saved
+    mov     dx, [esp + 8]       ; move the address of the I/O port into the dx register
+    mov     esi, [esp + 12]     ; buffer the words are taken from
+    mov     ecx, [esp + 16]     ; number of words
+    cld
+    rep     outsw               ; send the words to the I/O port one by one
+    pop     esi
+    ret                         ; return
+
 [global _load_gdt]
 _load_gdt:
     mov     eax, [esp + 4]      ; move GDTR address to eax
@@ -57,6 +79,13 @@ _disable_interrupts:
     cli
     ret
 
+[global _interrupt_window]
+_interrupt_window:
+    sti                         ; interrupts are recognized after the next instruction
+    nop                         ; the pending ones get handled here
+    cli
+    ret
+
 [global _enable_paging]
 _enable_paging:
     mov     eax, cr0
@@ -82,6 +111,11 @@ _get_page_dir:
     mov     eax, cr3
     ret
 
+[global _get_cr2]
+_get_cr2:
+    mov     eax, cr2
+    ret
+
 [global _flush_tlb]
 _flush_tlb:
     mov     eax, [esp + 4]
@@ -95,4 +129,72 @@ _tss_flush:
                         ; long, but we set the bottom two bits (making 0x2B)
                         ; so that it has an RPL of 3, not zero.
     ltr ax              ; Load 0x2B into the task state register.
-    ret
\ No newline at end of file
+    ret
+
+[global _pause]
+_pause:
+    pause               ; let the CPU know we're spinning in a loop
+    ret
+
+[global _get_cr0]
+_get_cr0:
+    mov     eax, cr0
+    ret
+
+[global _set_cr0]
+_set_cr0:
+    mov     eax, [esp + 4]
+    mov     cr0, eax
+    ret
+
+[global _get_cr4]
+_get_cr4:
+    mov     eax, cr4
+    ret
+
+[global _set_cr4]
+_set_cr4:
+    mov     eax, [esp + 4]
+    mov     cr4, eax
+    ret
+
+[global _cpuid_edx]
+_cpuid_edx:
+    push    ebx                 ; cpuid overwrites ebx (callee-saved)
+    mov     eax, [esp + 8]      ; leaf
+    cpuid
+    mov     eax, edx
+    pop     ebx
+    ret
+
+[global _rdtsc]
+_rdtsc:
+    rdtsc                       ; edx:eax = number of cycles since reset
+    ret
+
+[global _clts]
+_clts:
+    clts                        ; clear CR0.TS, so the FPU can be used without #NM
+    ret
+
+[global _fninit]
+_fninit:
+    fninit
+    ret
+
+[global _fxsave]
+_fxsave:
+    mov     eax, [esp + 4]      ; 512B area aligned to 16B
+    fxsave  [eax]
+    ret
+
+[global _fxrstor]
+_fxrstor:
+    mov     eax, [esp + 4]      ; 512B area aligned to 16B
+    fxrstor [eax]
+    ret
+
+[global _ldmxcsr]
+_ldmxcsr:
+    ldmxcsr [esp + 4]
+    ret
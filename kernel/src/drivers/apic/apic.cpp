@@ -0,0 +1,88 @@
+#include <drivers/apic/apic.h>
+#include <drivers/pit/pit.h>
+#include <mem/paging.h>
+#include <common.h>
+
+// registers of the local APIC (every CPU sees its own one at the same address)
+static volatile uint32_t *lapic = reinterpret_cast<uint32_t *>(LAPIC_VIRT_ADDR);
+
+// number of timer ticks (divided by 16) that make up one period of the PIT
+static uint32_t timer_ticks_per_period;
+
+static uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / sizeof(uint32_t)];
+}
+
+static void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / sizeof(uint32_t)] = value;
+}
+
+static void wait_for_delivery() {
+    while (lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_DELIVERY_PENDING)
+        _pause();
+}
+
+int LAPIC_init(uint32_t phys_addr) {
+    // map the registers into the kernel's 4MB, so they're
+    // accessible from the address space of any process
+    map_mmio_page(LAPIC_VIRT_ADDR, phys_addr);
+    LAPIC_enable();
+
+    // measure how many ticks the timer does during one period of the PIT
+    // (all CPUs share the same bus frequency, so we only need to do this once)
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_BY_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_MASKED);
+    lapic_write(LAPIC_REG_TIMER_INITIAL, 0xFFFFFFFF);
+    PIT_wait(1000000 / FREQUENCY);
+    timer_ticks_per_period = 0xFFFFFFFF - lapic_read(LAPIC_REG_TIMER_CURRENT);
+    lapic_write(LAPIC_REG_TIMER_INITIAL, 0);
+
+    return timer_ticks_per_period == 0;
+}
+
+void LAPIC_enable() {
+    // accept all interrupts and set the spurious interrupt vector
+    // which also enables the local APIC of the current CPU
+    lapic_write(LAPIC_REG_TPR, 0);
+    lapic_write(LAPIC_REG_SPURIOUS, LAPIC_SOFTWARE_ENABLE | LAPIC_SPURIOUS_VECTOR);
+}
+
+uint32_t LAPIC_get_id() {
+    return lapic_read(LAPIC_REG_ID) >> 24;
+}
+
+void LAPIC_send_EOI() {
+    lapic_write(LAPIC_REG_EOI, 0);
+}
+
+void LAPIC_send_INIT(uint32_t lapic_id) {
+    // assert INIT and de-assert it right after (required by older CPUs)
+    lapic_write(LAPIC_REG_ICR_HIGH, lapic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT | LAPIC_ICR_LEVEL_TRIGGER);
+    wait_for_delivery();
+    lapic_write(LAPIC_REG_ICR_HIGH, lapic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL_TRIGGER);
+    wait_for_delivery();
+}
+
+void LAPIC_send_SIPI(uint32_t lapic_id, uint8_t vector) {
+    // the AP starts executing in real mode at vector * 4KB
+    lapic_write(LAPIC_REG_ICR_HIGH, lapic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, LAPIC_ICR_STARTUP | vector);
+    wait_for_delivery();
+}
+
+void LAPIC_send_IPI(uint32_t lapic_id, uint8_t vector) {
+    // fixed delivery mode, edge-triggered
+    lapic_write(LAPIC_REG_ICR_HIGH, lapic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, vector);
+    wait_for_delivery();
+}
+
+void LAPIC_timer_init() {
+    // APs don't receive the PIT interrupt, so they use their own timer
+    // firing at the same frequency to preempt processes
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_BY_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_INITIAL, timer_ticks_per_period);
+}
@@ -0,0 +1,133 @@
+#include <drivers/ata/ata.h>
+#include <common.h>
+
+// The master drive of the primary bus (-hda in QEMU) accessed in PIO mode with 28-bit LBA.
+// The kernel runs with interrupts disabled, so the drive's IRQ is turned off and the status
+// register is polled instead. The functions are not locked, the block cache serializes them.
+
+static uint32_t sector_count; // 0 = there's no drive
+
+static void ata_delay() {
+    // reading the alternate status register takes ~100ns, the drive needs 400ns
+    // after it has been selected before its status can be trusted
+    uint32_t i;
+    for (i = 0; i < 4; i++)
+        _inb(ATA_CONTROL_PORT);
+}
+
+static int ata_wait_ready() {
+    uint32_t i;
+    for (i = 0; i < ATA_TIMEOUT; i++)
+        if ((_inb(ATA_COMMAND_PORT) & ATA_STATUS_BSY) == 0)
+            return 0;
+    return 1;
+}
+
+static int ata_wait_data() {
+    // wait until the drive has (or wants) the next sector
+    uint32_t i;
+    for (i = 0; i < ATA_TIMEOUT; i++) {
+        uint8_t status = _inb(ATA_COMMAND_PORT);
+        if (status & ATA_STATUS_BSY)
+            continue;
+        if (status & (ATA_STATUS_ERR | ATA_STATUS_DF))
+            return 1;
+        if (status & ATA_STATUS_DRQ)
+            return 0;
+    }
+    return 1;
+}
+
+static void ata_send_command(uint32_t lba, uint32_t count, uint8_t command) {
+    _outb(ATA_DRIVE_PORT, ATA_DRIVE_LBA | ((lba >> 24) & 0x0F));
+    ata_delay();
+    _outb(ATA_SECTOR_COUNT_PORT, (uint8_t)count);
+    _outb(ATA_LBA_LOW_PORT, (uint8_t)lba);
+    _outb(ATA_LBA_MID_PORT, (uint8_t)(lba >> 8));
+    _outb(ATA_LBA_HIGH_PORT, (uint8_t)(lba >> 16));
+    _outb(ATA_COMMAND_PORT, command);
+}
+
+static uint8_t is_valid_request(uint32_t lba, uint32_t count) {
+    return count != 0 && count <= ATA_MAX_SECTORS && lba < sector_count && count <= sector_count - lba;
+}
+
+int ata_init() {
+    uint16_t identify[ATA_SECTOR_SIZE / sizeof(uint16_t)];
+    sector_count = 0;
+
+    // a floating bus reads as 0xFF (there's no controller at all)
+    if (_inb(ATA_COMMAND_PORT) == 0xFF)
+        return 0;
+    _outb(ATA_CONTROL_PORT, ATA_CONTROL_NIEN);
+    _outb(ATA_DRIVE_PORT, ATA_DRIVE_MASTER);
+    ata_delay();
+
+    // https://wiki.osdev.org/ATA_PIO_Mode#IDENTIFY_command
+    _outb(ATA_SECTOR_COUNT_PORT, 0);
+    _outb(ATA_LBA_LOW_PORT, 0);
+    _outb(ATA_LBA_MID_PORT, 0);
+    _outb(ATA_LBA_HIGH_PORT, 0);
+    _outb(ATA_COMMAND_PORT, ATA_CMD_IDENTIFY);
+    if (_inb(ATA_COMMAND_PORT) == 0 || ata_wait_ready() != 0)
+        return 0;
+
+    // ATAPI and SATA devices set the LBA registers (e.g. the CD-ROM), they're not supported
+    if (_inb(ATA_LBA_MID_PORT) != 0 || _inb(ATA_LBA_HIGH_PORT) != 0)
+        return 0;
+    if (ata_wait_data() != 0)
+        return 0;
+    _insw(ATA_DATA_PORT, identify, ATA_SECTOR_SIZE / sizeof(uint16_t));
+
+    // words 60-61 hold the number of sectors addressable with 28-bit LBA
+    sector_count = identify[60] | ((uint32_t)identify[61] << 16);
+    if (sector_count > ATA_MAX_LBA28)
+        sector_count = ATA_MAX_LBA28;
+
+    // a missing drive is not an error, the file system just lives in the memory only
+    return 0;
+}
+
+uint32_t ata_get_sector_count() {
+    return sector_count;
+}
+
+int ata_read(uint32_t lba, uint32_t count, void *buffer) {
+    if (is_valid_request(lba, count) == 0 || ata_wait_ready() != 0)
+        return 1;
+    ata_send_command(lba, count, ATA_CMD_READ_SECTORS);
+
+    uint32_t i;
+    uint8_t *data = (uint8_t *)buffer;
+    for (i = 0; i < count; i++) {
+        if (ata_wait_data() != 0)
+            return 1;
+        _insw(ATA_DATA_PORT, &data[i * ATA_SECTOR_SIZE], ATA_SECTOR_SIZE / sizeof(uint16_t));
+    }
+    return 0;
+}
+
+int ata_write(uint32_t lba, uint32_t count, const void *buffer) {
+    if (is_valid_request(lba, count) == 0 || ata_wait_ready() != 0)
+        return 1;
+    ata_send_command(lba, count, ATA_CMD_WRITE_SECTORS);
+
+    uint32_t i;
+    const uint8_t *data = (const uint8_t *)buffer;
+    for (i = 0; i < count; i++) {
+        if (ata_wait_data() != 0)
+            return 1;
+        _outsw(ATA_DATA_PORT, &data[i * ATA_SECTOR_SIZE], ATA_SECTOR_SIZE / sizeof(uint16_t));
+    }
+    return ata_wait_ready();
+}
+
+int ata_flush() {
+    // make the drive write its own cache out
+    if (sector_count == 0 || ata_wait_ready() != 0)
+        return 1;
+    _outb(ATA_DRIVE_PORT, ATA_DRIVE_LBA);
+    ata_delay();
+    _outb(ATA_COMMAND_PORT, ATA_CMD_CACHE_FLUSH);
+    return ata_wait_ready();
+}
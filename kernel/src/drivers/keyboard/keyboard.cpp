@@ -5,6 +5,7 @@
 #include <memory.h>
 #include <processes/scheduler.h>
 #include <interrupts/irq.h>
+#include <smp/smp.h>
 
 // Keyboard buffer
 char keyboard_buffer[KEYBOARD_BUFF_SIZE];
@@ -31,12 +32,21 @@ void abort_current_cmd() {
         keyboard_buff_pos = 0;
     }
     else {
-        wake_up_parent_process(running_process->ppid, 1);
-        kill_process(running_process);
+        PCB_t *curr_on_cpu = get_running_process();
+        uint8_t in_kernel = get_cpu()->in_preempt_point;
+
+        if (in_kernel && curr_on_cpu == running_process) {
+            // the process is in the middle of a syscall, it gets killed once it's done
+            running_process->pending_kill = 1;
+        } else {
+            kill_process(running_process);
+        }
         kprintf("^C\n\r");
         keyboard_buff_pos = 0;
-        PIC_sendEOI(PS2_KEYBOARD);
-        PCB_t *curr_on_cpu = get_running_process();
+
+        // go back to the interrupted kernel code
+        if (in_kernel)
+            return;
         if (curr_on_cpu != running_process){
             set_process_as_ready(curr_on_cpu);
         }
@@ -1,12 +1,51 @@
 #include <drivers/pit/pit.h>
 #include <stdint.h>
 #include <common.h>
+#include <math.h>
+
+// number of periods of channel 0 since the start (only the BSP receives them)
+static volatile uint32_t ticks;
 
 int PIT_init() {
-    uint32_t divisor = 1193180 / FREQUENCY;  // Calculate our divisor 1.19MHz (1193180Hz)
+    uint32_t divisor = PIT_BASE_FREQUENCY / FREQUENCY; // Calculate our divisor 1.19MHz (1193180Hz)
     _outb(PIT_CMD, 0x36);                    // Set our command byte 0x36 (RW + square wave)
     _outb(PIT0_DATA, divisor & 0xFF);        // Set low byte of divisor
     _outb(PIT0_DATA, divisor >> 8);          // Set high byte of divisor
 
     return 0;
-}
\ No newline at end of file
+}
+
+void PIT_wait(uint32_t microseconds) {
+    uint32_t chunk;
+    uint32_t count;
+
+    // channel 0 keeps generating the scheduler ticks, so the busy
+    // waiting is done using channel 2 (one-shot, polling its output)
+    while (microseconds > 0) {
+        chunk = min(microseconds, PIT_MAX_WAIT_US);
+        count = (PIT_BASE_FREQUENCY / 1000) * chunk / 1000;
+        if (count == 0)
+            count = 1;
+
+        // disable the gate (and the speaker) while setting up the counter
+        _outb(PIT2_GATE_PORT, _inb(PIT2_GATE_PORT) & ~(PIT2_GATE | PIT2_SPEAKER));
+
+        _outb(PIT_CMD, 0xB0);                // channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+        _outb(PIT2_DATA, count & 0xFF);      // Set low byte of the count
+        _outb(PIT2_DATA, count >> 8);        // Set high byte of the count
+
+        // start counting and wait until the output goes high
+        _outb(PIT2_GATE_PORT, _inb(PIT2_GATE_PORT) | PIT2_GATE);
+        while ((_inb(PIT2_GATE_PORT) & PIT2_OUTPUT) == 0)
+            ;
+        microseconds -= chunk;
+    }
+}
+
+void PIT_tick() {
+    ticks++;
+}
+
+uint32_t PIT_get_uptime_ms() {
+    return ticks * (1000 / FREQUENCY);
+}
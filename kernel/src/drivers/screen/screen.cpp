@@ -3,11 +3,17 @@
 #include <common.h>
 #include <string.h>
 #include <memory.h>
+#include <spinlock.h>
 
 // Screen buffer
 static char screen_buffer[SCREEN_BUFFER_SIZE];
 uint8_t screen_color;
 
+// Serializes printing from multiple CPUs (also protects screen_buffer)
+static spinlock_t screen_lock;
+
+static void write_string(const char* string);
+
 // Sets cursor position
 void set_cursor(uint32_t offset) {
     offset /= 2;
@@ -61,6 +67,7 @@ static uint32_t scroll_handler(uint32_t offset) {
 
 // Printf implementation (what else to say)
 void kprintf(char *c, ...) {
+    spinlock_acquire(&screen_lock);
     memset(screen_buffer, 0, SCREEN_BUFFER_SIZE);
     char convertor_buffer[CONVERTOR_BUFFER_SIZE];
     va_list lst;
@@ -104,11 +111,18 @@ void kprintf(char *c, ...) {
         c++;
     }
     va_end(lst);
-    print_string(screen_buffer);
+    write_string(screen_buffer);
+    spinlock_release(&screen_lock);
 }
 
 // Prints string to current cursor position
 void print_string(const char* string) {
+    spinlock_acquire(&screen_lock);
+    write_string(string);
+    spinlock_release(&screen_lock);
+}
+
+static void write_string(const char* string) {
     uint32_t offset = get_cursor();
     uint32_t i = 0;
     static uint8_t prev_mouse_x_pos = 0;
@@ -144,9 +158,11 @@ void print_string(const char* string) {
 
 // Backspace printer
 void print_backspace() {
+    spinlock_acquire(&screen_lock);
     uint32_t cursor = get_cursor() - 2;
     set_char(' ', cursor);
     set_cursor(cursor);
+    spinlock_release(&screen_lock);
 }
 
 // Newline printer
@@ -198,9 +214,11 @@ void reset_color() {
 // Clears the screen
 void clear_screen() {
     uint32_t i;
+    spinlock_acquire(&screen_lock);
     reset_color();
     for(i = 0; i < MAX_COLS * MAX_ROWS; i++) {
         set_char(' ', i * 2);
     }
     set_cursor(get_offset(0, 0));
+    spinlock_release(&screen_lock);
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include <fpu/fpu.h>
+#include <mem/heap.h>
+#include <smp/smp.h>
+#include <common.h>
+#include <memory.h>
+
+// FPU/SSE state is switched lazily - CR0.TS is set whenever a process is switched
+// out, so only a process that actually uses the FPU traps into #NM and gets its state
+// loaded. Processes that never touch the FPU never pay for saving/restoring it.
+
+static uint8_t fpu_available;
+
+int FPU_init() {
+    // without FXSAVE/FXRSTOR, the FPU stays disabled and any use of it kills the process
+    uint32_t features = _cpuid_edx(CPUID_FEATURES);
+    if ((features & CPUID_EDX_FXSR) == 0 || (features & CPUID_EDX_SSE) == 0) {
+        fpu_available = 0;
+        _set_cr0(_get_cr0() | CR0_EM_BIT);
+        return 0;
+    }
+    _set_cr0((_get_cr0() & ~(CR0_EM_BIT | CR0_TS_BIT)) | CR0_MP_BIT | CR0_NE_BIT);
+    _set_cr4(_get_cr4() | CR4_OSFXSR_BIT | CR4_OSXMMEXCPT_BIT);
+    _fninit();
+
+    // nobody owns the FPU of this CPU yet
+    _set_cr0(_get_cr0() | CR0_TS_BIT);
+    fpu_available = 1;
+    return 0;
+}
+
+void FPU_init_process(PCB_t *pcb) {
+    // the FXSAVE area is only allocated once the process uses the FPU
+    pcb->fpu_state = NULL;
+    pcb->fpu_state_alloc = NULL;
+    pcb->fpu_cpu = FPU_NO_CPU;
+}
+
+static int allocate_fpu_state(PCB_t *pcb) {
+    // FXSAVE/FXRSTOR require the area to be aligned to 16B
+    pcb->fpu_state_alloc = kmalloc(FXSAVE_AREA_SIZE + FXSAVE_AREA_ALIGNMENT);
+    if (pcb->fpu_state_alloc == NULL)
+        return 1;
+    uint32_t addr = (uint32_t)pcb->fpu_state_alloc;
+    pcb->fpu_state = (uint8_t *)((addr + FXSAVE_AREA_ALIGNMENT - 1) & ~(FXSAVE_AREA_ALIGNMENT - 1));
+    return 0;
+}
+
+void FPU_free_process(PCB_t *pcb) {
+    uint32_t i;
+    for (i = 0; i < get_cpu_count(); i++) {
+        if (get_cpu_by_index(i)->fpu_owner == pcb)
+            get_cpu_by_index(i)->fpu_owner = NULL;
+    }
+    if (pcb->fpu_state_alloc != NULL)
+        kfree(pcb->fpu_state_alloc);
+    FPU_init_process(pcb);
+}
+
+void FPU_switch_out(PCB_t *pcb) {
+    if (fpu_available == 0)
+        return;
+
+    // CR0.TS is clear only if the process has used the FPU during its time slice
+    // (its state is saved right away as the process may run on another CPU next time)
+    uint32_t cr0 = _get_cr0();
+    if ((cr0 & CR0_TS_BIT) == 0) {
+        if (pcb != NULL && get_cpu()->fpu_owner == pcb)
+            _fxsave(pcb->fpu_state);
+        _set_cr0(cr0 | CR0_TS_BIT);
+    }
+}
+
+int FPU_device_not_available(PCB_t *pcb) {
+    if (fpu_available == 0)
+        return 1;
+
+    cpu_t *cpu = get_cpu();
+    _clts();
+
+    // the FPU registers of this CPU still hold the state of the process
+    if (cpu->fpu_owner == pcb && pcb->fpu_cpu == cpu->index)
+        return 0;
+
+    if (pcb->fpu_state == NULL) {
+        // the very first use of the FPU by the process
+        if (allocate_fpu_state(pcb) != 0)
+            return 1;
+        _fninit();
+        _ldmxcsr(MXCSR_DEFAULT);
+    } else {
+        _fxrstor(pcb->fpu_state);
+    }
+    cpu->fpu_owner = pcb;
+    pcb->fpu_cpu = cpu->index;
+    return 0;
+}
+
+void FPU_copy_state(PCB_t *dest, PCB_t *src) {
+    if (src->fpu_state == NULL)
+        return;
+
+    // the latest state may still be only in the FPU registers of this CPU
+    if ((_get_cr0() & CR0_TS_BIT) == 0 && get_cpu()->fpu_owner == src)
+        _fxsave(src->fpu_state);
+
+    if (dest->fpu_state == NULL && allocate_fpu_state(dest) != 0)
+        return;
+    memcpy(dest->fpu_state, src->fpu_state, FXSAVE_AREA_SIZE);
+}
@@ -0,0 +1,295 @@
+#include <fs/bcache.h>
+#include <drivers/ata/ata.h>
+#include <drivers/pit/pit.h>
+#include <drivers/screen/screen.h>
+#include <mem/heap.h>
+#include <memory.h>
+#include <spinlock.h>
+#include <common.h>
+#include <math.h>
+
+#define SECTORS_PER_BLOCK (BLOCK_SIZE / ATA_SECTOR_SIZE)
+
+// Blocks of the disk kept in memory. The buffers are found through a hash index on the block
+// numbers and the least recently used one is reused when a block is missing. Written blocks
+// are only marked as dirty and go to the disk once they're evicted or flushed (consecutive
+// dirty blocks by a single command). A miss right behind the previous one is taken
+// as a sequential reader, so the blocks that follow are read in along with it.
+
+static buffer_t buffers[BCACHE_BLOCKS];
+static buffer_t *hash[BCACHE_HASH_SIZE];
+static buffer_t *lru_head;
+static buffer_t *lru_tail;
+static uint32_t block_count;     // 0 = there's no disk
+static uint32_t next_sequential; // block a sequential reader would miss next
+static bcache_stats_t stats;
+
+// the PIT doesn't tick while the kernel runs with interrupts disabled, so the disk
+// is timed by the TSC (in units of 1024 cycles, which fit in 32 bits for a long time)
+static uint32_t kcycles_per_ms;
+static uint32_t read_kcycles;
+static uint32_t write_kcycles;
+static spinlock_t bcache_lock;
+
+// runs of blocks are transferred through here
+static uint8_t staging[BCACHE_MAX_RUN * BLOCK_SIZE];
+
+static uint32_t get_kcycles() {
+    return (uint32_t)(_rdtsc() >> 10);
+}
+
+static void lru_remove(buffer_t *buffer) {
+    if (buffer->prev != NULL)
+        buffer->prev->next = buffer->next;
+    else
+        lru_head = buffer->next;
+    if (buffer->next != NULL)
+        buffer->next->prev = buffer->prev;
+    else
+        lru_tail = buffer->prev;
+}
+
+static void lru_push_front(buffer_t *buffer) {
+    buffer->prev = NULL;
+    buffer->next = lru_head;
+    if (lru_head != NULL)
+        lru_head->prev = buffer;
+    else
+        lru_tail = buffer;
+    lru_head = buffer;
+}
+
+static void lru_push_back(buffer_t *buffer) {
+    buffer->next = NULL;
+    buffer->prev = lru_tail;
+    if (lru_tail != NULL)
+        lru_tail->next = buffer;
+    else
+        lru_head = buffer;
+    lru_tail = buffer;
+}
+
+static buffer_t *lookup(uint32_t block) {
+    buffer_t *buffer;
+    for (buffer = hash[block & (BCACHE_HASH_SIZE - 1)]; buffer != NULL; buffer = buffer->hash_next)
+        if (buffer->block == block)
+            return buffer;
+    return NULL;
+}
+
+static void hash_insert(buffer_t *buffer) {
+    buffer_t **bucket = &hash[buffer->block & (BCACHE_HASH_SIZE - 1)];
+    buffer->hash_next = *bucket;
+    *bucket = buffer;
+}
+
+static void hash_remove(buffer_t *buffer) {
+    buffer_t **curr = &hash[buffer->block & (BCACHE_HASH_SIZE - 1)];
+    while (*curr != buffer)
+        curr = &(*curr)->hash_next;
+    *curr = buffer->hash_next;
+}
+
+static uint8_t is_dirty(uint32_t block) {
+    buffer_t *buffer = lookup(block);
+    return buffer != NULL && buffer->dirty;
+}
+
+static uint32_t write_run(buffer_t *buffer) {
+    // the dirty neighbours of the block are written along with it
+    uint32_t first = buffer->block;
+    while (first > 0 && buffer->block - first + 1 < BCACHE_MAX_RUN && is_dirty(first - 1))
+        first--;
+    uint32_t run = 0;
+    while (run < BCACHE_MAX_RUN && first + run < block_count && is_dirty(first + run)) {
+        memcpy(&staging[run * BLOCK_SIZE], lookup(first + run)->data, BLOCK_SIZE);
+        run++;
+    }
+
+    uint32_t start = get_kcycles();
+    if (ata_write(first * SECTORS_PER_BLOCK, run * SECTORS_PER_BLOCK, staging) != 0)
+        return 0;
+    write_kcycles += get_kcycles() - start;
+    stats.blocks_written += run;
+
+    uint32_t i;
+    for (i = 0; i < run; i++)
+        lookup(first + i)->dirty = 0;
+    return run;
+}
+
+static buffer_t *take_buffer() {
+    // reuse the least recently used buffer, a dirty block has to be written out first
+    // (if the disk refuses it, the block stays cached and the next one is tried)
+    buffer_t *buffer;
+    for (buffer = lru_tail; buffer != NULL; buffer = buffer->prev)
+        if (buffer->dirty == 0 || write_run(buffer) != 0)
+            break;
+    if (buffer == NULL)
+        return NULL;
+    if (buffer->valid)
+        hash_remove(buffer);
+    lru_remove(buffer);
+    buffer->valid = 0;
+    buffer->dirty = 0;
+    return buffer;
+}
+
+static buffer_t *read_blocks(uint32_t block) {
+    uint32_t run = 1;
+    if (block == next_sequential)
+        while (run < BCACHE_MAX_RUN && block + run < block_count && lookup(block + run) == NULL)
+            run++;
+
+    // the buffers are taken first, evicting a dirty block goes through the staging area as well
+    // (fewer blocks are read ahead if there aren't enough buffers that can be reused)
+    buffer_t *taken[BCACHE_MAX_RUN];
+    uint32_t i;
+    for (i = 0; i < run; i++)
+        if ((taken[i] = take_buffer()) == NULL)
+            break;
+    run = i;
+    if (run == 0)
+        return NULL;
+
+    uint32_t start = get_kcycles();
+    if (ata_read(block * SECTORS_PER_BLOCK, run * SECTORS_PER_BLOCK, staging) != 0) {
+        for (i = 0; i < run; i++)
+            lru_push_back(taken[i]);
+        return NULL;
+    }
+    read_kcycles += get_kcycles() - start;
+    stats.blocks_read += run;
+    stats.readahead += run - 1;
+    next_sequential = block + run;
+
+    // the requested block ends up at the head of the LRU list
+    for (i = run; i-- > 0;) {
+        taken[i]->block = block + i;
+        taken[i]->valid = 1;
+        memcpy(taken[i]->data, &staging[i * BLOCK_SIZE], BLOCK_SIZE);
+        hash_insert(taken[i]);
+        lru_push_front(taken[i]);
+    }
+    return taken[0];
+}
+
+int bcache_init() {
+    spinlock_init(&bcache_lock);
+    block_count = ata_get_sector_count() / SECTORS_PER_BLOCK;
+    if (block_count == 0)
+        return 0;
+
+    // measure how many cycles the CPU does during one period of the PIT
+    uint32_t start = get_kcycles();
+    PIT_wait(1000000 / FREQUENCY);
+    kcycles_per_ms = max((get_kcycles() - start) / (1000 / FREQUENCY), 1);
+
+    uint32_t i;
+    for (i = 0; i < BCACHE_BLOCKS; i++) {
+        buffers[i].data = (uint8_t *)kmalloc(BLOCK_SIZE);
+        if (buffers[i].data == NULL)
+            return 1;
+        lru_push_back(&buffers[i]);
+    }
+    return 0;
+}
+
+uint32_t bcache_get_block_count() {
+    return block_count;
+}
+
+int bcache_read(uint32_t block, void *buffer) {
+    if (block >= block_count)
+        return 1;
+    spinlock_acquire(&bcache_lock);
+    buffer_t *cached = lookup(block);
+    if (cached != NULL) {
+        stats.hits++;
+        lru_remove(cached);
+        lru_push_front(cached);
+    } else {
+        stats.misses++;
+        cached = read_blocks(block);
+    }
+    if (cached != NULL)
+        memcpy(buffer, cached->data, BLOCK_SIZE);
+    spinlock_release(&bcache_lock);
+    return cached == NULL;
+}
+
+int bcache_write(uint32_t block, const void *buffer) {
+    // the whole block is overwritten, so a missing one doesn't have to be read in
+    if (block >= block_count)
+        return 1;
+    spinlock_acquire(&bcache_lock);
+    buffer_t *cached = lookup(block);
+    if (cached == NULL) {
+        cached = take_buffer();
+        if (cached == NULL) {
+            spinlock_release(&bcache_lock);
+            return 1;
+        }
+        cached->block = block;
+        cached->valid = 1;
+        hash_insert(cached);
+    } else {
+        lru_remove(cached);
+    }
+    memcpy(cached->data, buffer, BLOCK_SIZE);
+    cached->dirty = 1;
+    lru_push_front(cached);
+    spinlock_release(&bcache_lock);
+    return 0;
+}
+
+uint32_t bcache_flush(uint32_t max_blocks, uint8_t wait) {
+    // write back the dirty blocks starting with the least recently used ones
+    // (an idle CPU doesn't wait for the lock, it will try again later)
+    if (block_count == 0)
+        return 0;
+    if (wait)
+        spinlock_acquire(&bcache_lock);
+    else if (atomic_xchg(&bcache_lock, 1) != 0)
+        return 0;
+
+    uint32_t written = 0;
+    buffer_t *buffer;
+    for (buffer = lru_tail; buffer != NULL && written < max_blocks; buffer = buffer->prev)
+        if (buffer->dirty)
+            written += write_run(buffer);
+    if (written != 0)
+        ata_flush();
+    spinlock_release(&bcache_lock);
+    return written;
+}
+
+uint32_t bcache_get_dirty_count() {
+    spinlock_acquire(&bcache_lock);
+    uint32_t count = 0;
+    uint32_t i;
+    for (i = 0; i < BCACHE_BLOCKS; i++)
+        count += buffers[i].dirty;
+    spinlock_release(&bcache_lock);
+    return count;
+}
+
+void bcache_get_stats(bcache_stats_t *copy) {
+    spinlock_acquire(&bcache_lock);
+    *copy = stats;
+    if (kcycles_per_ms != 0) {
+        copy->read_ms = read_kcycles / kcycles_per_ms;
+        copy->write_ms = write_kcycles / kcycles_per_ms;
+    }
+    spinlock_release(&bcache_lock);
+}
+
+void bcache_print_stats() {
+    bcache_stats_t copy;
+    bcache_get_stats(&copy);
+    uint32_t lookups = copy.hits + copy.misses;
+    kprintf("%d MB, %d KB read (%d KB ahead) in %d ms, %d KB written in %d ms, %d%% cache hits\n\r",
+            block_count / (1024 * 1024 / BLOCK_SIZE), copy.blocks_read * (BLOCK_SIZE / 1024),
+            copy.readahead * (BLOCK_SIZE / 1024), copy.read_ms, copy.blocks_written * (BLOCK_SIZE / 1024),
+            copy.write_ms, (lookups == 0) ? 0 : copy.hits * 100 / lookups);
+}
@@ -0,0 +1,1106 @@
+#include <fs/fat.h>
+#include <fs/bcache.h>
+#include <mem/heap.h>
+#include <common.h>
+#include <memory.h>
+#include <string.h>
+#include <drivers/screen/screen.h>
+
+#define CLUSTER_ADDR(index)        (fs.cluster_start_addr + ((index) * fs.cluster_size))
+#define MAX_FILES_IN_FIRST_CLUSTER ((fs.cluster_size - sizeof(uint32_t)) / sizeof(file_t))
+#define MAX_FILES_IN_ONE_CLUSTER   (fs.cluster_size / sizeof(file_t))
+#define ROOT_INDEX                 ((uint32_t)-1) // the inode of the root dir (it has no entry of its own)
+
+// The FAT is the root file system of the VFS. It's held in a region of the memory
+// (stored on the disk, if there's one) and there's only one of it, so the state
+// passed to its operations is just the geometry of the region. An inode is the dir
+// a file is stored in along with the position of the file within it.
+
+// the layout of the file system depends on the size of its region (see fat_init())
+static fs_geometry_t fs;
+static volatile uint16_t *fat16 = reinterpret_cast<uint16_t *>(FS_START_ADDR);
+static volatile uint32_t *fat32 = reinterpret_cast<uint32_t *>(FS_START_ADDR);
+
+// free clusters are tracked alongside the FAT (a set bit = a free cluster),
+// so allocating a cluster doesn't have to scan the entries one by one
+static uint32_t *free_clusters = NULL;
+static uint32_t free_cluster_count;
+static uint32_t free_cluster_hint; // no free cluster below this word of the bitmap
+
+// every directory stays in memory once it has been looked up (the root dir all the time),
+// the entries are found through a hash index on their names which grows along with
+// the directory and only the clusters that have changed are written back
+static dir_t *root = NULL;
+
+// if there's a disk, the region is stored on it right behind a header block, the blocks
+// of the region that have changed are marked here and handed over to the block cache
+// from time to time (an idle CPU does so every now and then, see fs_flush())
+static uint32_t *dirty_blocks = NULL; // NULL = the file system lives in the memory only
+
+static void save_dir(dir_t *dir);
+static void mark_file_dirty(dir_t *dir, file_t *file);
+static uint32_t get_cluster_count_needed(uint32_t size);
+static int exists_n_free_clusters(uint32_t n);
+static uint32_t get_free_cluster();
+static void set_cluster_free(uint32_t cluster);
+static uint32_t get_free_cluster_after(uint32_t cluster);
+static void free_file_extents(dir_t *dir, file_t *file);
+static void free_all_occupied_clusters(uint32_t start_cluster);
+static dir_t *alloc_dir();
+static file_t *find_entry(dir_t *dir, const char *name);
+static int create_file(dir_t *dir, const char *filename, uint8_t directory);
+static void delete_file(dir_t *dir, file_t *file);
+static void create_default_files();
+static int append_to_file(dir_t *dir, file_t *file, char *buffer, uint32_t bytes);
+static dir_t *load_dir(file_t *entry);
+
+static void mark_fs_dirty(uint32_t addr, uint32_t len) {
+    if (dirty_blocks == NULL || len == 0)
+        return;
+    uint32_t block;
+    for (block = (addr - FS_START_ADDR) / BLOCK_SIZE; block <= (addr + len - 1 - FS_START_ADDR) / BLOCK_SIZE; block++)
+        dirty_blocks[block / 32] |= 1 << (block % 32);
+}
+
+static uint32_t sync_blocks(uint32_t max_blocks) {
+    // hand the changed blocks of the region over to the block cache
+    uint32_t synced = 0;
+    uint32_t i;
+    for (i = 0; i < fs.size / BLOCK_SIZE / 32 && synced < max_blocks; i++)
+        while (dirty_blocks[i] != 0 && synced < max_blocks) {
+            // the block stays marked if the cache cannot take it (the disk refuses the blocks it holds)
+            uint32_t block = i * 32 + __builtin_ctz(dirty_blocks[i]);
+            if (bcache_write(FS_DISK_FIRST_BLOCK + block, (void *)(FS_START_ADDR + block * BLOCK_SIZE)) != 0)
+                return synced;
+            dirty_blocks[i] &= dirty_blocks[i] - 1;
+            synced++;
+        }
+    return synced;
+}
+
+static uint8_t is_handed_over() {
+    // no block is waiting to be handed over to the block cache
+    uint32_t i;
+    for (i = 0; i < fs.size / BLOCK_SIZE / 32; i++)
+        if (dirty_blocks[i] != 0)
+            return 0;
+    return 1;
+}
+
+static uint8_t is_synced() {
+    // nothing is waiting to be written to the disk
+    return is_handed_over() && bcache_get_dirty_count() == 0;
+}
+
+static uint32_t get_fat(uint32_t cluster) {
+    // the special values (EOF, free, taken) read the same no matter how wide the entries are
+    if (fs.fat_entry_size == sizeof(uint16_t)) {
+        uint32_t value = fat16[cluster];
+        return (value >= FAT16_RESERVED) ? (value | 0x0FFF0000) : value;
+    }
+    return fat32[cluster];
+}
+
+static void set_fat(uint32_t cluster, uint32_t value) {
+    if (fs.fat_entry_size == sizeof(uint16_t))
+        fat16[cluster] = (uint16_t)value;
+    else
+        fat32[cluster] = value;
+    mark_fs_dirty(FS_START_ADDR + cluster * fs.fat_entry_size, fs.fat_entry_size);
+}
+
+static void set_geometry(uint32_t size) {
+    // pick the smallest clusters that keep the FAT at a reasonable
+    // size and the narrowest FAT entries that can address all of them
+    fs.size = size;
+    fs.cluster_size = FS_MIN_CLUSTER_SIZE;
+    while (fs.cluster_size < FS_MAX_CLUSTER_SIZE && size / fs.cluster_size > FS_MAX_CLUSTERS)
+        fs.cluster_size *= 2;
+    fs.fat_entry_size = sizeof(uint16_t);
+    fs.cluster_count = size / (fs.fat_entry_size + fs.cluster_size);
+    if (fs.cluster_count >= FAT16_RESERVED) {
+        fs.fat_entry_size = sizeof(uint32_t);
+        fs.cluster_count = size / (fs.fat_entry_size + fs.cluster_size);
+    }
+    fs.bitmap_size = (fs.cluster_count + 31) / 32;
+
+    // the clusters start right after the FAT (aligned, so a 4KB cluster takes up a single page)
+    uint32_t fat_size = fs.fat_entry_size * fs.cluster_count;
+    fs.cluster_start_addr = FS_START_ADDR + ((fat_size + fs.cluster_size - 1) & ~(fs.cluster_size - 1));
+    while (fs.cluster_start_addr + fs.cluster_count * fs.cluster_size > FS_START_ADDR + size)
+        fs.cluster_count--;
+}
+
+uint32_t get_free_cluster_count() {
+    vfs_lock();
+    uint32_t count = free_cluster_count;
+    vfs_unlock();
+    return count;
+}
+
+static void create_default_file(const char *name, char *data) {
+    // the new file is the last one within the root dir
+    if (create_file(root, name, 0) == 0)
+        append_to_file(root, &root->folder.files[root->folder.file_count - 1], data, strlen(data));
+}
+
+static void create_default_files() {
+    // a help buffer used to create default files
+    char buff[256];
+
+    // create a file that contains a brief readme kind of content
+    strcpy(buff, "Welcome to a pseudo-FAT-based file system. This file system supports basic operations like cat, ls, touch, cp, etc. It was created as a part of the semestral project of the KIV/OS module in 2021.\n\r");
+    create_default_file("README.md", buff);
+
+    // create a file that contains ascii characters (not all of them, just the printable ones)
+    memset(buff, 0, 256);
+    char c;
+    for (c = '!'; c <= '~'; c++)
+        append(buff, c);
+    create_default_file("ascii.txt", buff);
+
+    // create a file that contains all prime numbers from 2 to 100
+    memset(buff, 0, 256);
+    strcpy(buff, "2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97");
+    create_default_file("primes.dat", buff);
+}
+
+static void free_all_occupied_clusters(uint32_t start_cluster) {
+    uint32_t curr_cluster = start_cluster;
+    uint32_t prev_cluster;
+
+    // skip the first cluster so each file starts
+    // at the same position once it has been created
+    curr_cluster = get_fat(curr_cluster);
+
+    // iterate through the FAT table and keep setting the clusters as free
+    // until you either reach teh EOF_CLUSTER
+    while (get_fat(curr_cluster) != EOF_CLUSTER && get_fat(curr_cluster) != FREE_CLUSTER) {
+        prev_cluster = curr_cluster;
+        curr_cluster = get_fat(curr_cluster);
+        set_cluster_free(prev_cluster);
+    }
+    // set the EOF cluster as free as well
+    set_cluster_free(curr_cluster);
+}
+
+static int exists_n_free_clusters(uint32_t n) {
+    return free_cluster_count >= n;
+}
+
+static uint32_t get_cluster_count_needed(uint32_t size) {
+    // calculate the number of clusters needed to
+    // store an "object" of a particular size
+    uint32_t clusters_needed = size / fs.cluster_size;
+    if (size % fs.cluster_size != 0)
+        clusters_needed++;
+    return clusters_needed;
+}
+
+static void set_cluster_taken(uint32_t cluster) {
+    free_clusters[cluster / 32] &= ~(1 << (cluster % 32));
+    free_cluster_count--;
+    set_fat(cluster, TAKEN_CLUSTER);
+}
+
+static void set_cluster_free(uint32_t cluster) {
+    // make sure the cluster is not counted twice
+    if (free_clusters[cluster / 32] & (1 << (cluster % 32)))
+        return;
+    free_clusters[cluster / 32] |= 1 << (cluster % 32);
+    free_cluster_count++;
+    set_fat(cluster, FREE_CLUSTER);
+    if (cluster / 32 < free_cluster_hint)
+        free_cluster_hint = cluster / 32;
+}
+
+static uint32_t get_free_cluster() {
+    // find the first free cluster (32 clusters at a time), set it as TAKEN,
+    // so it will not be used again and return its index
+    uint32_t i;
+    for (i = free_cluster_hint; i < fs.bitmap_size; i++)
+        if (free_clusters[i] != 0) {
+            uint32_t cluster = i * 32 + __builtin_ctz(free_clusters[i]);
+            free_cluster_hint = i;
+            set_cluster_taken(cluster);
+            return cluster;
+        }
+    // we're out of free clusters
+    // TODO we should probably not panic the system
+    set_color(FOREGROUND_RED);
+    kprintf("ERR: all clusters are full");
+    _panic();
+    // TODO this should be checked by all functions that call get_free_cluster()
+    return TAKEN_CLUSTER;
+}
+
+static uint32_t get_free_cluster_after(uint32_t cluster) {
+    // take the cluster right behind the given one if it's free,
+    // so the file is made up of as few runs of clusters as possible
+    uint32_t next = cluster + 1;
+    if (next < fs.cluster_count && (free_clusters[next / 32] & (1 << (next % 32)))) {
+        set_cluster_taken(next);
+        return next;
+    }
+    return get_free_cluster();
+}
+
+static uint8_t add_extent_cluster(file_extents_t *extents, uint32_t cluster) {
+    // extend the last run if the cluster follows right after it
+    if (extents->count > 0) {
+        extent_t *last = &extents->extents[extents->count - 1];
+        if (last->start_cluster + last->cluster_count == cluster) {
+            last->cluster_count++;
+            return 0;
+        }
+    }
+    // otherwise, start a new one (the array doubles in size)
+    if (extents->count == extents->capacity) {
+        uint32_t capacity = (extents->capacity == 0) ? FILE_MIN_EXTENTS : 2 * extents->capacity;
+        extent_t *array = (extent_t *)krealloc(extents->extents, capacity * sizeof(extent_t));
+        if (array == NULL)
+            return 1;
+        extents->extents = array;
+        extents->capacity = capacity;
+    }
+    extent_t *extent = &extents->extents[extents->count];
+    extent->offset = 0;
+    if (extents->count > 0)
+        extent->offset = extent[-1].offset + extent[-1].cluster_count * fs.cluster_size;
+    extent->start_cluster = cluster;
+    extent->cluster_count = 1;
+    extents->count++;
+    return 0;
+}
+
+static void free_file_extents(dir_t *dir, file_t *file) {
+    // the chain of the file has changed, so the runs will be built again
+    file_extents_t *extents = &dir->extents[file - dir->folder.files];
+    kfree(extents->extents);
+    extents->extents = NULL;
+    extents->count = 0;
+    extents->capacity = 0;
+}
+
+static file_extents_t *get_file_extents(dir_t *dir, file_t *file) {
+    file_extents_t *extents = &dir->extents[file - dir->folder.files];
+    if (extents->extents != NULL)
+        return extents;
+
+    // follow the chain once (there's always at least one data cluster
+    // followed by the EOF cluster which doesn't hold any data)
+    uint32_t curr_cluster = file->start_cluster_index;
+    while (get_fat(curr_cluster) != EOF_CLUSTER) {
+        if (add_extent_cluster(extents, curr_cluster) != 0) {
+            free_file_extents(dir, file);
+            return NULL;
+        }
+        curr_cluster = get_fat(curr_cluster);
+    }
+    return extents;
+}
+
+static uint32_t get_file_capacity(file_extents_t *extents) {
+    // how many bytes the data clusters of the file can hold
+    extent_t *last = &extents->extents[extents->count - 1];
+    return last->offset + last->cluster_count * fs.cluster_size;
+}
+
+static extent_t *find_extent(file_extents_t *extents, uint32_t offset) {
+    // binary search for the last run which starts at or before the offset
+    uint32_t low = 0;
+    uint32_t high = extents->count - 1;
+    while (low < high) {
+        uint32_t mid = (low + high + 1) / 2;
+        if (extents->extents[mid].offset <= offset)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    return &extents->extents[low];
+}
+
+static uint32_t get_file_cluster(file_extents_t *extents, uint32_t offset) {
+    // the cluster the byte at the given offset is stored in
+    extent_t *extent = find_extent(extents, offset);
+    return extent->start_cluster + (offset - extent->offset) / fs.cluster_size;
+}
+
+static extent_t *find_extent_from(file_extents_t *extents, uint32_t hint, uint32_t offset) {
+    // sequential accesses stay within the same run or move on to the next one,
+    // so the run used last time is checked first before falling back to the search
+    uint32_t i;
+    for (i = hint; i < extents->count && i <= hint + 1; i++) {
+        extent_t *extent = &extents->extents[i];
+        if (extent->offset <= offset && offset < extent->offset + extent->cluster_count * fs.cluster_size)
+            return extent;
+    }
+    return find_extent(extents, offset);
+}
+
+static void copy_file_data(file_extents_t *extents, uint32_t *extent_hint, uint32_t offset, char *buffer, uint32_t len, uint8_t to_file) {
+    // the clusters of a run are next to each other in the memory, so each run
+    // is copied at once (the caller makes sure the data clusters are there)
+    // the hint (if any) holds the index of the run to start looking at and
+    // gets updated to the run the copying ended in
+    extent_t *extent = (extent_hint == NULL) ? find_extent(extents, offset) : find_extent_from(extents, *extent_hint, offset);
+    uint32_t copied = 0;
+    while (copied < len) {
+        uint32_t offset_in_extent = offset + copied - extent->offset;
+        uint32_t bytes = min(len - copied, extent->cluster_count * fs.cluster_size - offset_in_extent);
+        void *data = (void *)(CLUSTER_ADDR(extent->start_cluster) + offset_in_extent);
+        if (to_file == 1) {
+            memcpy(data, &buffer[copied], bytes);
+            mark_fs_dirty((uint32_t)data, bytes);
+        } else {
+            memcpy(&buffer[copied], data, bytes);
+        }
+        copied += bytes;
+        if (copied < len)
+            extent++;
+    }
+    if (extent_hint != NULL)
+        *extent_hint = extent - extents->extents;
+}
+
+static void extend_file(dir_t *dir, file_t *file, file_extents_t *extents, uint32_t clusters) {
+    // the EOF cluster is set free and most likely taken again right away, so the new clusters
+    // follow the last one (the caller makes sure there are enough free clusters)
+    uint32_t prev_cluster = get_file_cluster(extents, get_file_capacity(extents) - 1);
+    uint8_t failed = 0;
+    set_cluster_free(get_fat(prev_cluster));
+
+    uint32_t i;
+    uint32_t curr_cluster;
+    for (i = 0; i < clusters; i++) {
+        curr_cluster = get_free_cluster_after(prev_cluster);
+        set_fat(prev_cluster, curr_cluster);
+        failed |= add_extent_cluster(extents, curr_cluster);
+        prev_cluster = curr_cluster;
+    }
+    // create an EOF cluster and link it up to the rest of the chain
+    curr_cluster = get_free_cluster_after(prev_cluster);
+    set_fat(prev_cluster, curr_cluster);
+    set_fat(curr_cluster, EOF_CLUSTER);
+
+    // we've run out of memory, so the runs will be built again next time
+    if (failed == 1)
+        free_file_extents(dir, file);
+}
+
+static uint8_t is_region_used(uint32_t block) {
+    // the FAT and the clusters which are not free
+    uint32_t addr = FS_START_ADDR + block * BLOCK_SIZE;
+    if (addr < fs.cluster_start_addr)
+        return 1;
+    uint32_t first = (addr - fs.cluster_start_addr) / fs.cluster_size;
+    uint32_t last = min((addr + BLOCK_SIZE - 1 - fs.cluster_start_addr) / fs.cluster_size, fs.cluster_count - 1);
+    for (; first <= last; first++)
+        if (get_fat(first) != FREE_CLUSTER)
+            return 1;
+    return 0;
+}
+
+static int load_fs() {
+    // read the region back from the disk if it has been stored there with the same geometry
+    fs_disk_header_t *header = (fs_disk_header_t *)kmalloc(BLOCK_SIZE);
+    if (header == NULL)
+        return 1;
+    uint8_t valid = bcache_read(FS_DISK_HEADER_BLOCK, header) == 0 && header->magic == FS_DISK_MAGIC &&
+                    header->size == fs.size && header->cluster_size == fs.cluster_size;
+    kfree(header);
+    if (valid == 0)
+        return 1;
+
+    // the FAT comes first, it tells which clusters are worth reading in
+    uint32_t block;
+    for (block = 0; block < fs.size / BLOCK_SIZE; block++)
+        if (is_region_used(block) && bcache_read(FS_DISK_FIRST_BLOCK + block, (void *)(FS_START_ADDR + block * BLOCK_SIZE)) != 0)
+            return 1;
+
+    uint32_t i;
+    for (i = 0; i < fs.cluster_count; i++)
+        if (get_fat(i) == FREE_CLUSTER) {
+            free_clusters[i / 32] |= 1 << (i % 32);
+            free_cluster_count++;
+        }
+
+    file_t entry;
+    memset(&entry, 0, sizeof(file_t));
+    entry.start_cluster_index = ROOT_FIRST_START_CLUSTER;
+    root = load_dir(&entry);
+    if (root == NULL)
+        return 1;
+
+    // the system files are the stdouts of the shells of the previous boot
+    for (i = root->folder.file_count; i-- > 0;)
+        if (root->folder.files[i].system == 1)
+            delete_file(root, &root->folder.files[i]);
+    save_dir(root);
+    return 0;
+}
+
+static void store_fs() {
+    // the old header is wiped out first and the new one goes last,
+    // so a half-written region is never taken for a valid one
+    fs_disk_header_t *header = (fs_disk_header_t *)kcalloc(1, BLOCK_SIZE);
+    if (header == NULL)
+        return;
+    bcache_write(FS_DISK_HEADER_BLOCK, header);
+    bcache_flush(0xFFFFFFFF, 1);
+    sync_blocks(0xFFFFFFFF);
+    bcache_flush(0xFFFFFFFF, 1);
+    if (is_synced() == 0) {
+        kfree(header);
+        return;
+    }
+    header->magic = FS_DISK_MAGIC;
+    header->size = fs.size;
+    header->cluster_size = fs.cluster_size;
+    bcache_write(FS_DISK_HEADER_BLOCK, header);
+    bcache_flush(0xFFFFFFFF, 1);
+    kfree(header);
+}
+
+fs_geometry_t *fat_init() {
+    uint32_t i;
+
+    set_geometry(get_fs_size());
+    free_clusters = (uint32_t *)kcalloc(fs.bitmap_size, sizeof(uint32_t));
+    free_cluster_count = 0;
+    free_cluster_hint = 0;
+
+    // the disk has to hold the header as well as the whole region
+    if (bcache_get_block_count() >= FS_DISK_FIRST_BLOCK + fs.size / BLOCK_SIZE) {
+        dirty_blocks = (uint32_t *)kcalloc(fs.size / BLOCK_SIZE / 32, sizeof(uint32_t));
+        if (dirty_blocks != NULL && load_fs() == 0)
+            return &fs;
+        // start over with an empty region (whatever has been read in is formatted)
+        memset(free_clusters, 0, fs.bitmap_size * sizeof(uint32_t));
+        free_cluster_count = 0;
+    }
+
+    // set all clusters as free
+    for (i = 0; i < fs.cluster_count; i++)
+        set_cluster_free(i);
+
+    // create a root directory that will start at cluster 0
+    // (it takes up cluster 0 followed by its EOF cluster)
+    root = alloc_dir();
+    root->clusters = (uint32_t *)kmalloc(sizeof(uint32_t));
+    root->clusters[0] = ROOT_FIRST_START_CLUSTER;
+    root->cluster_count = 1;
+    set_cluster_taken(ROOT_FIRST_START_CLUSTER);
+    root->eof_cluster = get_free_cluster();
+    set_fat(ROOT_FIRST_START_CLUSTER, root->eof_cluster);
+    set_fat(root->eof_cluster, EOF_CLUSTER);
+
+    // save the root directory at the very beginning of the clusters
+    root->all_dirty = 1;
+    save_dir(root);
+
+    // create some default files as a proof of concept
+    create_default_files();
+    if (dirty_blocks != NULL)
+        store_fs();
+    return &fs;
+}
+
+static void hash_insert(dir_t *dir, uint32_t file_index) {
+    uint32_t bucket = hash_string(dir->folder.files[file_index].name) & (dir->hash_size - 1);
+    dir->hash_next[file_index] = dir->hash[bucket];
+    dir->hash[bucket] = file_index;
+}
+
+static void hash_remove(dir_t *dir, uint32_t file_index) {
+    int32_t *link = &dir->hash[hash_string(dir->folder.files[file_index].name) & (dir->hash_size - 1)];
+    while (*link != (int32_t)file_index)
+        link = &dir->hash_next[*link];
+    *link = dir->hash_next[file_index];
+}
+
+static void grow_hash(dir_t *dir) {
+    // keep the buckets short (two entries on average), so a lookup
+    // takes the same time no matter how many entries the dir holds
+    if (dir->folder.file_count <= 2 * dir->hash_size)
+        return;
+    int32_t *hash = (int32_t *)kmalloc(2 * dir->hash_size * sizeof(int32_t));
+    if (hash == NULL)
+        return;
+    kfree(dir->hash);
+    dir->hash = hash;
+    dir->hash_size *= 2;
+
+    uint32_t i;
+    for (i = 0; i < dir->hash_size; i++)
+        dir->hash[i] = -1;
+    for (i = 0; i < dir->folder.file_count; i++)
+        hash_insert(dir, i);
+}
+
+static file_t *find_entry(dir_t *dir, const char *name) {
+    int32_t i;
+    for (i = dir->hash[hash_string(name) & (dir->hash_size - 1)]; i != -1; i = dir->hash_next[i])
+        if (strcmp(dir->folder.files[i].name, name) == 0)
+            return &dir->folder.files[i];
+    return NULL;
+}
+
+static dir_t *alloc_dir() {
+    dir_t *dir = (dir_t *)kcalloc(1, sizeof(dir_t));
+    if (dir == NULL)
+        return NULL;
+    dir->hash = (int32_t *)kmalloc(FILE_HASH_SIZE * sizeof(int32_t));
+    if (dir->hash == NULL) {
+        kfree(dir);
+        return NULL;
+    }
+    dir->hash_size = FILE_HASH_SIZE;
+    uint32_t i;
+    for (i = 0; i < FILE_HASH_SIZE; i++)
+        dir->hash[i] = -1;
+    return dir;
+}
+
+static void free_dir(dir_t *dir) {
+    // only empty dirs are ever deleted, so there are no runs or subdirs left
+    kfree(dir->folder.files);
+    kfree(dir->hash);
+    kfree(dir->hash_next);
+    kfree(dir->extents);
+    kfree(dir->subdirs);
+    kfree(dir->clusters);
+    kfree(dir);
+}
+
+static int reserve_entries(dir_t *dir, uint32_t count) {
+    // the arrays double in size, so adding an entry copies them only once in a while
+    if (count <= dir->capacity)
+        return 0;
+    uint32_t capacity = (dir->capacity == 0) ? DIR_MIN_CAPACITY : 2 * dir->capacity;
+    while (capacity < count)
+        capacity *= 2;
+
+    // the arrays which have grown already are just bigger than needed if the next one fails
+    file_t *files = (file_t *)krealloc(dir->folder.files, capacity * sizeof(file_t));
+    if (files == NULL)
+        return 1;
+    dir->folder.files = files;
+    int32_t *hash_next = (int32_t *)krealloc(dir->hash_next, capacity * sizeof(int32_t));
+    if (hash_next == NULL)
+        return 1;
+    dir->hash_next = hash_next;
+    file_extents_t *extents = (file_extents_t *)krealloc(dir->extents, capacity * sizeof(file_extents_t));
+    if (extents == NULL)
+        return 1;
+    dir->extents = extents;
+    dir_t **subdirs = (dir_t **)krealloc(dir->subdirs, capacity * sizeof(dir_t *));
+    if (subdirs == NULL)
+        return 1;
+    dir->subdirs = subdirs;
+    dir->capacity = capacity;
+    return 0;
+}
+
+static void shrink_entries(dir_t *dir) {
+    // give the memory back once the dir has shrunk to a quarter of its capacity
+    // (the arrays shrink in place, the freed tail goes back to the heap)
+    if (dir->capacity <= DIR_MIN_CAPACITY || dir->folder.file_count > dir->capacity / 4)
+        return;
+    dir->capacity /= 2;
+    dir->folder.files = (file_t *)krealloc(dir->folder.files, dir->capacity * sizeof(file_t));
+    dir->hash_next = (int32_t *)krealloc(dir->hash_next, dir->capacity * sizeof(int32_t));
+    dir->extents = (file_extents_t *)krealloc(dir->extents, dir->capacity * sizeof(file_extents_t));
+    dir->subdirs = (dir_t **)krealloc(dir->subdirs, dir->capacity * sizeof(dir_t *));
+}
+
+static uint32_t get_dir_cluster_pos(uint32_t file_index) {
+    // position of the cluster (within the chain of the dir) the file is stored in
+    if (file_index < MAX_FILES_IN_FIRST_CLUSTER)
+        return 0;
+    return 1 + (file_index - MAX_FILES_IN_FIRST_CLUSTER) / MAX_FILES_IN_ONE_CLUSTER;
+}
+
+static uint32_t get_dir_cluster_count(uint32_t file_count) {
+    // the number of data clusters needed to store the given number of files
+    if (file_count <= MAX_FILES_IN_FIRST_CLUSTER)
+        return 1;
+    return get_dir_cluster_pos(file_count - 1) + 1;
+}
+
+static void mark_dir_dirty(dir_t *dir, uint32_t cluster_pos) {
+    uint32_t i;
+    for (i = 0; i < dir->dirty_count; i++)
+        if (dir->dirty[i] == cluster_pos)
+            return;
+    // too many changes at a time, just write back the whole dir
+    if (dir->dirty_count == DIR_MAX_DIRTY_CLUSTERS)
+        dir->all_dirty = 1;
+    else
+        dir->dirty[dir->dirty_count++] = cluster_pos;
+}
+
+static void mark_file_dirty(dir_t *dir, file_t *file) {
+    mark_dir_dirty(dir, get_dir_cluster_pos(file - dir->folder.files));
+}
+
+static uint32_t get_first_file(uint32_t cluster_pos) {
+    // index of the first file stored in the given cluster of a dir
+    if (cluster_pos == 0)
+        return 0;
+    return MAX_FILES_IN_FIRST_CLUSTER + (cluster_pos - 1) * MAX_FILES_IN_ONE_CLUSTER;
+}
+
+static void save_dir_cluster(dir_t *dir, uint32_t cluster_pos) {
+    uint32_t addr = CLUSTER_ADDR(dir->clusters[cluster_pos]);
+    uint32_t first_file = get_first_file(cluster_pos);
+    uint32_t files_in_cluster = MAX_FILES_IN_ONE_CLUSTER;
+
+    // the first cluster starts with the number of files
+    if (cluster_pos == 0) {
+        memcpy((void *)addr, &dir->folder.file_count, sizeof(uint32_t));
+        addr += sizeof(uint32_t);
+        files_in_cluster = MAX_FILES_IN_FIRST_CLUSTER;
+    }
+    if (first_file < dir->folder.file_count)
+        memcpy((void *)addr, &dir->folder.files[first_file], min(files_in_cluster, dir->folder.file_count - first_file) * sizeof(file_t));
+    mark_fs_dirty(CLUSTER_ADDR(dir->clusters[cluster_pos]), fs.cluster_size);
+}
+
+static void save_dir(dir_t *dir) {
+    // write back only the clusters which have changed since the last time
+    uint32_t i;
+    if (dir->all_dirty == 1) {
+        for (i = 0; i < dir->cluster_count; i++)
+            save_dir_cluster(dir, i);
+    } else {
+        for (i = 0; i < dir->dirty_count; i++)
+            if (dir->dirty[i] < dir->cluster_count)
+                save_dir_cluster(dir, dir->dirty[i]);
+    }
+    dir->dirty_count = 0;
+    dir->all_dirty = 0;
+}
+
+static void add_dir_cluster(dir_t *dir) {
+    // the EOF cluster of the dir becomes
+    // a data cluster and a new EOF cluster is attached
+    uint32_t eof_cluster = get_free_cluster();
+    set_fat(dir->eof_cluster, eof_cluster);
+    set_fat(eof_cluster, EOF_CLUSTER);
+    dir->clusters[dir->cluster_count++] = dir->eof_cluster;
+    dir->eof_cluster = eof_cluster;
+}
+
+static void remove_dir_cluster(dir_t *dir) {
+    // the last data cluster of the dir becomes its EOF cluster
+    set_cluster_free(dir->eof_cluster);
+    dir->eof_cluster = dir->clusters[--dir->cluster_count];
+    set_fat(dir->eof_cluster, EOF_CLUSTER);
+}
+
+static dir_t *load_dir(file_t *entry) {
+    dir_t *dir = alloc_dir();
+    if (dir == NULL)
+        return NULL;
+
+    // collect the data clusters of the dir (the chain ends with the EOF cluster)
+    uint32_t cluster;
+    for (cluster = entry->start_cluster_index; get_fat(cluster) != EOF_CLUSTER; cluster = get_fat(cluster)) {
+        uint32_t *clusters = (uint32_t *)krealloc(dir->clusters, (dir->cluster_count + 1) * sizeof(uint32_t));
+        if (clusters == NULL) {
+            free_dir(dir);
+            return NULL;
+        }
+        dir->clusters = clusters;
+        dir->clusters[dir->cluster_count++] = cluster;
+    }
+    dir->eof_cluster = cluster;
+
+    // the first cluster starts with the number of files followed by the files themselves
+    uint32_t file_count;
+    memcpy(&file_count, (void *)CLUSTER_ADDR(dir->clusters[0]), sizeof(uint32_t));
+    if (reserve_entries(dir, file_count) != 0) {
+        free_dir(dir);
+        return NULL;
+    }
+    uint32_t i;
+    for (i = 0; i < dir->cluster_count; i++) {
+        uint32_t addr = CLUSTER_ADDR(dir->clusters[i]) + ((i == 0) ? sizeof(uint32_t) : 0);
+        uint32_t first_file = get_first_file(i);
+        if (first_file < file_count)
+            memcpy(&dir->folder.files[first_file], (void *)addr, min((i == 0) ? MAX_FILES_IN_FIRST_CLUSTER : MAX_FILES_IN_ONE_CLUSTER, file_count - first_file) * sizeof(file_t));
+    }
+    memset(dir->extents, 0, file_count * sizeof(file_extents_t));
+    memset(dir->subdirs, 0, file_count * sizeof(dir_t *));
+    for (i = 0; i < file_count; i++) {
+        // nothing within the dir can be open yet (the flags may come from the disk)
+        dir->folder.files[i].open = 0;
+        dir->folder.file_count = i + 1;
+        hash_insert(dir, i);
+        grow_hash(dir);
+    }
+    return dir;
+}
+
+static dir_t *get_subdir(dir_t *dir, file_t *file) {
+    // the subdir is read in the first time it's looked up and stays in memory from then on
+    uint32_t file_index = file - dir->folder.files;
+    if (file->directory == 0)
+        return NULL;
+    if (dir->subdirs[file_index] == NULL)
+        dir->subdirs[file_index] = load_dir(file);
+    return dir->subdirs[file_index];
+}
+
+static dir_t *get_parent_dir(const char *path, const char **name) {
+    // walk down the dirs along the (normalized) path, the last name
+    // within it is returned as what is to be looked up in the dir
+    dir_t *dir = root;
+    char entry_name[FILE_NAME_LEN];
+    while (*path == PATH_SEPARATOR)
+        path++;
+    while (1) {
+        uint32_t len = 0;
+        while (path[len] != '\0' && path[len] != PATH_SEPARATOR)
+            len++;
+        if (path[len] == '\0')
+            break;
+
+        // all names but the last one have to be directories
+        memcpy(entry_name, path, len);
+        entry_name[len] = '\0';
+        file_t *file = find_entry(dir, entry_name);
+        if (file == NULL || (dir = get_subdir(dir, file)) == NULL)
+            return NULL;
+        path += len + 1;
+    }
+    *name = path;
+    return (*path == '\0') ? NULL : dir;
+}
+
+static int create_file(dir_t *dir, const char *filename, uint8_t directory) {
+    // make sure there are at least 2 free clusters (the start one of the file
+    // + its EOF cluster) and one more if the directory has to grow
+    uint32_t file_index = dir->folder.file_count;
+    uint8_t dir_grows = get_dir_cluster_count(file_index + 1) > dir->cluster_count;
+    if (exists_n_free_clusters(2 + dir_grows) == 0) {
+        kprintf("there is not enough space to create a file");
+        return 1;
+    }
+
+    // make room for one more file (the arrays double in size once they're full)
+    if (reserve_entries(dir, file_index + 1) != 0) {
+        kprintf("there is not enough memory to create a file");
+        return 1;
+    }
+    if (dir_grows) {
+        uint32_t *clusters = (uint32_t *)krealloc(dir->clusters, (dir->cluster_count + 1) * sizeof(uint32_t));
+        if (clusters == NULL) {
+            kprintf("there is not enough memory to create a file");
+            return 1;
+        }
+        dir->clusters = clusters;
+        add_dir_cluster(dir);
+    }
+
+    // create the new file and store it at the last position within the array
+    file_t *file = &dir->folder.files[file_index];
+    strcpy(file->name, filename);
+    file->size = 0;
+    file->open = 0;
+    file->system = 0;
+    file->directory = directory;
+    file->start_cluster_index = get_free_cluster();
+    memset(&dir->extents[file_index], 0, sizeof(file_extents_t));
+    dir->subdirs[file_index] = NULL;
+
+    // create an EOF cluster and link it up to the new file's start cluster
+    uint32_t eof_cluster = get_free_cluster();
+    set_fat(file->start_cluster_index, eof_cluster);
+    set_fat(eof_cluster, EOF_CLUSTER);
+
+    // a new directory holds no files (the number of them is at the start of its first cluster)
+    if (directory == 1) {
+        memset((void *)CLUSTER_ADDR(file->start_cluster_index), 0, sizeof(uint32_t));
+        mark_fs_dirty(CLUSTER_ADDR(file->start_cluster_index), sizeof(uint32_t));
+    }
+
+    // update the current directory (the number of files is stored in the first cluster)
+    mark_file_dirty(dir, file);
+    mark_dir_dirty(dir, 0);
+    dir->folder.file_count++;
+    hash_insert(dir, file_index);
+    grow_hash(dir);
+    return 0;
+}
+
+static void delete_file(dir_t *dir, file_t *file) {
+    uint32_t file_pos = file - dir->folder.files;
+    uint32_t last_pos = dir->folder.file_count - 1;
+
+    // free all clusters held by the files
+    // also we must explicitly free the start cluster of the file
+    free_all_occupied_clusters(file->start_cluster_index);
+    set_cluster_free(file->start_cluster_index);
+    free_file_extents(dir, file);
+    if (dir->subdirs[file_pos] != NULL)
+        free_dir(dir->subdirs[file_pos]);
+
+    // move the last file into the gap, so only two clusters of the dir change
+    hash_remove(dir, file_pos);
+    if (file_pos != last_pos) {
+        hash_remove(dir, last_pos);
+        dir->folder.files[file_pos] = dir->folder.files[last_pos];
+        dir->extents[file_pos] = dir->extents[last_pos];
+        dir->subdirs[file_pos] = dir->subdirs[last_pos];
+        hash_insert(dir, file_pos);
+        mark_file_dirty(dir, file);
+    }
+    dir->folder.file_count--;
+    mark_dir_dirty(dir, get_dir_cluster_pos(last_pos));
+    mark_dir_dirty(dir, 0);
+    if (get_dir_cluster_count(dir->folder.file_count) < dir->cluster_count)
+        remove_dir_cluster(dir);
+    shrink_entries(dir);
+}
+
+static int append_to_file(dir_t *dir, file_t *file, char *buffer, uint32_t bytes) {
+    file_extents_t *extents = get_file_extents(dir, file);
+    if (extents == NULL) {
+        kprintf("not enough memory to append to the file\n\r");
+        return 1;
+    }
+
+    // the data clusters of the file may still have some room left
+    // (the last one is not full or the file is empty), if that's not enough
+    // attach as many clusters as needed to the end of the file
+    uint32_t capacity = get_file_capacity(extents);
+    if (file->size + bytes > capacity) {
+        uint32_t clusters_needed = get_cluster_count_needed(file->size + bytes - capacity);
+        if (exists_n_free_clusters(clusters_needed) == 0) {
+            kprintf("no enough space to store the rest of the file\n\r");
+            return 1;
+        }
+        extend_file(dir, file, extents, clusters_needed);
+        if ((extents = get_file_extents(dir, file)) == NULL) {
+            kprintf("not enough memory to append to the file\n\r");
+            return 1;
+        }
+    }
+
+    // copy the data right behind the end of the file
+    copy_file_data(extents, NULL, file->size, buffer, bytes, 1);
+    file->size += bytes;
+
+    // re-store the directory
+    // so the file has its updated size
+    mark_file_dirty(dir, file);
+    save_dir(dir);
+    return 0;
+}
+
+void print_FAT(uint32_t n) {
+    uint32_t i;
+    uint32_t to = min(n, fs.cluster_count);
+    vfs_lock();
+    for (i = 0; i < to; i++) {
+        switch (get_fat(i)) {
+            case EOF_CLUSTER:
+                set_color(FOREGROUND_YELLOW);
+                kprintf("E ");
+                reset_color();
+                break;
+            case FREE_CLUSTER:
+                set_color(FOREGROUND_GREEN);
+                kprintf("F ");
+                reset_color();
+                break;
+            case TAKEN_CLUSTER:
+                set_color(FOREGROUND_BLUE);
+                kprintf("T ");
+                reset_color();
+                break;
+            default:
+                kprintf("%d ", get_fat(i));
+                break;
+        }
+    }
+    kprintf("\n\r");
+    vfs_unlock();
+}
+
+static int write_to_file(dir_t *dir, file_t *file, uint32_t *extent_hint, char *buffer, uint32_t offset, uint32_t len) {
+    // make sure the offset falls into the files boundaries
+    if (offset > file->size) {
+        kprintf("the offset is greater than the size of the file itself\n\r");
+        return 1;
+    }
+    // make sure we have enough clusters available for the part past the end of the file
+    if (offset + len > file->size && exists_n_free_clusters(get_cluster_count_needed(offset + len - file->size)) == 0) {
+        kprintf("not enough space to extend the file\n\r");
+        return 1;
+    }
+    file_extents_t *extents = get_file_extents(dir, file);
+    if (extents == NULL) {
+        kprintf("not enough memory to write into the file\n\r");
+        return 1;
+    }
+
+    // the data overwrite the clusters of the file in place (the chain as well
+    // as the dir stay the same) and whatever is left is attached to the end
+    uint32_t bytes_in_file = min(len, file->size - offset);
+    copy_file_data(extents, extent_hint, offset, buffer, bytes_in_file, 1);
+    if (bytes_in_file < len)
+        return append_to_file(dir, file, &buffer[bytes_in_file], len - bytes_in_file);
+    return 0;
+}
+
+uint32_t get_cluster_size() {
+    return fs.cluster_size;
+}
+
+uint32_t get_fat_entry_bits() {
+    return 8 * fs.fat_entry_size;
+}
+
+uint32_t get_memory_available() {
+    return get_free_cluster_count() * fs.cluster_size;
+}
+static file_t *get_inode_file(inode_t *inode) {
+    // NULL for the root dir
+    if (inode->index == ROOT_INDEX)
+        return NULL;
+    dir_t *dir = (dir_t *)inode->node;
+    return &dir->folder.files[inode->index];
+}
+
+static int fat_lookup(void *, const char *name, inode_t *inode) {
+    while (*name == PATH_SEPARATOR)
+        name++;
+    if (*name == '\0') {
+        inode->node = root;
+        inode->index = ROOT_INDEX;
+        return 0;
+    }
+    const char *entry_name;
+    dir_t *dir = get_parent_dir(name, &entry_name);
+    file_t *file = (dir == NULL) ? NULL : find_entry(dir, entry_name);
+    if (file == NULL)
+        return 1;
+    inode->node = dir;
+    inode->index = file - dir->folder.files;
+    return 0;
+}
+
+static int fat_create(void *, const char *name, uint8_t directory) {
+    // make sure the dir exists and the name isn't already taken
+    // (only the changed clusters of the dir are written back)
+    const char *entry_name;
+    dir_t *dir = get_parent_dir(name, &entry_name);
+    if (dir == NULL || find_entry(dir, entry_name) != NULL)
+        return 1;
+    int status = create_file(dir, entry_name, directory);
+    save_dir(dir);
+    return status;
+}
+
+static int fat_remove(void *, inode_t *inode) {
+    // the root dir stays and so do the dirs which are not empty
+    file_t *file = get_inode_file(inode);
+    if (file == NULL)
+        return 1;
+    dir_t *dir = (dir_t *)inode->node;
+    if (file->directory == 1) {
+        dir_t *subdir = get_subdir(dir, file);
+        if (subdir == NULL || subdir->folder.file_count != 0)
+            return 1;
+    }
+    delete_file(dir, file);
+    save_dir(dir);
+    return 0;
+}
+
+static void fill_attr(file_t *file, vfs_attr_t *attr) {
+    // the start cluster identifies the file within the FAT
+    attr->ino = file->start_cluster_index;
+    attr->size = file->size;
+    attr->open = file->open;
+    attr->system = file->system;
+    attr->directory = file->directory;
+}
+
+static void fat_getattr(void *, inode_t *inode, vfs_attr_t *attr) {
+    file_t *file = get_inode_file(inode);
+    if (file != NULL) {
+        fill_attr(file, attr);
+        return;
+    }
+    memset(attr, 0, sizeof(vfs_attr_t));
+    attr->ino = ROOT_FIRST_START_CLUSTER;
+    attr->directory = 1;
+}
+
+static int fat_setattr(void *, inode_t *inode, const vfs_attr_t *attr) {
+    // only the flags change (the size is given by the data written into the file)
+    file_t *file = get_inode_file(inode);
+    if (file == NULL)
+        return 1;
+    dir_t *dir = (dir_t *)inode->node;
+    file->open = attr->open;
+    file->system = attr->system;
+    mark_file_dirty(dir, file);
+    save_dir(dir);
+    return 0;
+}
+
+static int fat_readdir(void *, inode_t *inode, uint32_t *cursor, dirent_t *dirent) {
+    // the cursor is the position of the next entry within the dir
+    file_t *file = get_inode_file(inode);
+    dir_t *dir = (file == NULL) ? root : get_subdir((dir_t *)inode->node, file);
+    if (dir == NULL || *cursor >= dir->folder.file_count)
+        return 1;
+    file = &dir->folder.files[(*cursor)++];
+    strcpy(dirent->name, file->name);
+    fill_attr(file, &dirent->attr);
+    return 0;
+}
+
+static uint32_t fat_read(void *, inode_t *inode, uint32_t *hint, char *buffer, uint32_t offset, uint32_t len) {
+    // the hint holds the run of clusters to start looking at
+    file_t *file = get_inode_file(inode);
+    file_extents_t *extents = (file == NULL || file->directory == 1) ? NULL : get_file_extents((dir_t *)inode->node, file);
+    if (extents == NULL)
+        return (uint32_t)-1;
+    len = (offset >= file->size) ? 0 : min(len, file->size - offset);
+    copy_file_data(extents, hint, offset, buffer, len, 0);
+    return len;
+}
+
+static int fat_write(void *, inode_t *inode, uint32_t *hint, char *buffer, uint32_t offset, uint32_t len) {
+    file_t *file = get_inode_file(inode);
+    if (file == NULL || file->directory == 1)
+        return 1;
+    return write_to_file((dir_t *)inode->node, file, hint, buffer, offset, len);
+}
+
+static int fat_sync(void *, uint32_t max_blocks) {
+    // the blocks are handed over to the block cache, which writes them to the disk
+    if (dirty_blocks == NULL)
+        return 1;
+    sync_blocks(max_blocks);
+    return is_handed_over() == 0;
+}
+
+const fs_ops_t fat_ops = {
+    "fat",
+    fat_lookup,
+    fat_create,
+    fat_remove,
+    fat_getattr,
+    fat_setattr,
+    fat_readdir,
+    fat_read,
+    fat_write,
+    fat_sync
+};
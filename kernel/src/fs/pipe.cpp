@@ -0,0 +1,135 @@
+#include <fs/pipe.h>
+#include <mem/heap.h>
+#include <processes/scheduler.h>
+
+pipe_t *pipe_create() {
+    pipe_t *pipe = (pipe_t *)kmalloc(sizeof(pipe_t));
+    if (pipe == NULL)
+        return NULL;
+    pipe->head = 0;
+    pipe->count = 0;
+    pipe->readers = 0;
+    pipe->writers = 0;
+    wait_queue_init(&pipe->read_waiters);
+    wait_queue_init(&pipe->write_waiters);
+    spinlock_init(&pipe->lock);
+    return pipe;
+}
+
+void pipe_open_end(pipe_t *pipe, uint8_t write_end) {
+    spinlock_acquire(&pipe->lock);
+    if (write_end)
+        pipe->writers++;
+    else
+        pipe->readers++;
+    spinlock_release(&pipe->lock);
+}
+
+void pipe_close_end(pipe_t *pipe, uint8_t write_end) {
+    spinlock_acquire(&pipe->lock);
+    if (write_end) {
+        // the readers get EOF once there's nothing else to be read
+        if (--pipe->writers == 0)
+            wake_all(&pipe->read_waiters, 0);
+    } else {
+        // the writers would wait for free space forever
+        if (--pipe->readers == 0)
+            wake_all(&pipe->write_waiters, 0);
+    }
+    uint8_t unused = pipe->readers == 0 && pipe->writers == 0;
+    spinlock_release(&pipe->lock);
+
+    if (unused)
+        kfree(pipe);
+}
+
+static char pop_byte(pipe_t *pipe) {
+    char c = pipe->buffer[pipe->head];
+    pipe->head = (pipe->head + 1) % PIPE_BUFFER_SIZE;
+    pipe->count--;
+    return c;
+}
+
+uint32_t pipe_read(pipe_t *pipe, char *buffer, uint32_t len) {
+    uint32_t i;
+    spinlock_acquire(&pipe->lock);
+
+    // wait until there's at least something to be read (or we've been killed)
+    while (pipe->count == 0 && pipe->writers != 0) {
+        if (sleep_until_woken(&pipe->read_waiters, &pipe->lock) != 0)
+            break;
+    }
+
+    for (i = 0; i < len && pipe->count != 0; i++)
+        buffer[i] = pop_byte(pipe);
+    if (i != 0)
+        wake_all(&pipe->write_waiters, 0);
+
+    spinlock_release(&pipe->lock);
+    return i;
+}
+
+uint32_t pipe_read_line(pipe_t *pipe, char *line, uint32_t max_len) {
+    uint32_t len = 0;
+    char c = 0;
+    spinlock_acquire(&pipe->lock);
+
+    // carriage returns are dropped, so lines written by printf() read the same as the keyboard input
+    while (c != '\n' && len + 1 < max_len) {
+        while (pipe->count == 0 && pipe->writers != 0) {
+            wake_all(&pipe->write_waiters, 0);
+            if (sleep_until_woken(&pipe->read_waiters, &pipe->lock) != 0)
+                break;
+        }
+        if (pipe->count == 0)
+            break;
+        c = pop_byte(pipe);
+        if (c != '\n' && c != '\r')
+            line[len++] = c;
+    }
+    line[len] = '\0';
+    wake_all(&pipe->write_waiters, 0);
+
+    // there has been nothing but EOF
+    uint32_t result = (len == 0 && c != '\n') ? PIPE_EOF : len;
+    spinlock_release(&pipe->lock);
+    return result;
+}
+
+uint32_t pipe_write(pipe_t *pipe, const char *buffer, uint32_t len) {
+    uint32_t written = 0;
+    spinlock_acquire(&pipe->lock);
+
+    while (written < len && pipe->readers != 0) {
+        if (pipe->count == PIPE_BUFFER_SIZE) {
+            // let the readers make some room first
+            wake_all(&pipe->read_waiters, 0);
+            if (sleep_until_woken(&pipe->write_waiters, &pipe->lock) != 0)
+                break;
+            continue;
+        }
+        pipe->buffer[(pipe->head + pipe->count) % PIPE_BUFFER_SIZE] = buffer[written++];
+        pipe->count++;
+    }
+    if (written != 0)
+        wake_all(&pipe->read_waiters, 0);
+
+    spinlock_release(&pipe->lock);
+    return written;
+}
+
+uint8_t pipe_is_ready(pipe_t *pipe, uint8_t write_end) {
+    // i.e. reading from/writing into the pipe would not block
+    spinlock_acquire(&pipe->lock);
+    uint8_t ready;
+    if (write_end)
+        ready = pipe->count < PIPE_BUFFER_SIZE || pipe->readers == 0;
+    else
+        ready = pipe->count != 0 || pipe->writers == 0;
+    spinlock_release(&pipe->lock);
+    return ready;
+}
+
+wait_queue_t *pipe_get_wait_queue(pipe_t *pipe, uint8_t write_end) {
+    return write_end ? &pipe->write_waiters : &pipe->read_waiters;
+}
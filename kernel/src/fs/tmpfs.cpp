@@ -0,0 +1,195 @@
+#include <fs/tmpfs.h>
+#include <mem/heap.h>
+#include <memory.h>
+#include <string.h>
+#include <math.h>
+
+// The tmpfs keeps its files in memory only, they're gone once the system is restarted.
+// The data of a file are stored in pages taken from the kernel heap, so a file grows
+// one page at a time and an offset maps to its page directly (no chain to follow).
+// An inode is the node of the file itself (NULL for the root dir, the only dir there is).
+
+static uint8_t is_valid_name(const char *name) {
+    // there are no subdirectories in the tmpfs
+    uint32_t i;
+    for (i = 0; name[i] != '\0'; i++)
+        if (name[i] == PATH_SEPARATOR)
+            return 0;
+    return i > 0 && i < FILE_NAME_LEN;
+}
+
+static tmpfs_node_t *get_node(tmpfs_t *tmpfs, const char *name) {
+    tmpfs_node_t *node;
+    for (node = tmpfs->buckets[hash_string(name) % TMPFS_HASH_SIZE]; node != NULL; node = node->next)
+        if (strcmp(node->name, name) == 0)
+            return node;
+    return NULL;
+}
+
+static int grow_node(tmpfs_t *tmpfs, tmpfs_node_t *node, uint32_t size) {
+    // attach as many pages as needed to hold the given number of bytes
+    uint32_t page_count = (size + TMPFS_PAGE_SIZE - 1) / TMPFS_PAGE_SIZE;
+    if (page_count <= node->page_count)
+        return 0;
+    char **pages = (char **)krealloc(node->pages, page_count * sizeof(char *));
+    if (pages == NULL)
+        return 1;
+    node->pages = pages;
+    while (node->page_count < page_count) {
+        if ((pages[node->page_count] = (char *)kmalloc(TMPFS_PAGE_SIZE)) == NULL)
+            return 1;
+        node->page_count++;
+        tmpfs->page_count++;
+    }
+    return 0;
+}
+
+static void copy_node_data(tmpfs_node_t *node, uint32_t offset, char *buffer, uint32_t len, uint8_t to_file) {
+    // one page at a time (the caller makes sure the pages are there)
+    uint32_t copied = 0;
+    while (copied < len) {
+        uint32_t offset_in_page = (offset + copied) % TMPFS_PAGE_SIZE;
+        uint32_t bytes = min(len - copied, TMPFS_PAGE_SIZE - offset_in_page);
+        char *data = &node->pages[(offset + copied) / TMPFS_PAGE_SIZE][offset_in_page];
+        if (to_file == 1)
+            memcpy(data, &buffer[copied], bytes);
+        else
+            memcpy(&buffer[copied], data, bytes);
+        copied += bytes;
+    }
+}
+
+tmpfs_t *tmpfs_create() {
+    return (tmpfs_t *)kcalloc(1, sizeof(tmpfs_t));
+}
+
+static int tmpfs_lookup(void *fs, const char *name, inode_t *inode) {
+    inode->index = 0;
+    if (*name == '\0') {
+        inode->node = NULL;
+        return 0;
+    }
+    inode->node = get_node((tmpfs_t *)fs, name);
+    return inode->node == NULL;
+}
+
+static int tmpfs_create_file(void *fs, const char *name, uint8_t directory) {
+    // there are no subdirectories
+    tmpfs_t *tmpfs = (tmpfs_t *)fs;
+    if (directory == 1 || is_valid_name(name) == 0 || get_node(tmpfs, name) != NULL)
+        return 1;
+    tmpfs_node_t *node = (tmpfs_node_t *)kcalloc(1, sizeof(tmpfs_node_t));
+    if (node == NULL)
+        return 1;
+    strcpy(node->name, name);
+    node->ino = ++tmpfs->last_ino;
+
+    uint32_t bucket = hash_string(name) % TMPFS_HASH_SIZE;
+    node->next = tmpfs->buckets[bucket];
+    tmpfs->buckets[bucket] = node;
+    tmpfs->file_count++;
+    return 0;
+}
+
+static int tmpfs_remove(void *fs, inode_t *inode) {
+    tmpfs_t *tmpfs = (tmpfs_t *)fs;
+    tmpfs_node_t *node = (tmpfs_node_t *)inode->node;
+    if (node == NULL)
+        return 1;
+    tmpfs_node_t **link = &tmpfs->buckets[hash_string(node->name) % TMPFS_HASH_SIZE];
+    while (*link != node)
+        link = &(*link)->next;
+    *link = node->next;
+
+    // give the pages back to the heap
+    uint32_t i;
+    for (i = 0; i < node->page_count; i++)
+        kfree(node->pages[i]);
+    tmpfs->page_count -= node->page_count;
+    tmpfs->file_count--;
+    kfree(node->pages);
+    kfree(node);
+    return 0;
+}
+
+static void fill_attr(tmpfs_node_t *node, vfs_attr_t *attr) {
+    attr->ino = node->ino;
+    attr->size = node->size;
+    attr->open = node->open;
+    attr->system = 0;
+    attr->directory = 0;
+}
+
+static void tmpfs_getattr(void *, inode_t *inode, vfs_attr_t *attr) {
+    tmpfs_node_t *node = (tmpfs_node_t *)inode->node;
+    if (node != NULL) {
+        fill_attr(node, attr);
+        return;
+    }
+    memset(attr, 0, sizeof(vfs_attr_t));
+    attr->directory = 1;
+}
+
+static int tmpfs_setattr(void *, inode_t *inode, const vfs_attr_t *attr) {
+    // there are no system files (they're stored in the FAT)
+    tmpfs_node_t *node = (tmpfs_node_t *)inode->node;
+    if (node == NULL || attr->system == 1)
+        return 1;
+    node->open = attr->open;
+    return 0;
+}
+
+static int tmpfs_readdir(void *fs, inode_t *inode, uint32_t *cursor, dirent_t *dirent) {
+    // the cursor holds the bucket in its upper half and the position within the bucket in the lower one
+    tmpfs_t *tmpfs = (tmpfs_t *)fs;
+    if (inode->node != NULL)
+        return 1;
+    uint32_t bucket = *cursor >> 16;
+    uint32_t pos = *cursor & 0xFFFF;
+    for (; bucket < TMPFS_HASH_SIZE; bucket++, pos = 0) {
+        tmpfs_node_t *node = tmpfs->buckets[bucket];
+        uint32_t i;
+        for (i = 0; node != NULL && i < pos; i++)
+            node = node->next;
+        if (node != NULL) {
+            strcpy(dirent->name, node->name);
+            fill_attr(node, &dirent->attr);
+            *cursor = (bucket << 16) | (pos + 1);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t tmpfs_read(void *, inode_t *inode, uint32_t *, char *buffer, uint32_t offset, uint32_t len) {
+    // an offset maps to its page directly, so there's no use for the hint
+    tmpfs_node_t *node = (tmpfs_node_t *)inode->node;
+    if (node == NULL)
+        return (uint32_t)-1;
+    len = (offset >= node->size) ? 0 : min(len, node->size - offset);
+    copy_node_data(node, offset, buffer, len, 0);
+    return len;
+}
+
+static int tmpfs_write(void *fs, inode_t *inode, uint32_t *, char *buffer, uint32_t offset, uint32_t len) {
+    // the data overwrite the file and whatever is past the end of it makes the file grow
+    tmpfs_node_t *node = (tmpfs_node_t *)inode->node;
+    if (node == NULL || offset > node->size || grow_node((tmpfs_t *)fs, node, offset + len) != 0)
+        return 1;
+    copy_node_data(node, offset, buffer, len, 1);
+    node->size = max(node->size, offset + len);
+    return 0;
+}
+
+const fs_ops_t tmpfs_ops = {
+    "tmpfs",
+    tmpfs_lookup,
+    tmpfs_create_file,
+    tmpfs_remove,
+    tmpfs_getattr,
+    tmpfs_setattr,
+    tmpfs_readdir,
+    tmpfs_read,
+    tmpfs_write,
+    NULL
+};
@@ -1,661 +1,403 @@
 #include <fs/vfs.h>
+#include <fs/fat.h>
+#include <fs/tmpfs.h>
+#include <fs/bcache.h>
 #include <mem/heap.h>
 #include <common.h>
 #include <memory.h>
 #include <string.h>
 #include <drivers/screen/screen.h>
+#include <smp/smp.h>
+#include <spinlock.h>
+#include <processes/scheduler.h>
+#include <drivers/pit/pit.h>
+
+// The VFS resolves a path to the file system it leads into and passes the rest of it
+// to the operations of that file system. The FAT is mounted as the root, the other
+// file systems are mounted under a name within its root dir. A file is identified by
+// an inode given by its file system, the inodes of the paths which have been resolved
+// recently are kept in a cache, so the file systems are not asked for them again.
 
-static volatile fat12_t *fat = reinterpret_cast<fat12_t *>(FS_START_ADDR);
-static folder_t *root = NULL;
 static char file_buffer[SCREEN_BUFFER_SIZE];
 
-static void save_root_folder();
-static uint32_t get_cluster_count_needed(uint32_t size);
-static int exists_n_free_clusters(uint32_t n);
-static uint32_t get_free_cluster();
-static void free_all_occupied_clusters(uint32_t start_cluster);
-static void load_root_folder();
-static void normalize_filename(char *filename);
-static int exists_file(const char *filename);
-static void free_root_dir();
-static void create_file(const char *filename);
-static void delete_file(const char *filename);
-static file_t *get_file(char *filename);
-static void create_default_files();
-static void append_data(char *filename, char *buffer, uint32_t bytes);
-
-uint32_t get_free_cluster_count() {
-    uint32_t free_cluster = 0;
-    uint32_t i;
-    for (i = 0; i < CLUSTER_COUNT; i++)
-        free_cluster += (fat[i].value == FREE_CLUSTER);
-    return free_cluster;
-}
-
-static void create_default_files() {
-    // a help buffer used to create default files
-    char buff[256];
-
-    // create a file that contains a brief readme kind of content
-    strcpy(buff, "Welcome to a pseudo-FAT12-based file system. This file system supports basic operations like cat, ls, touch, cp, etc. It was created as a part of the semestral project of the KIV/OS module in 2021.\n\r");
-    touch("README.md");
-    append_data("README.md", buff, strlen(buff));
-
-    // create a file that contains ascii characters (not all of them, just the printable ones)
-    memset(buff, 0, 256);
-    char c;
-    for (c = '!'; c <= '~'; c++)
-        append(buff, c);
-    touch("ascii.txt");
-    append_data("ascii.txt", buff, strlen(buff));
-
-    // create a file that contains all prime numbers from 2 to 100
-    memset(buff, 0, 256);
-    strcpy(buff, "2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97");
-    touch("primes.dat");
-    append_data("primes.dat", buff, strlen(buff));
-}
-
-static void free_root_dir() {
-    // make sure the root dir has not
-    // been already deallocated
-    if (root == NULL)
-        return;
+// mounts[0] is the root, the longest mount point which matches the path wins
+static mount_t mounts[MAX_MOUNTS];
+static uint32_t mount_count;
 
-    // if the number of files is > 0
-    // deallocate the files first
-    if (root->files != NULL) {
-        kfree(root->files);
-        root->files = NULL;
-    }
-    // deallocate the root dir itself
-    // and set the pointer to NULL
-    kfree(root);
-    root = NULL;
-}
-
-static int exists_file(const char *filename) {
-    // go through the files of the root dir
-    // and keep comparing their names with
-    // the filename given as a parameter
-    uint32_t i;
-    for (i = 0; i < root->file_count; i++)
-        if (strcmp(root->files[i].name, filename) == 0)
-            return 1;
-    return 0;
-}
+// bumped every time a file is removed, a file system may free its inode
+// or move other inodes around (e.g. the last entry of a FAT dir takes its place),
+// so the cached inodes as well as the ones of the open files are no longer valid
+static uint32_t vfs_generation;
 
-static void normalize_filename(char *filename) {
-    // if the length of the file name
-    // exceeds FILE_NAME_LEN cut off the tail of it
-    uint32_t len = strlen(filename);
-    if (len >= FILE_NAME_LEN)
-        filename[FILE_NAME_LEN - 1] = '\0';
-}
+// paths which have been resolved recently (the slot is given by the hash of the path),
+// so a file deep down the tree is found without walking the dirs along its path
+static dentry_t dcache[DCACHE_SIZE];
 
-static void free_all_occupied_clusters(uint32_t start_cluster) {
-    uint32_t curr_cluster = start_cluster;
-    uint32_t prev_cluster;
+static uint32_t last_flush;
 
-    // skip the first cluster so each file starts
-    // at the same position once it has been created
-    curr_cluster = fat[curr_cluster].value;
+// the lock is re-entrant on the same CPU as the public functions call
+// one another (e.g. cp() calls rm() and touch()) and print_to_stream()
+// holds it across several calls, so the stdout file stays consistent
+static spinlock_t vfs_spinlock;
+static volatile int32_t vfs_lock_owner = -1;
+static uint32_t vfs_lock_depth;
 
-    // iterate through the FAT table and keep setting the clusters as free
-    // until you either reach teh EOF_CLUSTER
-    while (fat[curr_cluster].value != EOF_CLUSTER && fat[curr_cluster].value != FREE_CLUSTER) {
-        prev_cluster = curr_cluster;
-        curr_cluster = fat[curr_cluster].value;
-        fat[prev_cluster].value = FREE_CLUSTER;
+void vfs_lock() {
+    int32_t cpu_index = get_cpu()->index;
+    if (vfs_lock_owner == cpu_index) {
+        vfs_lock_depth++;
+        return;
     }
-    // set the EOF cluster as free as well
-    fat[curr_cluster].value = FREE_CLUSTER;
+    spinlock_acquire(&vfs_spinlock);
+    vfs_lock_owner = cpu_index;
+    vfs_lock_depth = 1;
 }
 
-static int exists_n_free_clusters(uint32_t n) {
-    uint32_t i;
-    uint32_t free_cluster = 0;
-
-    // iterate through the clusters and keep counting
-    // free clusters, if you've seen at least n free
-    // clusters, return 1
-    for (i = 0; i < CLUSTER_COUNT; i++) {
-        free_cluster += (fat[i].value == FREE_CLUSTER);
-        if (free_cluster >= n)
-            return 1;
-    }
+static int vfs_trylock() {
+    // only used by an idle CPU, which never holds the lock itself
+    if (atomic_xchg(&vfs_spinlock, 1) != 0)
+        return 1;
+    vfs_lock_owner = get_cpu()->index;
+    vfs_lock_depth = 1;
     return 0;
 }
 
-static uint32_t get_cluster_count_needed(uint32_t size) {
-    // calculate the number of clusters needed to
-    // store an "object" of a particular size
-    uint32_t clusters_needed = size / CLUSTER_SIZE;
-    if (size % CLUSTER_SIZE != 0)
-        clusters_needed++;
-    return clusters_needed;
+void vfs_unlock() {
+    if (--vfs_lock_depth == 0) {
+        vfs_lock_owner = -1;
+        spinlock_release(&vfs_spinlock);
+    }
 }
 
-static uint32_t get_free_cluster() {
-    // find the first cluster, set it as TAKEN,
-    // so it will not be used again and return its index
+static void normalize_filename(char *filename) {
+    // if the length of a name within the path exceeds FILE_NAME_LEN
+    // cut off the tail of it (the same goes for the whole path and MAX_PATH_LEN)
     uint32_t i;
-    for (i = 0; i < CLUSTER_COUNT; i++)
-        if (fat[i].value == FREE_CLUSTER) {
-            fat[i].value = TAKEN_CLUSTER;
-            return i;
-        }
-    // we're out of free clusters
-    // TODO we should probably not panic the system
-    set_color(FOREGROUND_RED);
-    kprintf("ERR: all clusters are full");
-    _panic();
-    // TODO this should be checked by all functions that call get_free_cluster()
-    return TAKEN_CLUSTER;
+    uint32_t len = 0;
+    uint32_t name_len = 0;
+    for (i = 0; filename[i] != '\0' && len < MAX_PATH_LEN - 1; i++) {
+        if (filename[i] == PATH_SEPARATOR)
+            name_len = 0;
+        else if (++name_len >= FILE_NAME_LEN)
+            continue;
+        // the string is written to only if it changes (it may be a literal)
+        if (filename[len] != filename[i])
+            filename[len] = filename[i];
+        len++;
+    }
+    if (filename[len] != '\0')
+        filename[len] = '\0';
 }
 
 int fs_init() {
-    uint32_t i;
-
-    // set all clusters as free
-    for (i = 0; i < CLUSTER_COUNT; i++)
-        fat[i].value = FREE_CLUSTER;
-
-    // create a root directory that will start at cluster 0
-    root = (folder_t *)kmalloc(sizeof(folder_t));
-    root->file_count = 0;
-    root->files = NULL;
-    fat[0].value = TAKEN_CLUSTER;
+    spinlock_init(&vfs_spinlock);
 
-    // save the root directory at the very beginning of the clusters
-    save_root_folder();
-
-    // deallocate it as it is not needed anymore
-    free_root_dir();
-
-    // create some default files as a proof of concept
-    create_default_files();
-    return 0;
+    // the FAT is the root, scratch files go to a tmpfs (they're never stored on the disk)
+    fs_geometry_t *fat = fat_init();
+    if (fat == NULL || mount((char *)"", &fat_ops, fat) != 0)
+        return 1;
+    return mount((char *)"tmp", &tmpfs_ops, tmpfs_create());
 }
 
-static void save_root_folder() {
-    // calculate the total number of clusters needed to store the root dir
-    uint32_t clusters_needed = get_cluster_count_needed(ROOT_FOLDER_SIZE);
-
-    // make sure we have enough clusters to store the root dir
-    // the first cluster (0) is automatically assumed to be there,
-    // therefore we actually need clusters_needed - 1. However, we also
-    // need the EOF cluster, therefore +1
-    if (exists_n_free_clusters(clusters_needed) == 0) {
-        set_color(FOREGROUND_RED);
-        kprintf("ERR: there is not enough space to store the root folder");
-        _panic();
-    }
-
-    uint32_t prev_cluster;
-    uint32_t curr_cluster = ROOT_FIRST_START_CLUSTER;
-
-    // store the number of files at very beginning of the first cluster
-    memcpy((void *)CLUSTER_ADDR(curr_cluster), &root->file_count, sizeof(uint32_t));
-
-    // store as many files as you can into the first cluster as well
-    // the number of files is determined as min(MAX_FILES_IN_FIRST_CLUSTER, root->file_count)
-    memcpy((void *)(CLUSTER_ADDR(curr_cluster) + sizeof(uint32_t)), root->files, min(MAX_FILES_IN_FIRST_CLUSTER, root->file_count) * sizeof(file_t));
-
-    // if there's no more files to store (we don't need more than the first cluster)
-    // add the EOF cluster to the end of the chain, and we're done
-    if (root->file_count <= MAX_FILES_IN_FIRST_CLUSTER) {
-        prev_cluster = curr_cluster;
-        curr_cluster = get_free_cluster();
-
-        fat[prev_cluster].value = curr_cluster;
-        fat[curr_cluster].value = EOF_CLUSTER;
+void fs_flush() {
+    // called by an idle CPU, neither of the locks is waited for (the next tick will try again)
+    if (mount_count == 0 || PIT_get_uptime_ms() - last_flush < BCACHE_FLUSH_INTERVAL)
         return;
-    }
+    last_flush = PIT_get_uptime_ms();
+    if (vfs_trylock() == 0) {
+        uint32_t i;
+        for (i = 0; i < mount_count; i++)
+            if (mounts[i].ops->sync != NULL)
+                mounts[i].ops->sync(mounts[i].fs, BCACHE_FLUSH_BATCH);
+        vfs_unlock();
+    }
+    bcache_flush(BCACHE_FLUSH_BATCH, 0);
+}
 
-    uint32_t file_index = MAX_FILES_IN_FIRST_CLUSTER; // index of the current file to be stored
-    prev_cluster = curr_cluster;
+int fs_sync() {
+    // write everything out right away (1 = there's no disk or it refuses some of the blocks)
+    vfs_lock();
+    int status = 0;
     uint32_t i;
-
-    // the last cluster needs to be dealt with separately
-    // as it's not fully taken up by files (there's some space left)
-    for (i = 0; i < clusters_needed - 2; i++) {
-        // create a link in the FAT table
-        curr_cluster = get_free_cluster();
-        fat[prev_cluster].value = curr_cluster;
-        prev_cluster = curr_cluster;
-
-        // store as many files as you can into the current cluster and move on to the next one
-        memcpy((void *)CLUSTER_ADDR(curr_cluster), &root->files[file_index], MAX_FILES_IN_ONE_CLUSTER * sizeof(file_t));
-        file_index += MAX_FILES_IN_ONE_CLUSTER;
-    }
-
-    // create a link in the FAT table
-    curr_cluster = get_free_cluster();
-    fat[prev_cluster].value = curr_cluster;
-
-    // store the remaining files into the last cluster
-    memcpy((void *)CLUSTER_ADDR(curr_cluster), &root->files[file_index], (root->file_count - file_index) * sizeof(file_t));
-
-    // attach an EOF cluster to the end
-    // of the chain within the FAT table
-    prev_cluster = curr_cluster;
-    curr_cluster = get_free_cluster();
-    fat[prev_cluster].value = curr_cluster;
-    fat[curr_cluster].value = EOF_CLUSTER;
-}
-
-static void load_root_folder() {
-    // make sure the root dir has not been loaded yet
-    if (root != NULL)
-        free_root_dir();
-
-    uint32_t curr_cluster = ROOT_FIRST_START_CLUSTER;
-    root = (folder_t *)kmalloc(sizeof(folder_t));
-
-    // read the number of files off of the first cluster
-    // and allocate an array for them
-    memcpy(&root->file_count, (void *)CLUSTER_ADDR(ROOT_FIRST_START_CLUSTER), sizeof(uint32_t));
-    root->files = (file_t *)kmalloc(root->file_count * sizeof(file_t));
-
-    // read all files store in the first cluster
-    memcpy(root->files, (void *)(CLUSTER_ADDR(curr_cluster) + sizeof(uint32_t)), min(MAX_FILES_IN_FIRST_CLUSTER, root->file_count) * sizeof(file_t));
-
-    // if the number of files (their size) doesn't exceed one cluster, we're done
-    if (root->file_count <= MAX_FILES_IN_FIRST_CLUSTER) {
-        // sanity check of that we've reached the end
-        curr_cluster = fat[curr_cluster].value;
-        if (fat[curr_cluster].value != EOF_CLUSTER) {
-            set_color(FOREGROUND_RED);
-            kprintf("ERR: the rood directory was not loaded properly (missing EOF)");
-            _panic();
-        }
-        return;
-    }
-
-    // index of the current cluster to be read
-    uint32_t file_index = MAX_FILES_IN_FIRST_CLUSTER;
-
-    // process all clusters except for the last one which
-    // has to be processed separately as it is not fully occupied
-    while (fat[fat[fat[curr_cluster].value].value].value != EOF_CLUSTER) {
-        curr_cluster = fat[curr_cluster].value;
-        memcpy(&root->files[file_index], (void *)CLUSTER_ADDR(curr_cluster), MAX_FILES_IN_ONE_CLUSTER * sizeof(file_t));
-        file_index += MAX_FILES_IN_ONE_CLUSTER;
-    }
-
-    // load the remaining files off of the last cluster
-    curr_cluster = fat[curr_cluster].value;
-    memcpy(&root->files[file_index], (void *)CLUSTER_ADDR(curr_cluster), (root->file_count - file_index) * sizeof(file_t));
-
-    // make sure the that's the end of the chain in the FAT table
-    // (the value of the next cluster is indeed EOF_CLUSTER)
-    // just a sanity check
-    curr_cluster = fat[curr_cluster].value;
-    if (fat[curr_cluster].value != EOF_CLUSTER) {
-        set_color(FOREGROUND_RED);
-        kprintf("ERR: the rood directory was not loaded properly (missing EOF)");
-        _panic();
-    }
+    for (i = 0; i < mount_count; i++)
+        if (mounts[i].ops->sync != NULL)
+            status |= mounts[i].ops->sync(mounts[i].fs, 0xFFFFFFFF);
+    bcache_flush(0xFFFFFFFF, 1);
+    if (bcache_get_dirty_count() != 0)
+        status = 1;
+    vfs_unlock();
+    return status;
 }
 
-void ls() {
-    // load the root directory from its location
-    // within the virtual file system
-    load_root_folder();
-
-    // print out all files in it
+static mount_t *get_mount(char *path, char **name) {
+    // the first name within the (normalized) path may be a mount point, otherwise the path leads into the root
+    while (*path == PATH_SEPARATOR)
+        path++;
     uint32_t i;
-    for (i = 0; i < root->file_count; i++) {
-        set_color(FOREGROUND_LIGHTGRAY);
-        kprintf("NAME: ");
-        reset_color();
-        kprintf("%s ", root->files[i].name);
-
-        set_color(FOREGROUND_LIGHTGRAY);
-        kprintf("SIZE: ");
-        reset_color();
-        kprintf("%d [B] ", root->files[i].size);
-
-        set_color(FOREGROUND_LIGHTGRAY);
-        kprintf("CLUSTER: ");
-        reset_color();
-        kprintf("%d ", root->files[i].start_cluster_index);
-
-        set_color(FOREGROUND_LIGHTGRAY);
-        kprintf("SYS: ");
-        reset_color();
-        kprintf("%d ", root->files[i].system);
-
-        set_color(FOREGROUND_LIGHTGRAY);
-        kprintf("STATUS: ");
-        reset_color();
-
-        switch (root->files[i].open) {
-            case 0:
-                kprintf("CLOSED\n\r");
-                break;
-            case 1:
-                kprintf("OPENED\n\r");
-                break;
-            default:
-                kprintf("UNDEFINED\n\r");
+    for (i = 1; i < mount_count; i++) {
+        uint32_t len = strlen(mounts[i].path);
+        if (memcmp(path, mounts[i].path, len) == 0 && (path[len] == '\0' || path[len] == PATH_SEPARATOR)) {
+            *name = (path[len] == '\0') ? &path[len] : &path[len + 1];
+            return &mounts[i];
         }
     }
-    // deallocate it since it's not needed anymore
-    free_root_dir();
+    *name = path;
+    return &mounts[0];
 }
 
-int touch(char *filename) {
-    // normalize the length of the file
-    // to be touched
-    normalize_filename(filename);
-
-    // load the root directory
-    load_root_folder();
-
-    // make sure the name isn't already taken
-    if (exists_file(filename) == 1)
+int mount(char *path, const fs_ops_t *ops, void *fs) {
+    // the root comes first, the other mount points are names within the root dir which are not taken by a file yet
+    normalize_filename(path);
+    vfs_lock();
+    uint32_t i;
+    inode_t inode;
+    uint8_t valid = fs != NULL && mount_count < MAX_MOUNTS && (path[0] == '\0') == (mount_count == 0);
+    if (valid && mount_count != 0)
+        valid = mounts[0].ops->lookup(mounts[0].fs, path, &inode) != 0;
+    for (i = 0; path[i] != '\0'; i++)
+        valid &= path[i] != PATH_SEPARATOR;
+    for (i = 0; i < mount_count; i++)
+        valid &= strcmp(mounts[i].path, path) != 0;
+    if (valid == 0) {
+        vfs_unlock();
         return 1;
-
-    // create a new file and store it into
-    // the root directory
-    create_file(filename);
-
-    // clear out all clusters currently held
-    // by the root directory, so it could be
-    // restored again with it's updated size
-    free_all_occupied_clusters(ROOT_FIRST_START_CLUSTER);
-    save_root_folder();
-
-    // deallocate it since it's not needed anymore
-    free_root_dir();
+    }
+    strcpy(mounts[mount_count].path, path);
+    mounts[mount_count].ops = ops;
+    mounts[mount_count].fs = fs;
+    mount_count++;
+    vfs_unlock();
     return 0;
 }
 
-static void create_file(const char *filename) {
-    // make sure there are at least 2 free clusters
-    // (the start one of the file + its EOF cluster)
-    if (exists_n_free_clusters(2) == 0) {
-        kprintf("there is not enough space to create a file");
-        return;
-    }
-
-    // create a new file array of a size of the current number of files + 1
-    // and store there all files from the root directory
-    file_t *files = (file_t *)kmalloc((root->file_count + 1) * sizeof(file_t));
-    uint32_t i;
-    for (i = 0; i < root->file_count; i++)
-        memcpy(&files[i], &root->files[i], sizeof(file_t));
-
-    // create the new file and store it at the last position within the array
-    strcpy(files[root->file_count].name, filename);
-    files[root->file_count].size = 0;
-    files[root->file_count].open = 0;
-    files[root->file_count].system = 0;
-    files[root->file_count].start_cluster_index = get_free_cluster();
-
-    // create an EOF cluster and link it up to the new file's start cluster
-    uint32_t eof_cluster = get_free_cluster();
-    fat[files[root->file_count].start_cluster_index].value = eof_cluster;
-    fat[eof_cluster].value = EOF_CLUSTER;
-
-    // deallocate the original files of the root directory
-    kfree(root->files);
-
-    // update the current directory
-    root->files = files;
-    root->file_count++;
+static mount_t *lookup(char *path, inode_t *inode) {
+    // return the mount the file given by its (normalized) path is in
+    // along with its inode (NULL if there's no such file)
+    uint32_t hash = hash_string(path);
+    dentry_t *dentry = &dcache[hash % DCACHE_SIZE];
+    if (dentry->mount != NULL && dentry->generation == vfs_generation && dentry->hash == hash && strcmp(dentry->path, path) == 0) {
+        *inode = dentry->inode;
+        return dentry->mount;
+    }
+
+    // ask the file system and remember where the file is for the next time
+    char *name;
+    mount_t *mount = get_mount(path, &name);
+    if (mount->ops->lookup(mount->fs, name, inode) != 0)
+        return NULL;
+    dentry->hash = hash;
+    dentry->generation = vfs_generation;
+    dentry->mount = mount;
+    dentry->inode = *inode;
+    strcpy(dentry->path, path);
+    return mount;
 }
 
-int delete_system_file(char *filename) {
-    // normalize the name of the file
-    normalize_filename(filename);
+static mount_t *stat_file(char *path, inode_t *inode, vfs_attr_t *attr) {
+    // NULL if the file doesn't exist
+    mount_t *mount = lookup(path, inode);
+    if (mount != NULL)
+        mount->ops->getattr(mount->fs, inode, attr);
+    return mount;
+}
 
-    // load the root dir from the memory
-    load_root_folder();
+static void print_dirent(dirent_t *dirent) {
+    set_color(FOREGROUND_LIGHTGRAY);
+    kprintf("NAME: ");
+    reset_color();
+    kprintf("%s ", dirent->name);
+
+    set_color(FOREGROUND_LIGHTGRAY);
+    kprintf("SIZE: ");
+    reset_color();
+    kprintf("%d [B] ", dirent->attr.size);
+
+    set_color(FOREGROUND_LIGHTGRAY);
+    kprintf("INODE: ");
+    reset_color();
+    kprintf("%d ", dirent->attr.ino);
+
+    set_color(FOREGROUND_LIGHTGRAY);
+    kprintf("SYS: ");
+    reset_color();
+    kprintf("%d ", dirent->attr.system);
+
+    set_color(FOREGROUND_LIGHTGRAY);
+    kprintf("DIR: ");
+    reset_color();
+    kprintf("%d ", dirent->attr.directory);
+
+    set_color(FOREGROUND_LIGHTGRAY);
+    kprintf("STATUS: ");
+    reset_color();
+    kprintf("%s\n\r", dirent->attr.open ? "OPENED" : "CLOSED");
+}
 
-    // make sure the file to be deleted DOES exist
-    if (exists_file(filename) == 0) {
-        free_root_dir();
+int ls(char *path) {
+    // an empty path stands for the root dir
+    if (path == NULL)
+        path = (char *)"";
+    normalize_filename(path);
+    vfs_lock();
+    inode_t inode;
+    vfs_attr_t attr;
+    mount_t *mount = stat_file(path, &inode, &attr);
+    if (mount == NULL || attr.directory == 0) {
+        vfs_unlock();
         return 1;
     }
-    // delete the file from the root directory
-    delete_file(filename);
 
-    // clear out all clusters currently held
-    // by the root directory, so it could be
-    // restored again with it's updated size
-    free_all_occupied_clusters(ROOT_FIRST_START_CLUSTER);
-    save_root_folder();
+    // take a copy of the entries, so the lock isn't held while printing
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    uint32_t cursor = 0;
+    dirent_t *dirents = NULL;
+    while (1) {
+        if (count == capacity) {
+            capacity = (capacity == 0) ? 16 : 2 * capacity;
+            dirent_t *array = (dirent_t *)krealloc(dirents, capacity * sizeof(dirent_t));
+            if (array == NULL) {
+                kfree(dirents);
+                vfs_unlock();
+                return 1;
+            }
+            dirents = array;
+        }
+        if (mount->ops->readdir(mount->fs, &inode, &cursor, &dirents[count]) != 0)
+            break;
+        count++;
+    }
+    char *name;
+    uint32_t mounts_to_print = (get_mount(path, &name) == &mounts[0] && *name == '\0') ? mount_count : 0;
+    vfs_unlock();
+
+    // print out all files in it
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        preempt_point();
+        print_dirent(&dirents[i]);
+    }
+    // deallocate the copy since it's not needed anymore
+    kfree(dirents);
 
-    // deallocate it since it's not needed anymore
-    free_root_dir();
+    // the mount points show up in the root dir (they're never unmounted)
+    for (i = 1; i < mounts_to_print; i++) {
+        set_color(FOREGROUND_LIGHTGRAY);
+        kprintf("MOUNT: ");
+        reset_color();
+        kprintf("%s (%s)\n\r", mounts[i].path, mounts[i].ops->type);
+    }
     return 0;
 }
 
-int rm(char *filename) {
-    // normalize the name of the file
-    normalize_filename(filename);
+static int create_file(char *path, uint8_t directory) {
+    // the file system makes sure the dir exists and the name isn't already taken
+    normalize_filename(path);
+    vfs_lock();
+    char *name;
+    mount_t *mount = get_mount(path, &name);
+    int status = mount->ops->create(mount->fs, name, directory);
+    vfs_unlock();
+    return status;
+}
 
-    // load the root dir from the memory
-    load_root_folder();
+int touch(char *filename) {
+    return create_file(filename, 0);
+}
 
-    file_t *file = get_file(filename);
-    if (file->system == 1) {
-        free_root_dir();
-        return 1;
-    }
+int mkdir(char *path) {
+    return create_file(path, 1);
+}
 
-    // make sure the file to be deleted DOES exist
-    if (exists_file(filename) == 0) {
-        free_root_dir();
+static int remove_file(char *path, uint8_t directory, uint8_t system) {
+    // the file has to be of the given kind and system files are removed only on purpose
+    // (the file system makes sure a dir is empty)
+    normalize_filename(path);
+    vfs_lock();
+    inode_t inode;
+    vfs_attr_t attr;
+    mount_t *mount = stat_file(path, &inode, &attr);
+    if (mount == NULL || attr.directory != directory || (attr.system == 1 && system == 0) ||
+        mount->ops->remove(mount->fs, &inode) != 0) {
+        vfs_unlock();
         return 1;
     }
-    // delete the file from the root directory
-    delete_file(filename);
-
-    // clear out all clusters currently held
-    // by the root directory, so it could be
-    // restored again with it's updated size
-    free_all_occupied_clusters(ROOT_FIRST_START_CLUSTER);
-    save_root_folder();
-
-    // deallocate it since it's not needed anymore
-    free_root_dir();
+    vfs_generation++;
+    vfs_unlock();
     return 0;
 }
 
-static void delete_file(const char *filename) {
-    uint32_t i, j;
-    uint32_t file_pos;
-
-    // find the file's position within the root directory
-    for (file_pos = 0; file_pos < root->file_count; file_pos++)
-        if (strcmp(root->files[file_pos].name, filename) == 0)
-            break;
-
-    // create a new file array of a reduced size (by 1)
-    // and store there all the files of the root dir
-    // except for the one to be deleted
-    file_t *files = (file_t *)kmalloc((root->file_count - 1) * sizeof(file_t));
-    for (i = 0, j = 0; i < root->file_count; i++) {
-        if (i == file_pos)
-            continue;
-        memcpy(&files[j++], &root->files[i], sizeof(file_t));
-    }
-
-    // free all clusters held by the files
-    // also we must explicitly free the start cluster of the file
-    free_all_occupied_clusters(root->files[file_pos].start_cluster_index);
-    fat[root->files[file_pos].start_cluster_index].value = FREE_CLUSTER;
+int rmdir(char *path) {
+    return remove_file(path, 1, 0);
+}
 
-    // deallocate the original files
-    // and update the root directory
-    kfree(root->files);
-    root->files = files;
-    root->file_count--;
+int rm(char *filename) {
+    // directories go through rmdir()
+    return remove_file(filename, 0, 0);
 }
 
-static file_t *get_file(char *filename) {
-    // return a reference to a file
-    // in the root dir given by its name
-    normalize_filename(filename);
-    uint32_t i;
-    for (i = 0; i < root->file_count; i++)
-        if (strcmp(root->files[i].name, filename) == 0)
-            return &root->files[i];
-    return NULL;
+int delete_system_file(char *filename) {
+    return remove_file(filename, 0, 1);
 }
 
 int file_exists(char *filename) {
     normalize_filename(filename);
-    load_root_folder();
-    file_t *file = get_file(filename);
-    free_root_dir();
-    return file != NULL;
+    vfs_lock();
+    inode_t inode;
+    mount_t *mount = lookup(filename, &inode);
+    vfs_unlock();
+    return mount != NULL;
 }
 
 int cat(char *filename) {
-    // normalize the length of the file and load the root dir
+    // normalize the length of the file
     normalize_filename(filename);
-    load_root_folder();
+    vfs_lock();
 
     // get the target file and make sure the file exists
-    file_t *file = get_file(filename);
-    if (file == NULL) {
+    inode_t inode;
+    vfs_attr_t attr;
+    mount_t *mount = stat_file(filename, &inode, &attr);
+    if (mount == NULL || attr.directory == 1) {
         kprintf("file not found\n\r");
-        free_root_dir();
+        vfs_unlock();
         return 1;
     }
-    // store the crucial information about the file
-    // and deallocate the root directory as we'll not
-    // need it (we only need the clusters -> fat)
-    uint32_t curr_cluster = file->start_cluster_index;
-    uint32_t size = file->size;
-    free_root_dir();
-
-    uint32_t offset = 0;     // offset within the buffer to be printed out
-    uint32_t bytes_to_read;  // number of bytes to read from the current cluster
-    uint32_t read_bytes = 0; // read bytes so far
-
-    // iterate through the clusters until you reach the EOF cluster
-    while (fat[curr_cluster].value != EOF_CLUSTER) {
-        // check if we still can read the entire cluster
-        // of just a portion of it (the last one)
-        if (size - read_bytes >= CLUSTER_SIZE)
-            bytes_to_read = CLUSTER_SIZE;
-        else
-            bytes_to_read = size - read_bytes;
-
-        // check if it's time to flush (print out) the
-        // content of the buffer
-        if (offset + bytes_to_read >= SCREEN_BUFFER_SIZE) {
-            file_buffer[offset] = '\0';
-            kprintf("%s", file_buffer);
-            offset = 0;
-        }
 
-        // read the data from the cluster into the buffer
-        memcpy(&file_buffer[offset], (void *)CLUSTER_ADDR(curr_cluster), bytes_to_read);
-        offset += bytes_to_read;
+    // print out the file one buffer at a time
+    uint32_t read_bytes = 0;
+    uint32_t bytes_to_read;
+    uint32_t hint = 0;
+    while (read_bytes < attr.size) {
+        bytes_to_read = mount->ops->read(mount->fs, &inode, &hint, file_buffer, read_bytes, SCREEN_BUFFER_SIZE - 1);
+        if (bytes_to_read == 0 || bytes_to_read == (uint32_t)-1)
+            break;
+        file_buffer[bytes_to_read] = '\0';
+        kprintf("%s", file_buffer);
         read_bytes += bytes_to_read;
-
-        // move on to the next cluster
-        curr_cluster = fat[curr_cluster].value;
     }
-    // print the entire buffer onto the screen
-    file_buffer[offset] = '\0';
-    kprintf("%s", file_buffer);
+    vfs_unlock();
     return 0;
 }
 
-static void append_data(char *filename, char *buffer, uint32_t bytes) {
-    // normalize the length of the file
-    // and load the root directory
-    normalize_filename(filename);
-    load_root_folder();
-
-    // make sure the file we're going to append to exists
-    file_t *file = get_file(filename);
-    if (file == NULL) {
-        kprintf("file not found\n\r");
-        free_root_dir();
-    }
-    // offset within the last cluster (where the file data ends)
-    uint32_t offset_in_last_cluster = file->size % CLUSTER_SIZE;
-
-    // start cluster of the file
-    uint32_t curr_cluster = file->start_cluster_index;
-
-    // iterate to the last cluster of the file (the one before EOF_CLUSTER)
-    while (fat[fat[curr_cluster].value].value != EOF_CLUSTER)
-        curr_cluster = fat[curr_cluster].value;
-
-    // calculate how many bytes we can store into the last cluster
-    // (if it's not entirely full)
-    uint32_t bytes_in_last_cluster = min(bytes, (CLUSTER_SIZE - offset_in_last_cluster));
-
-    // copy the bytes into the last cluster of the file and update the file size
-    memcpy((void *)(CLUSTER_ADDR(curr_cluster) + offset_in_last_cluster), buffer, bytes_in_last_cluster);
-    file->size += bytes_in_last_cluster;
-
-    // if we don't have any other bytes to store, we're done
-    // (we have to re-store the root dir - there's the updated file size)
-    if (bytes <= bytes_in_last_cluster) {
-        free_all_occupied_clusters(ROOT_FIRST_START_CLUSTER);
-        save_root_folder();
-        free_root_dir();
-        return;
-    }
-
-    // make sure we have enough clusters available to store the rest of the file as well
-    uint32_t cluster_needed = get_cluster_count_needed(bytes - bytes_in_last_cluster);
-    if (exists_n_free_clusters(cluster_needed) == 0) {
-        kprintf("no enough space to store the rest of the file\n\r");
-        return;
-    }
-    // set the EOF cluster as free, so it could be used to store data
-    fat[fat[curr_cluster].value].value = FREE_CLUSTER;
-
-    file->size += bytes - bytes_in_last_cluster;
-    uint32_t prev_cluster = curr_cluster;
-    uint32_t bytes_stored = bytes_in_last_cluster;
-
-    // the very last cluster needs to be dealt with
-    // separately as it's not fully occupied with data
-    // (we need to calculate how many bytes we store into it)
-    uint32_t i;
-    for (i = 0; i < cluster_needed - 1; i++) {
-        // create a link in the FAT table
-        curr_cluster = get_free_cluster();
-        fat[prev_cluster].value = curr_cluster;
-        prev_cluster = curr_cluster;
-
-        // store data into the current cluster
-        memcpy((void *)CLUSTER_ADDR(curr_cluster), &buffer[bytes_stored], CLUSTER_SIZE);
-
-        // update how many bytes we've stored so far
-        bytes_stored += CLUSTER_SIZE;
+static int copy_data(mount_t *src_mount, inode_t *src, mount_t *des_mount, inode_t *des, uint32_t size) {
+    // the file goes through a buffer one chunk at a time (the file systems may differ)
+    char *buffer = (char *)kmalloc(VFS_COPY_CHUNK);
+    if (buffer == NULL)
+        return 1;
+    uint32_t src_hint = 0;
+    uint32_t des_hint = 0;
+    uint32_t offset;
+    for (offset = 0; offset < size; offset += VFS_COPY_CHUNK) {
+        uint32_t len = min(size - offset, VFS_COPY_CHUNK);
+        if (src_mount->ops->read(src_mount->fs, src, &src_hint, buffer, offset, len) != len ||
+            des_mount->ops->write(des_mount->fs, des, &des_hint, buffer, offset, len) != 0) {
+            kfree(buffer);
+            return 1;
+        }
     }
-    // create a link in the FAT table
-    curr_cluster = get_free_cluster();
-    fat[prev_cluster].value = curr_cluster;
-
-    // store the very last bytes into the very last cluster
-    memcpy((void *)CLUSTER_ADDR(curr_cluster), &buffer[bytes_stored], bytes - bytes_stored);
-
-    // create an EOF cluster and link it up to the rest of the chain
-    prev_cluster = curr_cluster;
-    curr_cluster = get_free_cluster();
-    fat[prev_cluster].value = curr_cluster;
-    fat[curr_cluster].value = EOF_CLUSTER;
-
-    // re-store the root directory
-    // so the file has its updated size
-    free_all_occupied_clusters(ROOT_FIRST_START_CLUSTER);
-    save_root_folder();
-    free_root_dir();
+    kfree(buffer);
+    return 0;
 }
 
 int cp(char *src, char *des) {
@@ -667,349 +409,270 @@ int cp(char *src, char *des) {
         return 1;
 
     // make sure the source file exists
-    load_root_folder();
-    file_t *src_file = get_file(src);
-    if (src_file == NULL) {
-        // kprintf("source file not found\n\r");
-        free_root_dir();
+    vfs_lock();
+    inode_t src_inode;
+    inode_t des_inode;
+    vfs_attr_t src_attr;
+    vfs_attr_t des_attr;
+    mount_t *src_mount = stat_file(src, &src_inode, &src_attr);
+    if (src_mount == NULL || src_attr.directory == 1) {
+        vfs_unlock();
         return 1;
     }
-    // store the start cluster of the source file
-    uint32_t src_curr_cluster = src_file->start_cluster_index;
 
-    // if the destination file already exists, delete it
-    file_t *des_file = get_file(des);
-    free_root_dir();
-    if (des_file != NULL)
-        rm(des);
-
-    // create a destination file
-    touch(des);
+    // if the destination file already exists, delete it (unless it's a directory
+    // or the source file itself under another path) and create a new one
+    mount_t *des_mount = stat_file(des, &des_inode, &des_attr);
+    uint8_t same_file = des_mount == src_mount && des_inode.node == src_inode.node && des_inode.index == src_inode.index;
+    if (des_mount != NULL && (des_attr.directory == 1 || same_file || rm(des) != 0)) {
+        vfs_unlock();
+        return 1;
+    }
+    if (touch(des) != 0) {
+        vfs_unlock();
+        return 1;
+    }
 
-    // make sure we have enough free clusters to store the file
-    if (exists_n_free_clusters(get_cluster_count_needed(src_file->size)) == 0) {
+    // look up both files again (the inodes may have changed in the meantime)
+    src_mount = lookup(src, &src_inode);
+    des_mount = lookup(des, &des_inode);
+    if (src_mount == NULL || des_mount == NULL ||
+        copy_data(src_mount, &src_inode, des_mount, &des_inode, src_attr.size) != 0) {
+        // don't leave a half copied file behind
         set_color(FOREGROUND_LIGHTRED);
         kprintf("ERR: there is not enough place to store the file\n\r");
         reset_color();
+        rm(des);
+        vfs_unlock();
         return 1;
     }
-
-    // load the brand-new destination file
-    // and store its start cluster, also
-    // update its size and restore the root dir
-    // so the change takes effect
-    load_root_folder();
-    des_file = get_file(des);
-    uint32_t des_prev_cluster;
-    uint32_t des_curr_cluster = des_file->start_cluster_index;
-    des_file->size = src_file->size;
-    free_all_occupied_clusters(ROOT_FIRST_START_CLUSTER);
-    save_root_folder();
-    free_root_dir();
-
-    // set the EOF cluster of the new file as free,
-    // so it could be used to store data
-    fat[fat[des_curr_cluster].value].value = FREE_CLUSTER;
-
-    // keep copying clusters until you reach the end of the source file
-    while (fat[src_curr_cluster].value != EOF_CLUSTER) {
-        // copy the current cluster into the destination one
-        memcpy((void *)CLUSTER_ADDR(des_curr_cluster), (void *)CLUSTER_ADDR(src_curr_cluster), CLUSTER_SIZE);
-
-        // create a link in the FAT table (destination file)
-        des_prev_cluster = des_curr_cluster;
-        des_curr_cluster = get_free_cluster();
-        fat[des_prev_cluster].value = des_curr_cluster;
-
-        // move on to the next pair of clusters
-        src_curr_cluster = fat[src_curr_cluster].value;
-    }
-    // mark the last cluster of the destination file as an EOF cluster
-    fat[des_curr_cluster].value = EOF_CLUSTER;
+    vfs_unlock();
     return 0;
 }
 
-void print_FAT(uint32_t n) {
-    uint32_t i;
-    uint32_t to = min(n, CLUSTER_COUNT);
-    for (i = 0; i < to; i++) {
-        switch (fat[i].value) {
-            case EOF_CLUSTER:
-                set_color(FOREGROUND_YELLOW);
-                kprintf("E ");
-                reset_color();
-                break;
-            case FREE_CLUSTER:
-                set_color(FOREGROUND_GREEN);
-                kprintf("F ");
-                reset_color();
-                break;
-            case TAKEN_CLUSTER:
-                set_color(FOREGROUND_BLUE);
-                kprintf("T ");
-                reset_color();
-                break;
-            default:
-                kprintf("%d ", fat[i].value);
-                break;
-        }
-    }
-    kprintf("\n\r");
-}
-
 int read(char *filename, char *buffer, uint32_t offset, uint32_t len) {
-    // normalize the filename, load the root directory
-    // and get the file, so we know where the file starts and how bit it is
+    // normalize the filename
+    // and get the file, so we know how big it is
     normalize_filename(filename);
-    load_root_folder();
-    file_t *file = get_file(filename);
-    free_root_dir();
-
-    // store some essential information about the file
-    // (we'll be needing them)
-    uint32_t curr_cluster = file->start_cluster_index;
-    uint32_t size = file->size;
+    vfs_lock();
+    inode_t inode;
+    vfs_attr_t attr;
+    mount_t *mount = stat_file(filename, &inode, &attr);
+    if (mount == NULL) {
+        vfs_unlock();
+        return 1;
+    }
 
     // make sure we don't want to read out of the
     // boundaries of the file
-    if ((offset + len) > size) {
+    if ((offset + len) > attr.size) {
         kprintf("the start byte is out of range\n\r");
+        vfs_unlock();
         return 1;
     }
+    int status = mount->ops->read(mount->fs, &inode, NULL, buffer, offset, len) != len;
+    vfs_unlock();
+    return status;
+}
 
-    // calculate the start cluster we should read off of
-    // as well as the offset we start at within that cluster
-    uint32_t start_cluster = offset / CLUSTER_SIZE;
-    uint32_t offset_in_start_cluster = offset % CLUSTER_SIZE;
-
-    // move on to the first cluster we want to read data out of
-    uint32_t i;
-    for (i = 0; i < start_cluster; i++)
-        curr_cluster = fat[curr_cluster].value;
-
-    // read the data from the first cluster
-    uint32_t bytes_read = min(len, CLUSTER_SIZE - offset_in_start_cluster);
-    memcpy(buffer, (void *)(CLUSTER_ADDR(curr_cluster) + offset_in_start_cluster), bytes_read);
+int write(char *filename, char *buffer, uint32_t offset, uint32_t len) {
+    // normalize the name of the file and get the corresponding file
+    normalize_filename(filename);
+    vfs_lock();
+    inode_t inode;
+    mount_t *mount = lookup(filename, &inode);
 
-    // if we don't have to read any more data, we're done here
-    if (len <= (CLUSTER_SIZE - offset_in_start_cluster))
+    // make sure the file does exist
+    if (mount == NULL) {
+        kprintf("file not found\n\r");
+        vfs_unlock();
         return 1;
-
-    // keep reading data from clusters until
-    // all bytes have been read
-    uint32_t bytes_to_read;
-    while (bytes_read != len) {
-        // move on to the next cluster using the FAT table
-        curr_cluster = fat[curr_cluster].value;
-
-        // check how many bytes we can read
-        if (bytes_read + CLUSTER_SIZE <= len)
-            bytes_to_read = CLUSTER_SIZE;
-        else
-            bytes_to_read = len - bytes_read;
-
-        // read the amount of bytes from the current cluster
-        // and update how many bytes we've read so far
-        memcpy(&buffer[bytes_read], (void *)CLUSTER_ADDR(curr_cluster), bytes_to_read);
-        bytes_read += bytes_to_read;
     }
-    return 0;
+    int status = mount->ops->write(mount->fs, &inode, NULL, buffer, offset, len);
+    vfs_unlock();
+    return status;
 }
 
 int is_file_open(char *filename) {
-    // normalize the length of the file,
-    // load the root dir, so we can get the file,
-    // and finally load up the file
+    // normalize the length of the file
+    // and look up the file
     normalize_filename(filename);
-    load_root_folder();
-    file_t *file = get_file(filename);
-
-    // free the root dir as we don't need it
-    free_root_dir();
+    vfs_lock();
+    inode_t inode;
+    vfs_attr_t attr;
+    mount_t *mount = stat_file(filename, &inode, &attr);
 
     // if the file doesn't exist of it has not been opened
     // return 0, otherwise return 1
-    if (file == NULL || file->open == 0)
-        return 0;
-    return 1;
+    int open = (mount != NULL && attr.open == 1);
+    vfs_unlock();
+    return open;
 }
 
 int set_as_system_file(char *filename) {
     // check if the file is indeed closed
     normalize_filename(filename);
-    if (is_file_open(filename) == 1)
+    vfs_lock();
+    inode_t inode;
+    vfs_attr_t attr;
+    mount_t *mount = stat_file(filename, &inode, &attr);
+    if (mount == NULL || attr.open == 1) {
+        vfs_unlock();
         return 1; // error
-
-    load_root_folder();
-    file_t *file = get_file(filename);
-    file->system = 1;
-    free_all_occupied_clusters(ROOT_FIRST_START_CLUSTER);
-    save_root_folder();
-    free_root_dir();
-
-    return 0; // success
+    }
+    attr.system = 1;
+    int status = mount->ops->setattr(mount->fs, &inode, &attr);
+    vfs_unlock();
+    return status;
 }
 
-int open_file(char *filename) {
-    // check if the file is indeed closed
+static int set_open(char *filename, uint8_t open) {
+    // the flag has to change (directories cannot be opened)
     normalize_filename(filename);
-    if (is_file_open(filename) == 1)
+    vfs_lock();
+    inode_t inode;
+    vfs_attr_t attr;
+    mount_t *mount = stat_file(filename, &inode, &attr);
+    if (mount == NULL || attr.directory == 1 || attr.open == open) {
+        vfs_unlock();
         return 1; // error
+    }
+    attr.open = open;
+    int status = mount->ops->setattr(mount->fs, &inode, &attr);
+    vfs_unlock();
+    return status;
+}
 
-    // set the flag that the file is now opened
-    // and save the root dir so the change takes effect
-    load_root_folder();
-    file_t *file = get_file(filename);
-    file->open = 1;
-    free_all_occupied_clusters(ROOT_FIRST_START_CLUSTER);
-    save_root_folder();
-    free_root_dir();
-
-    return 0; // success
+int open_file(char *filename) {
+    return set_open(filename, 1);
 }
 
 int close_file(char *filename) {
-    // check if the file is indeed opened
+    return set_open(filename, 0);
+}
+
+static int get_inode(open_file_t *open_file) {
+    // the file is looked up again by its path only if some
+    // file has been removed since the last time (1 = removed)
+    if (open_file->generation != vfs_generation) {
+        if (lookup(open_file->path, &open_file->inode) == NULL)
+            return 1;
+        open_file->generation = vfs_generation;
+        open_file->hint = 0;
+    }
+    return 0;
+}
+
+open_file_t *open_fd(char *filename) {
+    // the file is marked as open the same way as by open_file()
     normalize_filename(filename);
-    if (is_file_open(filename) == 0)
-        return 1; // error
+    vfs_lock();
+    inode_t inode;
+    vfs_attr_t attr;
+    mount_t *mount = stat_file(filename, &inode, &attr);
+    if (mount == NULL || attr.directory == 1 || attr.open == 1) {
+        vfs_unlock();
+        return NULL;
+    }
+    open_file_t *open_file = (open_file_t *)kmalloc(sizeof(open_file_t));
+    if (open_file == NULL) {
+        vfs_unlock();
+        return NULL;
+    }
+    attr.open = 1;
+    if (mount->ops->setattr(mount->fs, &inode, &attr) != 0) {
+        kfree(open_file);
+        vfs_unlock();
+        return NULL;
+    }
+    open_file->ops = mount->ops;
+    open_file->fs = mount->fs;
+    open_file->inode = inode;
+    open_file->generation = vfs_generation;
+    open_file->hint = 0;
+    open_file->position = 0;
+    open_file->refs = 1;
+    strcpy(open_file->path, filename);
+    vfs_unlock();
+    return open_file;
+}
 
-    // set the flag that the file is now closed
-    // and save the root dir so the change takes effect
-    load_root_folder();
-    file_t *file = get_file(filename);
-    file->open = 0;
-    free_all_occupied_clusters(ROOT_FIRST_START_CLUSTER);
-    save_root_folder();
-    free_root_dir();
+void dup_fd(open_file_t *open_file) {
+    atomic_add(&open_file->refs, 1);
+}
 
-    return 0; // success
+void close_fd(open_file_t *open_file) {
+    // the file gets closed once the last descriptor referring to it is gone
+    if (atomic_add(&open_file->refs, (uint32_t)-1) != 1)
+        return;
+    vfs_lock();
+    if (get_inode(open_file) == 0) {
+        vfs_attr_t attr;
+        open_file->ops->getattr(open_file->fs, &open_file->inode, &attr);
+        attr.open = 0;
+        open_file->ops->setattr(open_file->fs, &open_file->inode, &attr);
+    }
+    vfs_unlock();
+    kfree(open_file);
 }
 
-int write(char *filename, char *buffer, uint32_t offset, uint32_t len) {
-    // normalize the name of the file and get the corresponding file
-    normalize_filename(filename);
-    load_root_folder();
-    file_t *file = get_file(filename);
+uint32_t read_fd(open_file_t *open_file, char *buffer, uint32_t len) {
+    // returns the number of bytes read (0 = the end of the file), or (uint32_t)-1
+    vfs_lock();
+    if (get_inode(open_file) != 0) {
+        vfs_unlock();
+        return (uint32_t)-1;
+    }
+    len = open_file->ops->read(open_file->fs, &open_file->inode, &open_file->hint, buffer, open_file->position, len);
+    if (len != (uint32_t)-1)
+        open_file->position += len;
+    vfs_unlock();
+    return len;
+}
 
-    // make sure the file does exist
-    if (file == NULL) {
-        kprintf("file not found\n\r");
-        free_root_dir();
-        return 1;
-    }
-    // make sure the offset falls into the files boundaries
-    if (offset > file->size) {
-        kprintf("the offset is greater than the size of the file itself\n\r");
-        free_root_dir();
-        return 1;
-    }
-    // check if attaching the file to the end would be enough
-    if (offset == file->size) {
-        free_root_dir();
-        append_data(filename, buffer, len);
-        return 0;
-    }
-    // make sure we have enough clusters available to store the contents of the file
-    if (exists_n_free_clusters(get_cluster_count_needed(file->size + len)) == 0) {
-        kprintf("not enough space to extend the file\n\r");
-        free_root_dir();
-        return 1;
-    }
-    // store the original size of the file
-    uint32_t original_file_size = file->size;
-
-    // the size of the file is the offset (where we have to cut the file off)
-    // re-store the root directory so the file has its updated size
-    file->size = offset;
-    free_all_occupied_clusters(ROOT_FIRST_START_CLUSTER);
-    save_root_folder();
-    free_root_dir();
-
-    // calculate the cluster we want to insert data into
-    // as well as the offset within that cluster
-    uint32_t curr_cluster = file->start_cluster_index;
-    uint32_t start_cluster = offset / CLUSTER_SIZE;
-    uint32_t offset_in_start_cluster = offset % CLUSTER_SIZE;
-
-    // calculate the size of the tmp buffer we'll need to store
-    // the rest of hte file (from where it'll be cut off)
-    uint32_t clusters_needed = get_cluster_count_needed(original_file_size);
-    uint32_t tmp_buffer_size = (clusters_needed - start_cluster) * CLUSTER_SIZE;
-
-    // create a tmp array for the tail of the file that had to cut off
-    // in order to insert there the new data
-    uint32_t tmp_buff_offset = 0;
-    char *tmp_buff = (char *)kmalloc(tmp_buffer_size);
-    memset((void *)tmp_buff, 0, tmp_buffer_size);
-
-    // move to the first cluster we want to copy
-    // data into the tmp array (so it could be appended
-    // to the end once we're inserted the data)
-    uint32_t i;
-    for (i = 0; i < start_cluster; i++)
-        curr_cluster = fat[curr_cluster].value;
-
-    // the amount of bytes we copy from the first (last) cluster
-    // (the spot were we split the file up)
-    uint32_t bytes_in_first_cluster = CLUSTER_SIZE - offset_in_start_cluster;
-
-    // copy the amount of bytes from the first (last) cluster into our tmp array
-    memcpy((void *)tmp_buff, (void *)(CLUSTER_ADDR(curr_cluster) + offset_in_start_cluster), bytes_in_first_cluster);
-    tmp_buff_offset += bytes_in_first_cluster;
-
-    // move on to the next cluster
-    uint32_t first = 1;
-    uint32_t prev_cluster;
-    curr_cluster = fat[curr_cluster].value;
-
-    // keep copying cluster until you reach the end (then we'll have the split up part of
-    // the file store in our tmp array)
-    while (fat[curr_cluster].value != EOF_CLUSTER) {
-        // copy data from the current cluster
-        memcpy((void *)&tmp_buff[tmp_buff_offset], (void *)CLUSTER_ADDR(curr_cluster), CLUSTER_SIZE);
-        tmp_buff_offset += CLUSTER_SIZE;
-
-        // move on to the next cluster
-        prev_cluster = curr_cluster;
-        curr_cluster = fat[curr_cluster].value;
-
-        // set the cluster as free, so it could be used again
-        // when appending data (the one after the split spot needs
-        // to be set as an EOF cluster, so the append function can
-        // determinate the end of the file - where to append data)
-        if (first == 1) {
-            fat[prev_cluster].value = EOF_CLUSTER;
-            first = 0;
-        } else {
-            fat[prev_cluster].value = FREE_CLUSTER;
-        }
-    }
-    // append the data we want to insert
-    append_data(filename, buffer, len);
-    // append the original tail of the file (what we split off)
-    append_data(filename, tmp_buff, tmp_buff_offset - (CLUSTER_SIZE - original_file_size % CLUSTER_SIZE));
+uint32_t write_fd(open_file_t *open_file, char *buffer, uint32_t len) {
+    // returns the number of bytes written, or (uint32_t)-1
+    vfs_lock();
+    if (get_inode(open_file) != 0 ||
+        open_file->ops->write(open_file->fs, &open_file->inode, &open_file->hint, buffer, open_file->position, len) != 0) {
+        vfs_unlock();
+        return (uint32_t)-1;
+    }
+    open_file->position += len;
+    vfs_unlock();
+    return len;
+}
 
-    // we don't need to the tmp array anymore
-    kfree(tmp_buff);
-    return 0;
+int32_t lseek(open_file_t *open_file, int32_t offset, uint32_t whence) {
+    // returns the new position, or -1 (the position cannot go past the end of the file)
+    vfs_lock();
+    if (get_inode(open_file) != 0) {
+        vfs_unlock();
+        return -1;
+    }
+    vfs_attr_t attr;
+    open_file->ops->getattr(open_file->fs, &open_file->inode, &attr);
+    int32_t position = -1;
+    switch (whence) {
+        case SEEK_SET: position = offset;                                break;
+        case SEEK_CUR: position = (int32_t)open_file->position + offset; break;
+        case SEEK_END: position = (int32_t)attr.size + offset;           break;
+    }
+    if (position < 0 || (uint32_t)position > attr.size) {
+        vfs_unlock();
+        return -1;
+    }
+    open_file->position = position;
+    vfs_unlock();
+    return position;
 }
 
 uint32_t get_file_size(char *filename) {
     normalize_filename(filename);
-    load_root_folder();
-    file_t *file = get_file(filename);
-    if (file == NULL)
-        return 0;
-    uint32_t size = file->size;
-    free_root_dir();
-    return size;
+    vfs_lock();
+    inode_t inode;
+    vfs_attr_t attr;
+    mount_t *mount = stat_file(filename, &inode, &attr);
+    vfs_unlock();
+    return (mount == NULL) ? 0 : attr.size;
 }
-
-uint32_t get_memory_available() {
-    uint32_t free_cluster = 0;
-    uint32_t i;
-    for (i = 0; i < CLUSTER_COUNT; i++)
-        free_cluster += (fat[i].value == FREE_CLUSTER);
-    return free_cluster * CLUSTER_SIZE;
-}
\ No newline at end of file
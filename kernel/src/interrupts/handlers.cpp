@@ -8,16 +8,30 @@
 #include <processes/process.h>
 #include <processes/scheduler.h>
 #include <processes/syscalls.h>
+#include <drivers/apic/apic.h>
+#include <drivers/pit/pit.h>
+#include <smp/smp.h>
+#include <mem/heap.h>
+#include <fs/vfs.h>
+#include <fpu/fpu.h>
 
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 
 static void kill_running_process() {
-    PCB_t *running_process = get_running_process();
-    wake_up_parent_process(running_process->ppid, 1);
-    kill_process(running_process);
+    kill_process(get_running_process());
     switch_to_next_process();
 }
 
+// Device not available interrupt handler (the first use of the FPU within a time slice)
+static void int0x7_handler(Interrupt_generic_registers_t *regs) {
+    if (FPU_device_not_available(get_running_process()) != 0) {
+        set_color(FOREGROUND_YELLOW);
+        kprintf("Interrupt Device not available! (FPU)\r\n");
+        reset_color();
+        kill_running_process();
+    }
+}
+
 // Double Fault Exception interrupt handler
 static void int0x8_handler(Interrupt_generic_registers_t *regs) {
     set_color(FOREGROUND_YELLOW);
@@ -70,7 +84,7 @@ static void int0x10_handler(Interrupt_generic_registers_t *regs) {
     set_color(FOREGROUND_YELLOW);
     kprintf("Interrupt Coprocessor fault\r\n");
     reset_color();
-    _panic();
+    kill_running_process();
 }
 
 // SIMD Floating-Point Exception interrupt handler
@@ -83,48 +97,118 @@ static void int0x13_handler(Interrupt_generic_registers_t *regs) {
 
 // Keyboard interrupt handler
 static void int0x21_handler(Interrupt_generic_registers_t *regs) {
+    // Ctrl+C may switch over to another process, so the context of the
+    // interrupted one must not get lost (unless we've interrupted the kernel)
+    if (get_cpu()->in_preempt_point == 0)
+        save_process_context(get_running_process(), regs);
+
     uint8_t scancode = _inb(KEYBOARD_DATA_PORT);
-    process_key(scancode);
 
     // PIC is waiting for us to let him know once
-    // we're done handling the interrupt
-    // by default PIT is connected via IRQ0
+    // we're done handling the interrupt (it's done before
+    // processing the key as that may switch to another process)
     PIC_sendEOI(PS2_KEYBOARD);
+    process_key(scancode);
 }
 
 // Syscall interrupt handler
 static void int0x80_handler(Interrupt_generic_registers_t *regs) {
     PCB_t *running_process = get_running_process();
     save_process_context(running_process, regs);
+
+    // the process has been killed while it was running on this CPU
+    if (running_process->pending_kill) {
+        kill_process(running_process);
+        switch_to_next_process();
+    }
     sys_callback();
     switch_to_next_process();
 }
 
-// Page fault explicit interrupt handler
-void _int0xE_handler(uint32_t pfla) {
+// Page fault interrupt handler
+static void int0xE_handler(Interrupt_generic_registers_t *regs) {
+    uint32_t addr = _get_cr2();
+    PCB_t *running_process = get_running_process();
+
+    // the user heap gets its frames once it's touched, be it by the process itself
+    // or by the kernel on its behalf (e.g. a system call filling in a buffer)
+    if ((regs->err_code & PAGE_FAULT_PROTECTION) == 0 && running_process != NULL &&
+        _get_page_dir() == running_process->process->cr3 && map_user_heap_page(running_process->process, addr) == 0) {
+        return;
+    }
     set_color(FOREGROUND_YELLOW);
-    kprintf("Interrupt Page Fault, on address: 0x%x\r\n", pfla);
+    kprintf("Interrupt Page Fault, on address: 0x%x\r\n", addr);
     reset_color();
     kill_running_process();
 }
 
-// PIT explicit interrupt handler
-void int0x20_handler(Interrupt_generic_registers_t *regs) {
-    // switch context every N ticks
-    static int ticks = 0;
-    if (++ticks % TICKS_FOR_TASK_SWITCH == 0) {
-        ticks = 0;
-    } else {
-        PIC_sendEOI(PIT_IRQ);
+// Shared by the PIT (BSP) and the local APIC timer (APs)
+// the interrupt must have been acknowledged by the caller
+static void timer_tick(Interrupt_generic_registers_t *regs) {
+    cpu_t *cpu = get_cpu();
+    PCB_t *running_process = cpu->running_process;
+
+    // we've interrupted the kernel, so just let it know
+    // it's time to switch once it reaches the preemption point
+    if (cpu->in_preempt_point) {
+        if (++cpu->ticks >= TICKS_FOR_TASK_SWITCH)
+            cpu->need_resched = 1;
+        return;
+    }
+
+    // we've interrupted the process in the user space, so it's a good time to go
+    // through the operations it has queued up without having called ring_enter()
+    if (running_process != cpu->idle_process && running_process->pending_kill == 0) {
+        ring_t *ring = running_process->process->ring;
+        if (ring != NULL && ring->sq_head != ring->sq_tail) {
+            cpu->preempt_count++;
+            ring_drain(running_process, 0);
+            cpu->preempt_count--;
+        }
+    }
+
+    // the CPU has nothing else to do, so give the unused kernel heap
+    // memory back and write the changes of the file system to the disk
+    if (running_process == cpu->idle_process) {
+        kernel_heap_trim();
+        fs_flush();
+    }
+
+    // switch context every N ticks (an idle CPU checks
+    // for work on every tick, it may steal some from others)
+    if (++cpu->ticks < TICKS_FOR_TASK_SWITCH && running_process != cpu->idle_process &&
+        running_process->pending_kill == 0) {
         return;
     }
-    PCB_t *running_process = get_running_process();
     save_process_context(running_process, regs);
-    set_process_as_ready(running_process);
-    PIC_sendEOI(PIT_IRQ);
+    if (running_process->pending_kill) {
+        kill_process(running_process);
+    } else {
+        set_process_as_ready(running_process);
+    }
     switch_to_next_process();
 }
 
+// PIT explicit interrupt handler
+void int0x20_handler(Interrupt_generic_registers_t *regs) {
+    PIC_sendEOI(PIT_IRQ);
+    PIT_tick();
+    wake_up_expired_timers(PIT_get_uptime_ms());
+    timer_tick(regs);
+}
+
+// local APIC timer interrupt handler
+static void int0x30_handler(Interrupt_generic_registers_t *regs) {
+    LAPIC_send_EOI();
+    timer_tick(regs);
+}
+
+// TLB shootdown interrupt handler
+static void int0x31_handler(Interrupt_generic_registers_t *regs) {
+    LAPIC_send_EOI();
+    SMP_handle_tlb_flush();
+}
+
 static void int0x2C_handler(Interrupt_generic_registers_t *regs) {
     mouse_callback();
     PIC_sendEOI(PIC1_IRQ_ACK);
@@ -134,6 +218,9 @@ static void int0x2C_handler(Interrupt_generic_registers_t *regs) {
 //Generic interrupt handler
 void _generic_interrupt_handler(Interrupt_generic_registers_t regs) {
     switch (regs.int_no) {
+        case 0x7:
+            int0x7_handler(&regs);
+            break;
         case 0x8:
             int0x8_handler(&regs);
             break;
@@ -149,6 +236,9 @@ void _generic_interrupt_handler(Interrupt_generic_registers_t regs) {
         case 0xD:
             int0xD_handler(&regs);
             break;
+        case 0xE:
+            int0xE_handler(&regs);
+            break;
         case 0xF:
             int0xF_handler(&regs);
             break;
@@ -164,6 +254,12 @@ void _generic_interrupt_handler(Interrupt_generic_registers_t regs) {
         case 0x21:
             int0x21_handler(&regs);
             break;
+        case 0x30:
+            int0x30_handler(&regs);
+            break;
+        case 0x31:
+            int0x31_handler(&regs);
+            break;
         case 0x80:
             int0x80_handler(&regs);
             break;
@@ -2,6 +2,7 @@
 #include <mem/gdt.h>
 #include <common.h>
 #include <interrupts/interrupts.h>
+#include <drivers/apic/apic.h>
 
 IDT_descriptor_t idt_desc;
 IDT_gate_t idt_gates[IDT_GATE_COUNT];
@@ -19,6 +20,7 @@ int IDT_init() {
     // set handlers for the particular interrupts
     // the functions that accept the interrupt are written in assembly,
     // however, from there, we jump back to c++ (handlers.h/cpp)
+    set_idt_gate(0x07, reinterpret_cast<uint32_t>(&_isr7), KERNEL_CODE_SEG, IDT_PRESENT, 0, 0, IDT_32_BIT_INTERRUPT_GATE); // Device Not Available (FPU)
     set_idt_gate(0x08, reinterpret_cast<uint32_t>(&_isr8), KERNEL_CODE_SEG, IDT_PRESENT, 0, 0, IDT_32_BIT_INTERRUPT_GATE); // Double Fault
     set_idt_gate(0x0A, reinterpret_cast<uint32_t>(&_isrA), KERNEL_CODE_SEG, IDT_PRESENT, 0, 0, IDT_32_BIT_INTERRUPT_GATE); // Invalid TSS
     set_idt_gate(0x0B, reinterpret_cast<uint32_t>(&_isrB), KERNEL_CODE_SEG, IDT_PRESENT, 0, 0, IDT_32_BIT_INTERRUPT_GATE); // Segment Not Present
@@ -30,6 +32,9 @@ int IDT_init() {
     set_idt_gate(0x13, reinterpret_cast<uint32_t>(&_isr13), KERNEL_CODE_SEG, IDT_PRESENT, 0, 0, IDT_32_BIT_INTERRUPT_GATE); // SIMD Floating-Point Exception
     set_idt_gate(0x20, reinterpret_cast<uint32_t>(&_isr20), KERNEL_CODE_SEG, IDT_PRESENT, 0, 0, IDT_32_BIT_INTERRUPT_GATE); // PIT (system timer)
     set_idt_gate(0x21, reinterpret_cast<uint32_t>(&_isr21), KERNEL_CODE_SEG, IDT_PRESENT, 0, 0, IDT_32_BIT_INTERRUPT_GATE); // keyboard
+    set_idt_gate(LAPIC_TIMER_VECTOR, reinterpret_cast<uint32_t>(&_isr30), KERNEL_CODE_SEG, IDT_PRESENT, 0, 0, IDT_32_BIT_INTERRUPT_GATE); // local APIC timer (APs)
+    set_idt_gate(LAPIC_TLB_FLUSH_VECTOR, reinterpret_cast<uint32_t>(&_isr31), KERNEL_CODE_SEG, IDT_PRESENT, 0, 0, IDT_32_BIT_INTERRUPT_GATE); // TLB shootdown
+    set_idt_gate(LAPIC_SPURIOUS_VECTOR, reinterpret_cast<uint32_t>(&_isrFF), KERNEL_CODE_SEG, IDT_PRESENT, 0, 0, IDT_32_BIT_INTERRUPT_GATE); // local APIC spurious interrupt
     set_idt_gate(0x80, reinterpret_cast<uint32_t>(&_isr80), KERNEL_CODE_SEG, IDT_PRESENT, 3, 0, IDT_32_BIT_INTERRUPT_GATE); // system calls
     set_idt_gate(0x2C, reinterpret_cast<uint32_t>(&_isr2C), KERNEL_CODE_SEG, IDT_PRESENT, 0, 0, IDT_32_BIT_INTERRUPT_GATE); // system calls
 
@@ -38,11 +43,16 @@ int IDT_init() {
     idt_desc.base  = reinterpret_cast<uint32_t>(&idt_gates);
 
     // load descriptor to the CPU
-    _load_idt(reinterpret_cast<uint32_t>(&idt_desc));
+    IDT_load();
 
     return 0; // IDT has been loaded successfully
 }
 
+void IDT_load() {
+    // all CPUs share the same IDT, so the APs only need to load it
+    _load_idt(reinterpret_cast<uint32_t>(&idt_desc));
+}
+
 void set_idt_gate(uint8_t index, uint32_t handler_addr, uint16_t segment, uint8_t present, uint8_t DPL, uint8_t storage_segment, uint8_t type) {
     idt_gates[index].offset_low  = handler_addr & 0xFFFF;  // lower 16 bits of the address off the handler function
     idt_gates[index].selector    = segment;                // code segment selector in GDT or LDT
@@ -1,6 +1,7 @@
 ;   Inspiration: http://www.osdever.net/bkerndev/Docs/isrs.htm
 ;   Code below, if interrupt has an error code, it is pushed to the stack before the execution of the rutine is started
 ;   Also, it should be poped by isr
+global _isr7
 global _isr8
 global _isrA
 global _isrB
@@ -12,12 +13,23 @@ global _isr10
 global _isr13
 global _isr20
 global _isr21
+global _isr30
+global _isr31
 global _isr80
 global _isr2C
+global _isrFF
 
 ; Those with error codes SHOULD NOT push the dummy 0 error code
 ; List of defaultly set isrs: 8, A, B, C, D, E
 
+;  7: Device not available - raised by the first FPU/SSE
+;  instruction of a process since CR0.TS was set
+_isr7:
+    cli                                 ; disable interrupts (Activating another interrupt will mess up things)
+    push 0                              ; Dummy error code
+    push 0x7                            ; Push interrupt code
+    jmp isr_common_stub                 ; jump to common part
+
 ;  8: Double Fault Exception (With Error Code!)
 _isr8:
     cli                                 ; disable interrupts (Activating another interrupt will mess up things)
@@ -58,36 +70,13 @@ _isrD:
                                         ; that pop error codes!
     jmp isr_common_stub_error_code      ; jump to common part with error code handling
 
-;  External C function
-extern _int0xE_handler
-
 ;  E: Page fault (With Error Code!)
 _isrE:
     cli                                 ; disable interrupts (Activating another interrupt will mess up things)
-    pusha                               ; Push all Registers (EDI, ESI, EBP, ESP, EBX, EDX, ECX, EAX)
-    push ds                             ; Push segment registers, might be handy
-    push es
-    push fs
-    push gs
-    mov ax, 0x10                        ; Load the Kernel Data Segment descriptor! TODO: Is it ok?
-    mov ds, ax                          ; Set all segment registers to Kernel
-    mov es, ax
-    mov fs, ax
-    mov gs, ax
-    mov ss, ax                          ; TODO: Is it ok???? added for 0x80, 0x20 a 0x21
-
-    mov     eax, cr2                    ; eax = address of the page fault
-    push    eax                         ; store it onto the stack
-    mov eax, _int0xE_handler
-    call eax                            ; A special call, preserves the 'eip' register
-
-    pop gs
-    pop fs
-    pop es
-    pop ds
-    popa
-    sti                                 ; once we're done enable interrupts
-    iret
+    push 0xE                            ; Note that we DON'T push a value on the stack in this one!
+                                        ; It pushes one already! Use this type of stub for exceptions
+                                        ; that pop error codes!
+    jmp isr_common_stub_error_code      ; jump to common part with error code handling
 
 ;  F: Unknown interrupt
 _isrF:
@@ -143,6 +132,27 @@ _isr2C:
     push 0x2C                           ; Push interrupt code
     jmp isr_common_stub                 ; jump to common part
 
+;  30: local APIC timer handler - the APs
+;  use it instead of the PIT to preempt processes
+_isr30:
+    cli                                 ; disable interrupts (Activating another interrupt will mess up things)
+    push 0                              ; Dummy error code
+    push 0x30                           ; Push interrupt code
+    jmp isr_common_stub                 ; jump to common part
+
+;  31: TLB shootdown - another CPU has changed
+;  the mappings of the address space we're using
+_isr31:
+    cli                                 ; disable interrupts (Activating another interrupt will mess up things)
+    push 0                              ; Dummy error code
+    push 0x31                           ; Push interrupt code
+    jmp isr_common_stub                 ; jump to common part
+
+;  FF: local APIC spurious interrupt - it must
+;  not be acknowledged (no EOI), so just return
+_isrFF:
+    iret
+
 ; We call a C function in here. We need to let the assembler know
 ; that '_generic_interrupt_handler' exists in another file
 extern _generic_interrupt_handler
@@ -201,6 +211,6 @@ isr_common_stub_error_code:
     pop es
     pop ds
     popa
-    add esp, 4                          ; Cleans up the pushed ISR number
+    add esp, 8                          ; Cleans up the error code and the pushed ISR number
     sti                                 ; once we're done enable interrupts
     iret                                ; pops 5 things at once: CS, EIP, EFLAGS, SS, and ESP!
\ No newline at end of file
@@ -12,13 +12,22 @@
 #include <drivers/pit/pit.h>
 #include <drivers/keyboard/keyboard.h>
 #include <drivers/mouse/mouse.h>
+#include <drivers/ata/ata.h>
 
 #include <fs/vfs.h>
+#include <fs/fat.h>
+#include <fs/bcache.h>
 #include <stdint.h>
 #include <common.h>
 
 #include <processes/process.h>
 #include <processes/scheduler.h>
+#include <processes/futex.h>
+#include <processes/mq.h>
+#include <processes/user_programs.h>
+
+#include <smp/smp.h>
+#include <fpu/fpu.h>
 
 typedef void (*fn_ptr)();
 
@@ -159,14 +168,28 @@ static void print_basic_kernel_info() {
             kernel_stack_size / 1024);
 
     // print out location of the kernel heap
-    kprintf("kernel heap location     : [0x%x - 0x%x] (%d MB)\n\r", KERNEL_HEAP_START_ADDR,
-            (KERNEL_HEAP_START_ADDR + KERNEL_HEAP_SIZE), KERNEL_HEAP_SIZE / 1024 / 1024);
+    kprintf("kernel heap location     : [0x%x - 0x%x] (%d KB mapped out of %d MB)\n\r", KERNEL_HEAP_START_ADDR,
+            (KERNEL_HEAP_START_ADDR + KERNEL_HEAP_MAX_SIZE), get_kernel_heap_mapped_size() / 1024,
+            KERNEL_HEAP_MAX_SIZE / 1024 / 1024);
+
+    // print out location of the initrd
+    kprintf("initrd location          : [0x%x - 0x%x] (%d KB, %d programs)\n\r", get_initrd_addr(),
+            get_initrd_addr() + get_initrd_size(), get_initrd_size() / 1024, get_program_count());
 
     // print out location of the FS
-    kprintf("filesystem location      : [0x%x - 0x%x] (%d MB)\n\r", FS_START_ADDR, (FS_START_ADDR + FS_SIZE),
-            FS_SIZE / 1024 / 1024);
+    kprintf("filesystem location      : [0x%x - 0x%x] (%d MB, FAT%d, %d B clusters)\n\r", FS_START_ADDR,
+            (FS_START_ADDR + get_fs_size()), get_fs_size() / 1024 / 1024, get_fat_entry_bits(), get_cluster_size());
 
     kprintf("free space within VFS    : %d KB\n\r", get_memory_available() / 1024);
+
+    // print out how long it took to read the FS back from the disk
+    if (bcache_get_block_count() != 0) {
+        kprintf("disk (ATA PIO)           : ");
+        bcache_print_stats();
+    }
+
+    // print out how many CPUs are up and running
+    kprintf("number of CPUs           : %d\n\r", get_cpu_count());
     reset_color();
 }
 
@@ -189,6 +212,14 @@ extern "C" int _kernel_main(uint32_t magicNumber, multiboot_info_t *multibootHea
     clear_screen();  // clear the screen up
     scan_memory(multibootHeader, 1);
 
+    // the user programs come as a module, which has to lie within the first 4MB
+    // (paging puts the page tables right behind them)
+    if (load_initrd(multibootHeader) != 0) {
+        set_color(FOREGROUND_RED);
+        kprintf("Error: No initrd with the user programs was provided below 4MB!");
+        _panic();
+    }
+
     // calculate the size of the kernel as well as the stack size
     kernel_size = &_kernel_physical_end - &_kernel_physical_start;
     kernel_stack_size = (uint32_t )&_kernel_stack_top - (uint32_t )&_kernel_stack_bottom;
@@ -198,15 +229,22 @@ extern "C" int _kernel_main(uint32_t magicNumber, multiboot_info_t *multibootHea
     init_function("initializing PIC            ", &PIC_remap);
     init_function("initializing IDT            ", &IDT_init);
     init_function("initializing PIT            ", &PIT_init);
+    init_function("initializing FPU/SSE        ", &FPU_init);
     init_function("initializing PS/2 keyboard  ", &keyboard_init);
     init_function("initializing PS/2 mouse     ", &mouse_init);
     init_function("initializing paging         ", &paging_init);
     init_function("initializing kernel heap    ", &kernel_heap_init);
+    init_function("initializing ATA disk       ", &ata_init);
+    init_function("initializing buffer cache   ", &bcache_init);
     init_function("initializing VFS            ", &fs_init);
     init_function("initializing processes      ", &init_processes);
+    init_function("initializing futexes        ", &futex_init);
+    init_function("initializing message queues ", &mq_init);
+    init_function("initializing SMP            ", &SMP_init);
 
     print_basic_kernel_info();
     init_process_scheduler();
+    SMP_release_APs();
     switch_to_next_process();
 
     // there's no point of ever returning from the kernel
@@ -1,11 +1,14 @@
 #include <mem/gdt.h>
 #include <common.h>
 #include <memory.h>
+#include <smp/smp.h>
 
-static GDT_descriptor_t gdt_desc;
-static GDT_entry_t gdt_entries[GDT_ENTRY_COUNT];
+// each CPU needs its own TSS (it holds the kernel stack of the CPU),
+// therefore it needs its own GDT as well (the TSS descriptor is marked busy once loaded)
+static GDT_descriptor_t gdt_descs[MAX_CPUS];
+static GDT_entry_t gdt_entries_per_cpu[MAX_CPUS][GDT_ENTRY_COUNT];
 
-static TSS_entry_t tss_entry;
+static TSS_entry_t tss_entries[MAX_CPUS];
 
 static void set_gdt_entry(GDT_entry_t *entry, uint32_t base, uint32_t limit) {
     if (limit > 0xFFFFF) {
@@ -22,11 +25,11 @@ static void set_gdt_entry(GDT_entry_t *entry, uint32_t base, uint32_t limit) {
 
 extern "C" int _kernel_stack_top;
 
-static void TSS_init() {
+static void TSS_init(GDT_entry_t *gdt_entries, TSS_entry_t *tss_entry, uint32_t kernel_stack_top) {
 
-    memset(&tss_entry, 0, sizeof(TSS_entry_t)); //CLEAR!!!
+    memset(tss_entry, 0, sizeof(TSS_entry_t)); //CLEAR!!!
 
-    uint32_t base = (uint32_t)&tss_entry;
+    uint32_t base = (uint32_t)tss_entry;
     uint32_t limit = sizeof(TSS_entry_t); //TODO: Is this limit size?? or limit pointer???
 
     // TSS (Set to E9: 1 11 0 1 0 0 1)
@@ -41,15 +44,22 @@ static void TSS_init() {
     gdt_entries[GDT_TSS_INDEX].GR       = 1; // page granularity (4K)
     gdt_entries[GDT_TSS_INDEX].SZ       = 1; // 32 bit protected mode
 
-    tss_entry.SS0 = KERNEL_DATA_SEG;
-    tss_entry.ESP0 = (uint32_t)&_kernel_stack_top - 1;
-    tss_entry.IOPB_offset = (uint16_t)sizeof(TSS_entry_t);
+    tss_entry->SS0 = KERNEL_DATA_SEG;
+    tss_entry->ESP0 = kernel_stack_top;
+    tss_entry->IOPB_offset = (uint16_t)sizeof(TSS_entry_t);
 
-    tss_entry.CS = 0x0b;
-    tss_entry.SS = tss_entry.DS = tss_entry.ES = tss_entry.FS = tss_entry.GS = 0x13;
+    tss_entry->CS = 0x0b;
+    tss_entry->SS = tss_entry->DS = tss_entry->ES = tss_entry->FS = tss_entry->GS = 0x13;
 }
 
 int GDT_init() {
+    return GDT_init_cpu(BSP_INDEX, (uint32_t)&_kernel_stack_top - 1);
+}
+
+int GDT_init_cpu(uint32_t cpu_index, uint32_t kernel_stack_top) {
+    GDT_entry_t *gdt_entries = gdt_entries_per_cpu[cpu_index];
+    GDT_descriptor_t *gdt_desc = &gdt_descs[cpu_index];
+
     // clear up all six GDT entries (the very first one is required to be NULL,
     // so it's done at this line as well)
     memset(reinterpret_cast<char *>(&gdt_entries[0]), 0, GDT_ENTRY_COUNT * sizeof(GDT_entry_t));
@@ -97,17 +107,22 @@ int GDT_init() {
     gdt_entries[GDT_USERSPACE_DATA_INDEX].SZ    = 1; // 32 bit protected mode
 
     // Init the Task State Segment
-    TSS_init();
+    TSS_init(gdt_entries, &tss_entries[cpu_index], kernel_stack_top);
 
     // the the information about the start addr
     // of the GDT table as well as its size
-    gdt_desc.size       = sizeof(gdt_entries);
-    gdt_desc.start_addr = reinterpret_cast<uint32_t>(&gdt_entries[0]);
+    gdt_desc->size       = GDT_ENTRY_COUNT * sizeof(GDT_entry_t);
+    gdt_desc->start_addr = reinterpret_cast<uint32_t>(&gdt_entries[0]);
 
     // load the global descriptor table into the CPU
-    _load_gdt(reinterpret_cast<uint32_t>(&gdt_desc));
+    _load_gdt(reinterpret_cast<uint32_t>(gdt_desc));
 
     _tss_flush(TSS_SEG | RING_3); // TSS seg, flushed
 
     return 0; // everything went well
-}
\ No newline at end of file
+}
+
+void TSS_set_kernel_stack(uint32_t cpu_index, uint32_t kernel_stack_top) {
+    // the stack the CPU switches to when going from ring 3 to ring 0
+    tss_entries[cpu_index].ESP0 = kernel_stack_top;
+}
@@ -1,11 +1,18 @@
 #include <mem/heap.h>
 #include <mem/paging.h>
+#include <smp/smp.h>
+#include <common.h>
+#include <memory.h>
 
 static heap_t kernel_heap;
 
+// serializes growing and shrinking of the kernel heap (mapping and unmapping its pages)
+static volatile uint32_t kernel_heap_resize_lock;
+
 void heap_init(heap_t *heap, uint32_t addr, uint32_t size) {
     heap->addr = addr;
     heap->size = size;
+    spinlock_init(&heap->lock);
 
     // init the very first block which is free and takes
     // up the entire size of the heap; once malloc() is called
@@ -19,6 +26,7 @@ void heap_init(heap_t *heap, uint32_t addr, uint32_t size) {
 
 uint32_t get_kernel_heap_size() {
     uint32_t size = 0;
+    spinlock_acquire(&kernel_heap.lock);
     heap_block_t *block = reinterpret_cast<heap_block_t *>(kernel_heap.addr);
     while (block != NULL) {
         if(block->free == 1){
@@ -26,15 +34,87 @@ uint32_t get_kernel_heap_size() {
         }
         block = block->next;
     }
+    spinlock_release(&kernel_heap.lock);
     return size;
 }
 
+static void split_block(heap_block_t *block, uint32_t actual_size_needed) {
+    uint32_t block_addr = reinterpret_cast<uint32_t>(block);
+
+    // check if there's enough room for another block
+    // after we break this one apart (there must be heap_block_t
+    // and at least one byte after that, hence '>' and not '>=')
+    if (block->size > actual_size_needed + sizeof(heap_block_t)) {
+        heap_block_t *new_block = reinterpret_cast<heap_block_t *>(block_addr + actual_size_needed);
+        new_block->free = 1;
+        new_block->next = block->next;
+        new_block->size = block->size - actual_size_needed;
+
+        block->next = new_block;
+        block->size = actual_size_needed;
+    }
+}
+
+static heap_block_t *get_last_block(heap_t *heap) {
+    heap_block_t *block = reinterpret_cast<heap_block_t *>(heap->addr);
+    while (block->next != NULL) {
+        // merge the free blocks along the way, so the free end of the heap is a single block
+        if (block->free == 1 && block->next->free == 1) {
+            block->size += block->next->size;
+            block->next = block->next->next;
+            continue;
+        }
+        block = block->next;
+    }
+    return block;
+}
+
+void heap_grow(heap_t *heap, uint32_t size) {
+    // the memory right after the heap must be already mapped by the caller
+    spinlock_acquire(&heap->lock);
+    heap_block_t *last = get_last_block(heap);
+    if (last->free == 1) {
+        last->size += size;
+    } else {
+        heap_block_t *block = reinterpret_cast<heap_block_t *>(heap->addr + heap->size);
+        block->size = size;
+        block->next = NULL;
+        block->free = 1;
+        last->next = block;
+    }
+    heap->size += size;
+    spinlock_release(&heap->lock);
+}
+
+uint32_t heap_shrink(heap_t *heap, uint32_t min_size, uint32_t threshold) {
+    // cut off the free end of the heap (page-aligned); returns by how
+    // many bytes the heap has shrunk, the caller may unmap them then
+    uint32_t released = 0;
+    spinlock_acquire(&heap->lock);
+    heap_block_t *last = get_last_block(heap);
+    if (last->free == 1) {
+        uint32_t last_addr = reinterpret_cast<uint32_t>(last);
+        uint32_t new_size = ((last_addr + sizeof(heap_block_t) + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1)) - heap->addr;
+        if (new_size < min_size)
+            new_size = min_size;
+        if (new_size < heap->size && heap->size - new_size >= threshold) {
+            released = heap->size - new_size;
+            last->size -= released;
+            heap->size = new_size;
+        }
+    }
+    spinlock_release(&heap->lock);
+    return released;
+}
+
 void *heap_malloc(heap_t *heap, uint32_t size) {
     heap_block_t *block = reinterpret_cast<heap_block_t *>(heap->addr);
 
     // we need to store the header of the block as well
     uint32_t actual_size_needed = size + sizeof(heap_block_t);
 
+    spinlock_acquire(&heap->lock);
+
     // iterate through the chain of blocks until
     // you find one that has a suitable size
     while (block != NULL) {
@@ -46,26 +126,15 @@ void *heap_malloc(heap_t *heap, uint32_t size) {
         }
         // check if the block is big enough
         if (block->free == 1 && block->size >= actual_size_needed) {
-            uint32_t block_addr = reinterpret_cast<uint32_t>(block);
-
-            // check if there's enough room for another block
-            // after we break this one apart (there must be heap_block_t
-            // and at least one byte after that, hence '>' and not '>=')
-            if (block->size > actual_size_needed + sizeof(heap_block_t)) {
-                heap_block_t *new_block = reinterpret_cast<heap_block_t *>(block_addr + actual_size_needed);
-                new_block->free = 1;
-                new_block->next = block->next;
-                new_block->size = block->size - actual_size_needed;
-
-                block->next = new_block;
-                block->size = actual_size_needed;
-            }
+            split_block(block, actual_size_needed);
             block->free = 0;
-            return reinterpret_cast<void *>(block_addr + sizeof(heap_block_t));
+            spinlock_release(&heap->lock);
+            return reinterpret_cast<void *>(reinterpret_cast<uint32_t>(block) + sizeof(heap_block_t));
         }
         // move on to the next block
         block = block->next;
     }
+    spinlock_release(&heap->lock);
     return NULL; // no memory left :(
 }
 
@@ -77,18 +146,123 @@ void heap_free(heap_t *heap, void *ptr) {
     }
     // mark the block as free
     heap_block_t *block = reinterpret_cast<heap_block_t *>(addr - sizeof(heap_block_t));
+    spinlock_acquire(&heap->lock);
     block->free = 1;
+    spinlock_release(&heap->lock);
+}
+
+void *heap_realloc(heap_t *heap, void *ptr, uint32_t size) {
+    if (ptr == NULL)
+        return heap_malloc(heap, size);
+    if (size == 0) {
+        heap_free(heap, ptr);
+        return NULL;
+    }
+    heap_block_t *block = reinterpret_cast<heap_block_t *>(reinterpret_cast<uint32_t>(ptr) - sizeof(heap_block_t));
+    uint32_t actual_size_needed = size + sizeof(heap_block_t);
+
+    // the blocks are laid out one after another, so the block can grow
+    // in place by swallowing the free blocks which follow it
+    spinlock_acquire(&heap->lock);
+    while (block->size < actual_size_needed && block->next != NULL && block->next->free == 1) {
+        block->size += block->next->size;
+        block->next = block->next->next;
+    }
+    if (block->size >= actual_size_needed) {
+        split_block(block, actual_size_needed);
+        spinlock_release(&heap->lock);
+        return ptr;
+    }
+    uint32_t old_size = block->size - sizeof(heap_block_t);
+    spinlock_release(&heap->lock);
+
+    // otherwise, the data has to be moved somewhere else
+    void *new_ptr = heap_malloc(heap, size);
+    if (new_ptr == NULL)
+        return NULL;
+    memcpy(new_ptr, ptr, old_size);
+    heap_free(heap, ptr);
+    return new_ptr;
 }
 
 int kernel_heap_init() {
-    heap_init(&kernel_heap, KERNEL_HEAP_START_ADDR, KERNEL_HEAP_SIZE);
+    heap_init(&kernel_heap, KERNEL_HEAP_START_ADDR, KERNEL_HEAP_INITIAL_SIZE);
+    kernel_heap_resize_lock = 0;
+    return 0;
+}
+
+static void lock_kernel_heap_resize() {
+    // whoever holds the lock may be waiting for the other CPUs
+    // to flush their TLBs, so keep handling our own requests meanwhile
+    while (atomic_xchg(&kernel_heap_resize_lock, 1) != 0) {
+        SMP_handle_tlb_flush();
+        _pause();
+    }
+}
+
+static uint8_t grow_kernel_heap(uint32_t size) {
+    // the new block needs its header as well (and the last block may not be free)
+    uint32_t grow_by = (size + sizeof(heap_block_t) + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1);
+    if (grow_by < KERNEL_HEAP_GROW_SIZE)
+        grow_by = KERNEL_HEAP_GROW_SIZE;
+
+    lock_kernel_heap_resize();
+    if (kernel_heap.size + grow_by > KERNEL_HEAP_MAX_SIZE)
+        grow_by = KERNEL_HEAP_MAX_SIZE - kernel_heap.size;
+    if (grow_by == 0 || map_kernel_heap_pages(kernel_heap.addr + kernel_heap.size, grow_by / FRAME_SIZE) != 0) {
+        kernel_heap_resize_lock = 0;
+        return 1;
+    }
+    heap_grow(&kernel_heap, grow_by);
+    kernel_heap_resize_lock = 0;
     return 0;
 }
 
+void kernel_heap_trim() {
+    // nothing to give back (checked without the lock, it's just a hint)
+    if (kernel_heap.size < KERNEL_HEAP_INITIAL_SIZE + KERNEL_HEAP_TRIM_SIZE)
+        return;
+
+    // don't wait if the heap is being resized by someone else
+    if (atomic_xchg(&kernel_heap_resize_lock, 1) != 0)
+        return;
+    uint32_t released = heap_shrink(&kernel_heap, KERNEL_HEAP_INITIAL_SIZE, KERNEL_HEAP_TRIM_SIZE);
+    if (released != 0)
+        unmap_kernel_heap_pages(kernel_heap.addr + kernel_heap.size, released / FRAME_SIZE);
+    kernel_heap_resize_lock = 0;
+}
+
+uint32_t get_kernel_heap_mapped_size() {
+    return kernel_heap.size;
+}
+
 void *kmalloc(uint32_t size) {
-    return heap_malloc(&kernel_heap, size);
+    // grow the heap until the block fits in (or there's no memory left)
+    void *ptr = heap_malloc(&kernel_heap, size);
+    while (ptr == NULL && grow_kernel_heap(size) == 0)
+        ptr = heap_malloc(&kernel_heap, size);
+    return ptr;
 }
 
 void kfree(void *ptr) {
     heap_free(&kernel_heap, ptr);
+}
+
+void *krealloc(void *ptr, uint32_t size) {
+    if (ptr == NULL)
+        return kmalloc(size);
+    void *new_ptr = heap_realloc(&kernel_heap, ptr, size);
+    if (new_ptr == NULL && size != 0 && grow_kernel_heap(size) == 0)
+        new_ptr = heap_realloc(&kernel_heap, ptr, size);
+    return new_ptr;
+}
+
+void *kcalloc(uint32_t count, uint32_t size) {
+    // make sure count * size does not overflow
+    if (size != 0 && count > 0xFFFFFFFF / size)
+        return NULL;
+    void *ptr = kmalloc(count * size);
+    if (ptr != NULL)
+        memset(ptr, 0, count * size);
+    return ptr;
 }
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include <mem/paging.h>
 #include <common.h>
 #include <memory.h>
+#include <math.h>
 #include <drivers/screen/screen.h>
+#include <spinlock.h>
+#include <smp/smp.h>
 
 // restore the page directory from the memory
 page_dir_t *kernel_page_dir = reinterpret_cast<page_dir_t *>(PAGE_DIR_ADDR);
@@ -18,10 +21,21 @@ extern uint32_t physical_mem_size; // how much RAM we gave to the VM
 
 uint32_t last_page_table_addr;
 
+// size of the region of the file system (based on the size of the RAM)
+static uint32_t fs_size;
+
+// protects the bitmap of frames as well as the kernel page directory
+// (the public functions lock it and call their do_* counterparts)
+static spinlock_t paging_lock;
+
 static void map_kernel_heap();
 static void map_filesystem();
+static uint32_t do_allocate_frame();
+static void do_frame_set_state(uint32_t frame_index, uint32_t occupied);
+static uint32_t do_allocate_page_table(uint32_t page_table_index, uint8_t user);
+static uint32_t do_allocate_page(uint32_t page_table_index, uint32_t page_index, uint8_t user);
 
-uint32_t get_number_of_free_frames() {
+static uint32_t do_get_number_of_free_frames() {
     uint32_t free_frames = 0;
     uint32_t i, j;
     for (i = 0; i < frames_bitmap_size; i++) {
@@ -32,11 +46,19 @@ uint32_t get_number_of_free_frames() {
     return free_frames;
 }
 
+uint32_t get_number_of_free_frames() {
+    spinlock_acquire(&paging_lock);
+    uint32_t free_frames = do_get_number_of_free_frames();
+    spinlock_release(&paging_lock);
+    return free_frames;
+}
+
 int paging_init() {
     // clear out the bitmap and calculate the actual number of frames
     // based on the physical mem - the size of the kernel
     // (+1 so we're page-aligned)
     memset(frames, 0, FRAMES_COUNT * sizeof(uint32_t));
+    spinlock_init(&paging_lock);
 
     // calculate the number of physical frames
     physical_frames = physical_mem_size / FRAME_SIZE - (kernel_size / FRAME_SIZE);
@@ -80,30 +102,94 @@ int paging_init() {
     return 0;
 }
 
+uint32_t get_fs_size() {
+    return fs_size;
+}
+
 static void map_filesystem() {
+    // the region is made up of whole page tables, so there's
+    // nothing left for the processes to copy once it's been mapped
+    fs_size = (physical_mem_size / FS_RAM_SHARE) & ~(PAGE_TABLE_ENTRIES * FRAME_SIZE - 1);
+    fs_size = max(FS_MIN_SIZE, min(fs_size, FS_MAX_SIZE));
+
     uint32_t i, j;
-    for (i = FS_START_PAGE; i <= FS_END_PAGE; i++) {
-        allocate_page_table(i, 1);
+    for (i = FS_START_PAGE; i < FS_START_PAGE + fs_size / (PAGE_TABLE_ENTRIES * FRAME_SIZE); i++) {
+        do_allocate_page_table(i, 1);
         for (j = 0; j < PAGE_TABLE_ENTRIES; j++) {
-            allocate_page(i, j, 1);
+            do_allocate_page(i, j, 1);
         }
     }
 }
 
 static void map_kernel_heap() {
-    // go through the appropriate page tables
-    // and in each step - allocate a new page table and also,
-    // allocate all its pages as well
-    uint32_t i, j;
+    // allocate all the page tables of the heap up front, so their entries
+    // in the page dir never change and all the processes (which copy them
+    // in allocate_page_dir()) see the heap grow and shrink; only the first
+    // few pages are backed by frames, the rest gets mapped once it's needed
+    uint32_t i;
     for (i = KERNEL_HEAP_START_PAGE; i <= KERNEL_HEAP_END_PAGE; i++) {
-        allocate_page_table(i, 1);
-        for (j = 0; j < PAGE_TABLE_ENTRIES; j++) {
-            allocate_page(i, j, 1);
-        }
+        do_allocate_page_table(i, 1);
+    }
+    for (i = 0; i < KERNEL_HEAP_INITIAL_SIZE / FRAME_SIZE; i++) {
+        do_allocate_page(KERNEL_HEAP_START_PAGE + i / PAGE_TABLE_ENTRIES, i % PAGE_TABLE_ENTRIES, 1);
+    }
+}
+
+int map_kernel_heap_pages(uint32_t virtual_addr, uint32_t count) {
+    uint32_t i;
+    spinlock_acquire(&paging_lock);
+
+    // the heap must not take up the last frames, allocate_frame() would panic
+    if (do_get_number_of_free_frames() <= count) {
+        spinlock_release(&paging_lock);
+        return 1;
+    }
+    for (i = 0; i < count; i++) {
+        do_allocate_page(virtual_addr >> 22, (virtual_addr >> 12) & 0x3FF, 1);
+        virtual_addr += FRAME_SIZE;
+    }
+    spinlock_release(&paging_lock);
+    return 0;
+}
+
+static page_table_entry_t *get_kernel_page(uint32_t virtual_addr) {
+    page_table_t *page_table = (page_table_t *)(kernel_page_dir->page_tables[virtual_addr >> 22].page_table_addr << 12);
+    return &page_table->pages[(virtual_addr >> 12) & 0x3FF];
+}
+
+void unmap_kernel_heap_pages(uint32_t virtual_addr, uint32_t count) {
+    uint32_t i;
+
+    // first, mark the pages as not present (the frames stay in the entries for now)
+    spinlock_acquire(&paging_lock);
+    for (i = 0; i < count; i++) {
+        get_kernel_page(virtual_addr + i * FRAME_SIZE)->present = 0;
+        _flush_tlb(virtual_addr + i * FRAME_SIZE);
+    }
+    spinlock_release(&paging_lock);
+
+    // the heap is part of every address space, so all the other CPUs
+    // must drop the old mappings before the frames can be reused
+    SMP_flush_tlb(SMP_ALL_ADDRESS_SPACES, virtual_addr);
+
+    spinlock_acquire(&paging_lock);
+    for (i = 0; i < count; i++) {
+        page_table_entry_t *page = get_kernel_page(virtual_addr + i * FRAME_SIZE);
+        do_frame_set_state(page->physical_page_addr, 0);
+        memset(page, 0, sizeof(page_table_entry_t));
+        page->physical_page_addr = 0xFFFFF;
     }
+    spinlock_release(&paging_lock);
 }
 
 uint32_t allocate_frame() {
+    spinlock_acquire(&paging_lock);
+    uint32_t frame_number = do_allocate_frame();
+    spinlock_release(&paging_lock);
+    return frame_number;
+}
+
+static uint32_t do_allocate_frame() {
     uint32_t i, j;
     uint32_t frame_number;
 
@@ -115,7 +201,7 @@ uint32_t allocate_frame() {
             for (j = 0; j < 32; j++)
                 if (((frames[i] >> j) & 1) == 0) {
                     frame_number = i * 32 + j;
-                    frame_set_state(frame_number, 1);
+                    do_frame_set_state(frame_number, 1);
                     return frame_number;
                 }
         }
@@ -128,6 +214,12 @@ uint32_t allocate_frame() {
 }
 
 void frame_set_state(uint32_t frame_index, uint32_t occupied) {
+    spinlock_acquire(&paging_lock);
+    do_frame_set_state(frame_index, occupied);
+    spinlock_release(&paging_lock);
+}
+
+static void do_frame_set_state(uint32_t frame_index, uint32_t occupied) {
     // set the state of a frame (flip the appropriate bit
     // according to its new state - occupied/occupied)
     uint32_t byte_num = frame_index / 32;
@@ -141,6 +233,13 @@ void frame_set_state(uint32_t frame_index, uint32_t occupied) {
 }
 
 uint32_t allocate_page_table(uint32_t page_table_index, uint8_t user) {
+    spinlock_acquire(&paging_lock);
+    uint32_t page_table_addr = do_allocate_page_table(page_table_index, user);
+    spinlock_release(&paging_lock);
+    return page_table_addr;
+}
+
+static uint32_t do_allocate_page_table(uint32_t page_table_index, uint8_t user) {
     // make sure the page table has indeed not been allocated yet
     if (kernel_page_dir->page_tables[page_table_index].page_table_addr != 0xFFFFF)
         return kernel_page_dir->page_tables[page_table_index].page_table_addr << 12;
@@ -173,14 +272,21 @@ uint32_t allocate_page_table(uint32_t page_table_index, uint8_t user) {
 }
 
 uint32_t allocate_page(uint32_t page_table_index, uint32_t page_index, uint8_t user) {
+    spinlock_acquire(&paging_lock);
+    uint32_t page_addr = do_allocate_page(page_table_index, page_index, user);
+    spinlock_release(&paging_lock);
+    return page_addr;
+}
+
+static uint32_t do_allocate_page(uint32_t page_table_index, uint32_t page_index, uint8_t user) {
     // allocate a free frame and calculate the address
     // of the frame based on the frame index
-    uint32_t frame_index = allocate_frame();
+    uint32_t frame_index = do_allocate_frame();
     uint32_t frame_addr = frame_index * FRAME_SIZE;
 
     // make sure the page table has been allocated
     if (kernel_page_dir->page_tables[page_table_index].page_table_addr == 0xFFFFF)
-        allocate_page_table(page_table_index, user);
+        do_allocate_page_table(page_table_index, user);
 
     // load the page table from the memory using the page table directory
     // (it holds the page table address as we set it up in allocate_page_table())
@@ -207,6 +313,9 @@ uint32_t allocate_page(uint32_t page_table_index, uint32_t page_index, uint8_t u
 uint32_t allocate_page(uint32_t user) {
     uint32_t i, j;
     page_table_t *page_table;
+    uint32_t page_addr;
+
+    spinlock_acquire(&paging_lock);
 
     // iterate through the page directory and look for
     // a page table which has already been mapped
@@ -223,14 +332,18 @@ uint32_t allocate_page(uint32_t user) {
             // corresponding virtual address
             for (j = 0; j < PAGE_TABLE_ENTRIES; j++) {
                 if (page_table->pages[j].physical_page_addr == 0xFFFFF) {
-                    return allocate_page(i, j, user);
+                    page_addr = do_allocate_page(i, j, user);
+                    spinlock_release(&paging_lock);
+                    return page_addr;
                 }
             }
         } else {
             // if the current page table has not been mapped yet,
             // map it and also map the very first page in that table
-            allocate_page_table(i, user);
-            return allocate_page(i, 0, user);
+            do_allocate_page_table(i, user);
+            page_addr = do_allocate_page(i, 0, user);
+            spinlock_release(&paging_lock);
+            return page_addr;
         }
     }
     set_color(FOREGROUND_RED);
@@ -245,17 +358,21 @@ void unmap_page(uint32_t virtual_addr) {
     uint32_t page_table_index = virtual_addr >> 22;
     uint32_t page_index = (virtual_addr >> 12) & 0x3FF;
 
+    spinlock_acquire(&paging_lock);
+
     // load the corresponding page table from the memory
     page_table_t *page_table = (page_table_t *) (kernel_page_dir->page_tables[page_table_index].page_table_addr << 12);
 
     // make sure the page has indeed been mapped
-    if (page_table->pages[page_index].physical_page_addr == 0xFFFFF)
+    if (page_table->pages[page_index].physical_page_addr == 0xFFFFF) {
+        spinlock_release(&paging_lock);
         return;
+    }
 
     // set the frame which the page was mapped to as free
     uint32_t frame_addr = page_table->pages[page_index].physical_page_addr << 12;
     uint32_t frame_index = frame_addr / FRAME_SIZE;
-    frame_set_state(frame_index, 0);
+    do_frame_set_state(frame_index, 0);
 
     // clear out the page entry and set the address to the default (unused) value
     memset(&page_table->pages[page_index], 0, sizeof(page_table_entry_t));
@@ -263,4 +380,41 @@ void unmap_page(uint32_t virtual_addr) {
 
     // we should also flush the TLB so the change takes place
     _flush_tlb(virtual_addr);
-}
\ No newline at end of file
+    spinlock_release(&paging_lock);
+}
+
+void detach_page(uint32_t virtual_addr) {
+    // unmap the page from the kernel's virtual address space;
+    // unlike unmap_page(), the frame remains occupied (e.g. it's been handed over to a process)
+    uint32_t page_table_index = virtual_addr >> 22;
+    uint32_t page_index = (virtual_addr >> 12) & 0x3FF;
+
+    spinlock_acquire(&paging_lock);
+    page_table_t *page_table = (page_table_t *)(kernel_page_dir->page_tables[page_table_index].page_table_addr << 12);
+    memset(&page_table->pages[page_index], 0, sizeof(page_table_entry_t));
+    page_table->pages[page_index].physical_page_addr = 0xFFFFF;
+    _flush_tlb(virtual_addr);
+    spinlock_release(&paging_lock);
+}
+
+void map_mmio_page(uint32_t virtual_addr, uint32_t physical_addr) {
+    // the page table 768 is shared by all address spaces, so the device
+    // registers will be accessible no matter what process is currently running
+    page_table_t *page_table = reinterpret_cast<page_table_t *>(PAGE_TABLE_768_ADDR);
+    uint32_t page_index = (virtual_addr >> 12) & 0x3FF;
+
+    page_table->pages[page_index].physical_page_addr = (physical_addr & 0xFFFFF000) >> 12;
+    page_table->pages[page_index].read_write = 1;
+    page_table->pages[page_index].user_mode = 0;
+    page_table->pages[page_index].cache_disabled = 1;
+    page_table->pages[page_index].write_through = 1;
+    page_table->pages[page_index].present = 1;
+    _flush_tlb(virtual_addr);
+}
+
+uint32_t get_physical_addr(uint32_t virtual_addr) {
+    // only works for addresses mapped within the kernel page dir
+    // (its page tables are accessible no matter what page dir is loaded)
+    page_table_t *page_table = (page_table_t *)(kernel_page_dir->page_tables[virtual_addr >> 22].page_table_addr << 12);
+    return (page_table->pages[(virtual_addr >> 12) & 0x3FF].physical_page_addr << 12) | (virtual_addr & 0xFFF);
+}
@@ -0,0 +1,54 @@
+#include <mem/scratch.h>
+#include <mem/heap.h>
+#include <smp/smp.h>
+
+#define SCRATCH_ALIGNMENT 16
+
+int scratch_init(scratch_arena_t *arena) {
+    arena->memory = (uint8_t *)kmalloc(SCRATCH_SIZE);
+    arena->top = 0;
+    arena->fallback_count = 0;
+    return arena->memory == NULL;
+}
+
+scratch_mark_t scratch_begin() {
+    cpu_t *cpu = get_cpu();
+    scratch_mark_t mark = { cpu->scratch.top, cpu->scratch.fallback_count };
+
+    // another process running on this CPU would get the same memory
+    cpu->preempt_count++;
+    return mark;
+}
+
+void *scratch_alloc(uint32_t size) {
+    scratch_arena_t *arena = &get_cpu()->scratch;
+    size = (size + SCRATCH_ALIGNMENT - 1) & ~(SCRATCH_ALIGNMENT - 1);
+    if (arena->memory != NULL && size <= SCRATCH_SIZE - arena->top) {
+        void *ptr = &arena->memory[arena->top];
+        arena->top += size;
+        return ptr;
+    }
+    if (arena->fallback_count == SCRATCH_MAX_FALLBACKS)
+        return NULL;
+    void *ptr = kmalloc(size);
+    if (ptr != NULL)
+        arena->fallbacks[arena->fallback_count++] = ptr;
+    return ptr;
+}
+
+static void release(scratch_arena_t *arena, uint32_t top, uint32_t fallback_count) {
+    while (arena->fallback_count > fallback_count)
+        kfree(arena->fallbacks[--arena->fallback_count]);
+    arena->top = top;
+}
+
+void scratch_end(scratch_mark_t mark) {
+    cpu_t *cpu = get_cpu();
+    release(&cpu->scratch, mark.top, mark.fallback_count);
+    cpu->preempt_count--;
+}
+
+void scratch_reset() {
+    // whatever has been left behind can go now
+    release(&get_cpu()->scratch, 0, 0);
+}
@@ -24,4 +24,46 @@ _switch_task:
     mov eax, [ebp + 0]
     mov ebp, [ebp + 20]
 
-    iret
\ No newline at end of file
+    iret
+
+; Moves onto another stack (the kernel stack of the current CPU)
+; and calls the given function, which never returns.
+; void _switch_stack_and_call(uint32_t stack_top, void (*fce)())
+[global _switch_stack_and_call]
+_switch_stack_and_call:
+    mov eax, [esp + 8]      ; function to call
+    mov esp, [esp + 4]      ; the old stack is abandoned from now on
+    call eax
+.hang:
+    jmp .hang
+
+; Saves the kernel context of the current process onto its
+; kernel stack, stores the stack pointer into *esp_slot, moves onto
+; the kernel stack of the CPU and calls the given function. It "returns"
+; once the context has been resumed by _resume_kernel_context.
+; void _yield_kernel_context(uint32_t *esp_slot, uint32_t stack_top, void (*fce)())
+[global _yield_kernel_context]
+_yield_kernel_context:
+    push ebp
+    push ebx
+    push esi
+    push edi
+    mov eax, [esp + 20]     ; esp_slot
+    mov ecx, [esp + 24]     ; stack_top
+    mov edx, [esp + 28]     ; fce
+    mov [eax], esp
+    mov esp, ecx
+    call edx
+.hang:
+    jmp .hang
+
+; Resumes the kernel context saved by _yield_kernel_context.
+; void _resume_kernel_context(uint32_t esp)
+[global _resume_kernel_context]
+_resume_kernel_context:
+    mov esp, [esp + 4]
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
@@ -55,13 +55,13 @@ static void allocate_segment(uint32_t start_virt_addr, uint32_t end_virt_addr, l
         *page_table_index_storage = i;
 
         if (list_contains(page_table_indexes, page_table_index_storage, page_table_indexes_cmp) == 1) {
-            code_page_table = (page_table_t *) list_get(pcb->page_tables, pcb->page_tables->size - 1);
+            code_page_table = (page_table_t *) list_get(pcb->process->page_tables, pcb->process->page_tables->size - 1);
             kfree(page_table_index_storage);
         } else {
             page_table_virt_addr = allocate_page(1);
             code_page_table = (page_table_t *) page_table_virt_addr;
 
-            list_add_last(pcb->page_tables, code_page_table);
+            list_add_last(pcb->process->page_tables, code_page_table);
 
             for (j = 0; j < PAGE_TABLE_ENTRIES; j++) {
                 memset(&code_page_table->pages[j], 0, sizeof(page_table_entry_t));
@@ -75,10 +75,10 @@ static void allocate_segment(uint32_t start_virt_addr, uint32_t end_virt_addr, l
             page_table = (page_table_t *) (kernel_page_dir->page_tables[page_table_index].page_table_addr << 12);
             page_table_phys_addr = page_table->pages[page_index].physical_page_addr << 12;
 
-            pcb->page_dir_kernel_mapping->page_tables[i].page_table_addr = (page_table_phys_addr & 0xFFFFF000) >> 12;
-            pcb->page_dir_kernel_mapping->page_tables[i].read_write = 1;
-            pcb->page_dir_kernel_mapping->page_tables[i].user_mode = 1;
-            pcb->page_dir_kernel_mapping->page_tables[i].present = 1;
+            pcb->process->page_dir_kernel_mapping->page_tables[i].page_table_addr = (page_table_phys_addr & 0xFFFFF000) >> 12;
+            pcb->process->page_dir_kernel_mapping->page_tables[i].read_write = 1;
+            pcb->process->page_dir_kernel_mapping->page_tables[i].user_mode = 1;
+            pcb->process->page_dir_kernel_mapping->page_tables[i].present = 1;
         }
 
         for (j = (i == page_table_start ? page_start : 0); j <= (i == page_table_end ? page_end : (PAGE_TABLE_ENTRIES - 1)); j++) {
@@ -116,11 +116,7 @@ static void allocate_segment(uint32_t start_virt_addr, uint32_t end_virt_addr, l
 
         // unmap the page from the kernel's virtual address space
         // the frame remains occupied so the process can use it within its own address space
-        page_table_index = page_virt_addr >> 22;
-        page_index = (page_virt_addr >> 12) & 0x3FF;
-        page_table = (page_table_t *)(kernel_page_dir->page_tables[page_table_index].page_table_addr << 12);
-        memset(&page_table->pages[page_index], 0, sizeof(page_table_entry_t));
-        page_table->pages[page_index].physical_page_addr = 0xFFFFF;
+        detach_page(page_virt_addr);
     }
 
     page_virt_addr = *(uint32_t *)list_get(data_pages, 0);
@@ -130,11 +126,7 @@ static void allocate_segment(uint32_t start_virt_addr, uint32_t end_virt_addr, l
     // unmap the page from the kernel's virtual address space
     // the frame remains occupied so the process can use it within its own address space
     _load_page_dir(PAGE_DIR_ADDR);
-    page_table_index = page_virt_addr >> 22;
-    page_index = (page_virt_addr >> 12) & 0x3FF;
-    page_table = (page_table_t *)(kernel_page_dir->page_tables[page_table_index].page_table_addr << 12);
-    memset(&page_table->pages[page_index], 0, sizeof(page_table_entry_t));
-    page_table->pages[page_index].physical_page_addr = 0xFFFFF;
+    detach_page(page_virt_addr);
 
     list_free(&data_pages, NULL);
 }
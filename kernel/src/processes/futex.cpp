@@ -0,0 +1,104 @@
+#include <processes/futex.h>
+#include <processes/scheduler.h>
+
+static futex_bucket_t buckets[FUTEX_HASH_SIZE];
+
+static futex_bucket_t *get_bucket(uint32_t key) {
+    // the keys are physical addresses of 4B words, so the lowest two bits carry no information
+    // (multiplicative hashing - the top bits of the product depend on all bits of the key)
+    return &buckets[((key >> 2) * 2654435761u) >> (32 - FUTEX_HASH_BITS)];
+}
+
+int futex_init() {
+    uint32_t i;
+    for (i = 0; i < FUTEX_HASH_SIZE; i++) {
+        spinlock_init(&buckets[i].lock);
+        buckets[i].first = NULL;
+        buckets[i].last = NULL;
+    }
+    return 0;
+}
+
+static void remove_waiter(futex_bucket_t *bucket, futex_node_t *node) {
+    if (node->prev != NULL)
+        node->prev->next = node->next;
+    else
+        bucket->first = node->next;
+    if (node->next != NULL)
+        node->next->prev = node->prev;
+    else
+        bucket->last = node->prev;
+}
+
+uint8_t futex_block(PCB_t *pcb, uint32_t key, volatile uint32_t *addr, uint32_t expected) {
+    futex_bucket_t *bucket = get_bucket(key);
+    spinlock_acquire(&bucket->lock);
+
+    // the value is checked under the lock futex_wake_up() takes as well, so if the
+    // thread changing it has not woken anybody up yet, it will find us in the queue
+    if (*addr != expected) {
+        spinlock_release(&bucket->lock);
+        return 1;
+    }
+    pcb->futex_key = key;
+    pcb->futex_node.next = NULL;
+    pcb->futex_node.prev = bucket->last;
+    if (bucket->last != NULL)
+        bucket->last->next = &pcb->futex_node;
+    else
+        bucket->first = &pcb->futex_node;
+    bucket->last = &pcb->futex_node;
+
+    // kill_process() sets the flag under the process lock and looks for the thread
+    // in the queue right after, so either it finds us here or we see the flag
+    __sync_synchronize();
+    if (pcb->pending_kill) {
+        remove_waiter(bucket, &pcb->futex_node);
+        pcb->futex_key = 0;
+        spinlock_release(&bucket->lock);
+        return 1;
+    }
+    pcb->state = PROCESS_STATE_WAITING;
+    spinlock_release(&bucket->lock);
+    return 0;
+}
+
+uint32_t futex_wake_up(uint32_t key, uint32_t count) {
+    futex_bucket_t *bucket = get_bucket(key);
+    uint32_t woken = 0;
+    spinlock_acquire(&bucket->lock);
+
+    // wake up the threads in the order they started waiting
+    futex_node_t *curr = bucket->first;
+    futex_node_t *next;
+    for (; curr != NULL && woken < count; curr = next) {
+        next = curr->next;
+        PCB_t *pcb = (PCB_t *)curr->pcb;
+        if (pcb->futex_key != key)
+            continue;
+        remove_waiter(bucket, curr);
+        pcb->futex_key = 0;
+        set_process_as_ready(pcb);
+        woken++;
+    }
+    spinlock_release(&bucket->lock);
+    return woken;
+}
+
+uint8_t futex_cancel(PCB_t *pcb) {
+    uint32_t key = pcb->futex_key;
+    if (key == 0)
+        return 0;
+
+    // the thread may have been woken up in the meantime
+    futex_bucket_t *bucket = get_bucket(key);
+    uint8_t removed = 0;
+    spinlock_acquire(&bucket->lock);
+    if (pcb->futex_key == key) {
+        remove_waiter(bucket, &pcb->futex_node);
+        pcb->futex_key = 0;
+        removed = 1;
+    }
+    spinlock_release(&bucket->lock);
+    return removed;
+}
@@ -119,9 +119,9 @@ void list_remove(list_t *list, uint32_t index, void(*remove_elem_func)(void *))
     list->size--;
 }
 
-void list_remove_data(list_t *list, void *data, void(*remove_elem_func)(void *)) {
+uint8_t list_remove_data(list_t *list, void *data, void(*remove_elem_func)(void *)) {
     if (list == NULL)
-        return;
+        return 0;
 
     uint32_t index = 0;
     list_node_t *curr = list->first;
@@ -129,11 +129,12 @@ void list_remove_data(list_t *list, void *data, void(*remove_elem_func)(void *))
     while (curr != NULL) {
         if (curr->data == data) {
             list_remove(list, index, remove_elem_func);
-            return;
+            return 1;
         }
         curr = curr->next;
         index++;
     }
+    return 0;
 }
 
 uint8_t list_contains(list_t *list, void *data, uint8_t(*cmp_fce)(void *x, void *y)) {
@@ -0,0 +1,187 @@
+#include <processes/mq.h>
+#include <processes/scheduler.h>
+#include <mem/heap.h>
+#include <mem/paging.h>
+#include <smp/smp.h>
+#include <common.h>
+#include <memory.h>
+#include <string.h>
+
+static mq_t *queues[MQ_MAX_QUEUES];
+static spinlock_t queues_lock; // protects creating the queues
+
+int mq_init() {
+    memset(queues, 0, sizeof(queues));
+    spinlock_init(&queues_lock);
+    return 0;
+}
+
+uint32_t mq_open(const char *name) {
+    uint32_t i;
+    if (strlen(name) == 0 || strlen(name) >= MQ_NAME_LEN)
+        return MQ_ERROR;
+
+    spinlock_acquire(&queues_lock);
+    for (i = 0; i < MQ_MAX_QUEUES && queues[i] != NULL; i++) {
+        if (strcmp(queues[i]->name, name) == 0) {
+            spinlock_release(&queues_lock);
+            return i;
+        }
+    }
+    // the queue does not exist yet, so create it (all its slots are allocated up front)
+    if (i == MQ_MAX_QUEUES) {
+        spinlock_release(&queues_lock);
+        return MQ_ERROR;
+    }
+    mq_t *mq = (mq_t *)kmalloc(sizeof(mq_t));
+    if (mq == NULL) {
+        spinlock_release(&queues_lock);
+        return MQ_ERROR;
+    }
+    strcpy(mq->name, name);
+    mq->head = 0;
+    mq->count = 0;
+    wait_queue_init(&mq->senders);
+    wait_queue_init(&mq->receivers);
+    spinlock_init(&mq->lock);
+    queues[i] = mq;
+    spinlock_release(&queues_lock);
+    return i;
+}
+
+static mq_t *get_queue(uint32_t id) {
+    // once created, a queue never goes away
+    if (id >= MQ_MAX_QUEUES)
+        return NULL;
+    return queues[id];
+}
+
+static uint32_t take_user_page(process_t *process, uint32_t virtual_addr) {
+    // the sender keeps the page mapped, it just gets a fresh frame behind it
+    // (a heap page that has not been touched yet must get one first)
+    uint32_t new_frame_addr = allocate_frame() * FRAME_SIZE;
+    map_user_heap_page(process, virtual_addr);
+    _load_page_dir(PAGE_DIR_ADDR);
+    uint32_t frame_addr = replace_user_frame(process, virtual_addr, new_frame_addr);
+    _load_page_dir(process->cr3);
+
+    if (frame_addr == 0) {
+        frame_set_state(new_frame_addr / FRAME_SIZE, 0);
+        return 0;
+    }
+    // other threads of the sender must not be able to write into the message anymore
+    SMP_flush_tlb(process->cr3, virtual_addr);
+    memset((void *)virtual_addr, 0, FRAME_SIZE);
+    return frame_addr;
+}
+
+static uint8_t give_user_page(process_t *process, uint32_t virtual_addr, uint32_t frame_addr) {
+    map_user_heap_page(process, virtual_addr);
+    _load_page_dir(PAGE_DIR_ADDR);
+    uint32_t old_frame_addr = replace_user_frame(process, virtual_addr, frame_addr);
+    _load_page_dir(process->cr3);
+
+    // the message gets lost along with the frame
+    if (old_frame_addr == 0) {
+        frame_set_state(frame_addr / FRAME_SIZE, 0);
+        return 1;
+    }
+    // the old frame can be reused only once no CPU can reach it through a stale TLB entry
+    SMP_flush_tlb(process->cr3, virtual_addr);
+    frame_set_state(old_frame_addr / FRAME_SIZE, 0);
+    return 0;
+}
+
+uint8_t mq_send(process_t *process, uint32_t id, char *buffer, uint32_t len) {
+    mq_t *mq = get_queue(id);
+    uint32_t frame_addr = 0;
+    if (mq == NULL)
+        return 1;
+
+    // anything bigger than a slot must be a whole page
+    if (len > MQ_SLOT_SIZE) {
+        if (len != MQ_PAGE_SIZE || (uint32_t)buffer % FRAME_SIZE != 0 || (uint32_t)buffer >= PAGE_TABLE_ADDR(768))
+            return 1;
+        // the TLB shootdown must not be done while holding a lock
+        frame_addr = take_user_page(process, (uint32_t)buffer);
+        if (frame_addr == 0)
+            return 1;
+    }
+
+    // a killed sender gives the frame of its page back
+    spinlock_acquire(&mq->lock);
+    while (mq->count == MQ_CAPACITY) {
+        if (sleep_until_woken(&mq->senders, &mq->lock) != 0) {
+            spinlock_release(&mq->lock);
+            if (frame_addr != 0)
+                frame_set_state(frame_addr / FRAME_SIZE, 0);
+            return 1;
+        }
+    }
+
+    mq_message_t *message = &mq->slots[(mq->head + mq->count) % MQ_CAPACITY];
+    message->len = len;
+    message->frame = frame_addr;
+    if (frame_addr == 0)
+        memcpy(message->data, buffer, len);
+    mq->count++;
+    wake_one(&mq->receivers, 0);
+    spinlock_release(&mq->lock);
+    return 0;
+}
+
+uint32_t mq_receive(process_t *process, uint32_t id, char *buffer, uint32_t max_len) {
+    mq_t *mq = get_queue(id);
+    if (mq == NULL)
+        return MQ_ERROR;
+
+    spinlock_acquire(&mq->lock);
+    while (mq->count == 0) {
+        if (sleep_until_woken(&mq->receivers, &mq->lock) != 0) {
+            spinlock_release(&mq->lock);
+            return MQ_ERROR;
+        }
+    }
+
+    // the message stays in the queue if it does not fit into the buffer
+    // (a page can only be received into a page-aligned buffer)
+    mq_message_t *message = &mq->slots[mq->head];
+    uint8_t fits = message->len <= max_len;
+    if (message->frame != 0)
+        fits &= (uint32_t)buffer % FRAME_SIZE == 0 && (uint32_t)buffer < PAGE_TABLE_ADDR(768);
+    if (!fits) {
+        spinlock_release(&mq->lock);
+        return MQ_ERROR;
+    }
+
+    uint32_t len = message->len;
+    uint32_t frame_addr = message->frame;
+    if (frame_addr == 0)
+        memcpy(buffer, message->data, len);
+    mq->head = (mq->head + 1) % MQ_CAPACITY;
+    mq->count--;
+    wake_one(&mq->senders, 0);
+    spinlock_release(&mq->lock);
+
+    if (frame_addr != 0 && give_user_page(process, (uint32_t)buffer, frame_addr) != 0)
+        return MQ_ERROR;
+    return len;
+}
+
+uint8_t mq_is_ready(uint32_t id) {
+    // i.e. there's a message to be received
+    mq_t *mq = get_queue(id);
+    if (mq == NULL)
+        return 0;
+    spinlock_acquire(&mq->lock);
+    uint8_t ready = mq->count != 0;
+    spinlock_release(&mq->lock);
+    return ready;
+}
+
+wait_queue_t *mq_get_wait_queue(uint32_t id) {
+    mq_t *mq = get_queue(id);
+    if (mq == NULL)
+        return NULL;
+    return &mq->receivers;
+}
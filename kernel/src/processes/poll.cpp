@@ -0,0 +1,101 @@
+#include <processes/poll.h>
+#include <processes/scheduler.h>
+#include <processes/mq.h>
+#include <drivers/pit/pit.h>
+#include <fs/pipe.h>
+
+static uint32_t check_entries(PCB_t *pcb, poll_entry_t *entries, uint32_t count, pipe_t **pipes, uint8_t *write_ends) {
+    uint32_t ready = 0;
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        switch (entries[i].type) {
+            case POLL_KEYBOARD:
+                entries[i].ready = is_keyboard_line_pending(pcb);
+                break;
+            case POLL_CHILD:
+                entries[i].ready = !exists_process(entries[i].id);
+                break;
+            case POLL_PIPE:
+                entries[i].ready = pipes[i] == NULL ? POLL_INVALID : pipe_is_ready(pipes[i], write_ends[i]);
+                break;
+            case POLL_MQ:
+                entries[i].ready = mq_get_wait_queue(entries[i].id) == NULL ? POLL_INVALID : mq_is_ready(entries[i].id);
+                break;
+            default:
+                entries[i].ready = POLL_INVALID;
+                break;
+        }
+        if (entries[i].ready != POLL_NOT_READY)
+            ready++;
+    }
+    return ready;
+}
+
+static void wait_on_entries(PCB_t *pcb, poll_entry_t *entries, uint32_t count, pipe_t **pipes, uint8_t *write_ends) {
+    uint32_t i;
+
+    // whatever's checked afterwards either is ready or is going to wake us up
+    for (i = 0; i < count; i++) {
+        switch (entries[i].type) {
+            case POLL_KEYBOARD:
+                poll_on_queue(pcb, i, get_keyboard_wait_queue(pcb));
+                break;
+            case POLL_CHILD:
+                poll_on_process(pcb, i, entries[i].id);
+                break;
+            case POLL_PIPE:
+                if (pipes[i] != NULL)
+                    poll_on_queue(pcb, i, pipe_get_wait_queue(pipes[i], write_ends[i]));
+                break;
+            case POLL_MQ:
+                if (mq_get_wait_queue(entries[i].id) != NULL)
+                    poll_on_queue(pcb, i, mq_get_wait_queue(entries[i].id));
+                break;
+        }
+    }
+}
+
+uint32_t poll(PCB_t *pcb, poll_entry_t *entries, uint32_t count, uint32_t timeout_ms) {
+    pipe_t *pipes[MAX_POLL_ENTRIES];
+    uint8_t write_ends[MAX_POLL_ENTRIES];
+    uint32_t deadline = PIT_get_uptime_ms() + timeout_ms;
+    uint32_t ready;
+    uint32_t i;
+
+    if (count > MAX_POLL_ENTRIES)
+        return POLL_ERROR;
+
+    // hold the pipes, so they don't go away while we're sleeping on them
+    for (i = 0; i < count; i++) {
+        pipes[i] = NULL;
+        if (entries[i].type == POLL_PIPE)
+            pipes[i] = fd_get_pipe(pcb->process, entries[i].id, &write_ends[i]);
+    }
+
+    while (1) {
+        ready = check_entries(pcb, entries, count, pipes, write_ends);
+        if (ready != 0 || timeout_ms == 0)
+            break;
+        if (timeout_ms != POLL_INFINITE && (int32_t)(PIT_get_uptime_ms() - deadline) >= 0)
+            break;
+
+        // the process has been killed, it lets go of the pipes on its way out
+        if (poll_begin(pcb) != 0)
+            break;
+        wait_on_entries(pcb, entries, count, pipes, write_ends);
+        if (timeout_ms != POLL_INFINITE)
+            poll_on_timer(pcb, deadline);
+
+        // it's become ready before we got into the queues, so nobody's going to wake us up
+        if (check_entries(pcb, entries, count, pipes, write_ends) != 0)
+            poll_wake_up(pcb);
+        poll_sleep(pcb);
+    }
+
+    for (i = 0; i < count; i++) {
+        if (pipes[i] != NULL)
+            pipe_close_end(pipes[i], write_ends[i]);
+    }
+    return ready;
+}
@@ -1,20 +1,23 @@
 #include <memory.h>
 #include <string.h>
 #include <common.h>
-#include <limits.h>
+#include <spinlock.h>
 #include <drivers/screen/screen.h>
 #include <processes/process.h>
 #include <processes/user_programs.h>
 #include <processes/elf_loader.h>
+#include <fpu/fpu.h>
+#include <smp/smp.h>
 
-static uint8_t pids[MAX_NUMBER_OF_PROCESSES];
-static uint32_t process_count;
+static uint32_t pid_bitmap[PID_BITMAP_SIZE];
+static uint32_t next_pid; // pids are handed out round-robin, so a freed one is not reused right away
+static spinlock_t pid_lock;
 
 static void print_pcb_state(uint8_t pcb_state);
 
 static page_dir_t *allocate_page_dir(page_dir_t **process_page_dir_virt);
-static uint32_t allocate_stack_page(page_dir_t *process_page_dir, PCB_t *pcb);
-static uint32_t allocate_heap_pages(page_dir_t *process_page_dir, PCB_t *pcb);
+static uint32_t allocate_stack_page(page_dir_t *process_page_dir, process_t *process);
+static void allocate_heap_page_tables(page_dir_t *process_page_dir, process_t *process);
 
 extern page_dir_t *kernel_page_dir;
 
@@ -75,65 +78,192 @@ void print_registers(PCB_t *pcb) {
     kprintf("eip = 0x%x\n\r", pcb->regs.eip);
 }
 
-PCB_t *create_process_virtual_addr_space(const char *filename, uint32_t ppid, const char *stdout, uint32_t shell_id) {
-    // make sure there's currently running a reasonable amount of processes
-    if (process_count >= MAX_NUMBER_OF_PROCESSES)
+static PCB_t *create_pcb(uint32_t pid, const char *name, uint32_t ppid, const char *stdout, uint32_t shell_id) {
+    uint32_t i;
+    PCB_t *pcb = (PCB_t *)kmalloc(sizeof(PCB_t));
+    if (pcb == NULL)
         return NULL;
-
-    // get the program we want to instantiate (create a process off of it)
-    program_t *program = get_program(filename);
-    if (program == NULL)
+    pcb->kernel_stack = (uint32_t)kmalloc(PROCESS_KERNEL_STACK_SIZE);
+    if (pcb->kernel_stack == 0) {
+        kfree(pcb);
         return NULL;
-
-    // create a new pcb
-    PCB_t *pcb = (PCB_t *)kmalloc(sizeof(PCB_t));
-    pcb->pid = allocate_pid();
+    }
+    pcb->pid = pid;
     pcb->ppid = ppid;
     pcb->state = PROCESS_STATE_NEW;
     pcb->shell_id = shell_id;
-
-    strcpy(pcb->name, filename);
+    pcb->cpu = 0;
+    pcb->pending_kill = 0;
+    pcb->kernel_esp = 0;
+    pcb->on_cpu = 0;
+    pcb->futex_key = 0;
+    pcb->futex_node.pcb = pcb;
+    pcb->wait_node.queue = NULL;
+    pcb->wait_node.pcb = pcb;
+    pcb->wait_node.poll = 0;
+    for (i = 0; i < MAX_POLL_ENTRIES; i++) {
+        pcb->poll_nodes[i].queue = NULL;
+        pcb->poll_nodes[i].pcb = pcb;
+        pcb->poll_nodes[i].poll = 1;
+    }
+    pcb->timer_node.queue = NULL;
+    pcb->timer_node.pcb = pcb;
+    pcb->timer_node.poll = 1;
+    pcb->timer_deadline = 0;
+    wait_queue_init(&pcb->exit_waiters);
+    pcb->exit_code = 1;
+    FPU_init_process(pcb);
+
+    strcpy(pcb->name, name);
     strcpy(pcb->stdout, stdout);
 
-    pcb->open_files = list_create();
-    pcb->page_tables = list_create();
-
     // clear out all registers
     memset(&pcb->regs, 0, sizeof(regs_t));
-
-    // initialize flags, cr3, esp, and eip
     pcb->regs.eflags = EFLAGS_ALWAYS1_BIT | EFLAGS_ENABLE_IF_BIT;
-    pcb->regs.cr3 = (uint32_t)allocate_page_dir(&pcb->page_dir_kernel_mapping);
-    pcb->regs.esp = allocate_stack_page(pcb->page_dir_kernel_mapping, pcb);
+    return pcb;
+}
+
+PCB_t *create_process_virtual_addr_space(const char *filename, uint32_t ppid, const char *stdout, uint32_t shell_id) {
+    // get the program we want to instantiate (create a process off of it)
+    program_t *program = get_program(filename);
+    if (program == NULL)
+        return NULL;
+
+    // make sure there's currently running a reasonable amount of processes
+    uint32_t pid = allocate_pid();
+    if (pid == INVALID_PID)
+        return NULL;
+
+    // create a new pcb (the main thread) along with its address space
+    PCB_t *pcb = create_pcb(pid, filename, ppid, stdout, shell_id);
+    if (pcb == NULL) {
+        free_pid(pid);
+        return NULL;
+    }
+    process_t *process = (process_t *)kmalloc(sizeof(process_t));
+    if (process == NULL) {
+        kfree((void *)pcb->kernel_stack);
+        kfree(pcb);
+        free_pid(pid);
+        return NULL;
+    }
+    pcb->process = process;
+    pcb->thread_stack_slot = MAIN_THREAD_STACK_SLOT;
+
+    process->open_files = list_create();
+    memset(process->fds, 0, sizeof(process->fds));
+    process->page_tables = list_create();
+    process->thread_count = 1;
+    memset(process->thread_stacks, 0, sizeof(process->thread_stacks));
+    spinlock_init(&process->lock);
+    process->ring = NULL;
+    process->ring_busy = 0;
+
+    // initialize cr3, esp, and eip
+    process->cr3 = (uint32_t)allocate_page_dir(&process->page_dir_kernel_mapping);
+    pcb->regs.cr3 = process->cr3;
+    pcb->regs.esp = allocate_stack_page(process->page_dir_kernel_mapping, process);
     load_elf_file(filename, pcb);
 
-    // we have to temporarily switch over to the address space of the process, so we
-    // can initialize its heap (we cannot initialize it from the current address space - it's not mapped here)
-    uint32_t heap_start_addr = allocate_heap_pages(pcb->page_dir_kernel_mapping, pcb);
-    _load_page_dir(pcb->regs.cr3);
-    heap_init(&pcb->heap, heap_start_addr, PROCESS_HEAP_SIZE);
-    _load_page_dir(PAGE_DIR_ADDR);
+    // the heap starts out empty, the process grows it with brk()
+    allocate_heap_page_tables(process->page_dir_kernel_mapping, process);
+    process->brk = PROCESS_HEAP_START_ADDR;
+
+    return pcb;
+}
+
+PCB_t *create_thread(PCB_t *creator, uint32_t entry, uint32_t fce, uint32_t arg) {
+    process_t *process = creator->process;
+    uint32_t slot;
+
+    // find a free user stack within the shared address space
+    spinlock_acquire(&process->lock);
+    for (slot = 0; slot < MAX_THREADS_PER_PROCESS; slot++)
+        if (process->thread_stacks[slot] == 0)
+            break;
+    if (slot == MAX_THREADS_PER_PROCESS) {
+        spinlock_release(&process->lock);
+        return NULL;
+    }
+    process->thread_stacks[slot] = 1;
+    process->thread_count++;
+    spinlock_release(&process->lock);
+
+    PCB_t *pcb = NULL;
+    uint32_t pid = allocate_pid();
+    if (pid != INVALID_PID && (pcb = create_pcb(pid, creator->name, creator->pid, creator->stdout, creator->shell_id)) == NULL)
+        free_pid(pid);
+    if (pcb == NULL) {
+        spinlock_acquire(&process->lock);
+        process->thread_stacks[slot] = 0;
+        process->thread_count--;
+        spinlock_release(&process->lock);
+        return NULL;
+    }
+    pcb->process = process;
+    pcb->thread_stack_slot = slot;
+    pcb->regs.cr3 = process->cr3;
+    pcb->regs.eip = entry;
+
+    // the thread starts off as if the entry function had been called as entry(fce, arg)
+    // (the address space of the creator is the one currently loaded)
+    uint32_t *stack_top = (uint32_t *)(PAGE_TABLE_ADDR(PROCESS_STACK_PAGE_TABLE) + (slot + 1) * THREAD_STACK_SIZE);
+    stack_top[-1] = arg;
+    stack_top[-2] = fce;
+    stack_top[-3] = 0; // return address (the entry function never returns)
+    pcb->regs.esp = (uint32_t)&stack_top[-3];
 
     return pcb;
 }
 
+uint8_t release_thread(PCB_t *pcb) {
+    process_t *process = pcb->process;
+    uint8_t last;
+
+    spinlock_acquire(&process->lock);
+    if (pcb->thread_stack_slot != MAIN_THREAD_STACK_SLOT)
+        process->thread_stacks[pcb->thread_stack_slot] = 0;
+    last = --process->thread_count == 0;
+    spinlock_release(&process->lock);
+    return last;
+}
+
 void free_pid(uint32_t pid) {
-    pids[pid] = 0;
+    spinlock_acquire(&pid_lock);
+    pid_bitmap[pid / 32] &= ~(1 << (pid % 32));
+    spinlock_release(&pid_lock);
 }
 
 uint32_t allocate_pid() {
     uint32_t i;
-    for (i = 0; i < MAX_NUMBER_OF_PROCESSES; i++)
-        if (pids[i] == 0) {
-            pids[i] = 1;
-            return i;
+    uint32_t word = next_pid / 32;
+    uint32_t free_pids;
+    uint32_t pid;
+
+    spinlock_acquire(&pid_lock);
+
+    // go over whole words of the bitmap starting at the cursor (the word holding the cursor
+    // is checked twice - first the pids past the cursor, then all of them once we wrap around)
+    for (i = 0; i <= PID_BITMAP_SIZE; i++, word = (word + 1) % PID_BITMAP_SIZE) {
+        free_pids = ~pid_bitmap[word];
+        if (i == 0)
+            free_pids &= 0xFFFFFFFF << (next_pid % 32);
+        if (free_pids != 0) {
+            pid = word * 32 + __builtin_ctz(free_pids);
+            pid_bitmap[word] |= 1 << (pid % 32);
+            next_pid = (pid + 1) % MAX_NUMBER_OF_PROCESSES;
+            spinlock_release(&pid_lock);
+            return pid;
         }
-    return UINT_MAX; // it should never get here
+    }
+    spinlock_release(&pid_lock);
+    return INVALID_PID;
 }
 
 int init_processes() {
-    memset(&pids, 0, sizeof(pids));
-    process_count = 0;
+    spinlock_init(&pid_lock);
+    memset(&pid_bitmap, 0, sizeof(pid_bitmap));
+    next_pid = 0;
     return 0;
 }
 
@@ -200,13 +330,13 @@ static page_dir_t *allocate_page_dir(page_dir_t **process_page_dir_virt) {
     return (page_dir_t *)process_page_dir_physical_addr;
 }
 
-static uint32_t allocate_stack_page(page_dir_t *process_page_dir, PCB_t *pcb) {
+static uint32_t allocate_stack_page(page_dir_t *process_page_dir, process_t *process) {
     // allocate an empty page that we can use as a stack page table
     // we can initialize it using the kernel page dir
     uint32_t page_virtual_addr = allocate_page(1);
     page_table_t *stack_page_table = (page_table_t *)(page_virtual_addr);
 
-    list_add_last(pcb->page_tables, stack_page_table);
+    list_add_last(process->page_tables, stack_page_table);
 
     // but we'll have to map this page as a page table in the process's page directory, hence we need to get the physical addr as well
     uint32_t page_table_index = page_virtual_addr >> 22;
@@ -241,12 +371,11 @@ static uint32_t allocate_stack_page(page_dir_t *process_page_dir, PCB_t *pcb) {
     return TOP_STACK_ADDR(PROCESS_STACK_PAGE_TABLE);
 }
 
-static uint32_t allocate_heap_pages(page_dir_t *process_page_dir, PCB_t *pcb) {
+static void allocate_heap_page_tables(page_dir_t *process_page_dir, process_t *process) {
     uint32_t i, j;
     uint32_t page_virtual_addr;
     page_table_t *heap_page_table;
 
-    uint32_t physical_addr;
     uint32_t page_table_index;
     uint32_t page_index;
     page_table_t *page_table;
@@ -258,7 +387,7 @@ static uint32_t allocate_heap_pages(page_dir_t *process_page_dir, PCB_t *pcb) {
         page_virtual_addr = allocate_page(1);
         heap_page_table = (page_table_t *)(page_virtual_addr);
 
-        list_add_last(pcb->page_tables, heap_page_table);
+        list_add_last(process->page_tables, heap_page_table);
 
         // get the physical address of the page table, so we can map it into process_page_dir
         page_table_index = page_virtual_addr >> 22;
@@ -272,27 +401,19 @@ static uint32_t allocate_heap_pages(page_dir_t *process_page_dir, PCB_t *pcb) {
         process_page_dir->page_tables[i].user_mode = 1;
         process_page_dir->page_tables[i].present = 1;
 
-        // allocate all pages within the page table
+        // the pages themselves are mapped on demand (map_user_heap_page())
         for (j = 0; j < PAGE_TABLE_ENTRIES; j++) {
-            // get a free page frame
-            physical_addr = allocate_frame() * FRAME_SIZE;
-
-            // let the page table know of the page we just allocated
-            heap_page_table->pages[j].physical_page_addr = (physical_addr & 0xFFFFF000) >> 12;
-            heap_page_table->pages[j].read_write = 1;
-            heap_page_table->pages[j].user_mode = 1;
-            heap_page_table->pages[j].present = 1;
+            memset(&heap_page_table->pages[j], 0, sizeof(page_table_entry_t));
+            heap_page_table->pages[j].physical_page_addr = 0xFFFFF;
         }
     }
-    // return the start address of the user heap
-    return PAGE_TABLE_ADDR(PROCESS_HEAP_START_PAGE_TABLE);
 }
 
 static void delete_page_table_record(void *data) {
     kfree(data);
 }
 
-void unmap_process(PCB_t *pcb) {
+void unmap_process(process_t *process) {
     uint32_t i;
     page_table_t *page_table;
     uint32_t frame_addr;
@@ -301,9 +422,9 @@ void unmap_process(PCB_t *pcb) {
     // make sure we have the kernel mapping
     _load_page_dir(PAGE_DIR_ADDR);
 
-    while (pcb->page_tables->size != 0) {
-        page_table = (page_table_t *)list_get(pcb->page_tables, 0);
-        list_remove(pcb->page_tables, 0, delete_page_table_record);
+    while (process->page_tables->size != 0) {
+        page_table = (page_table_t *)list_get(process->page_tables, 0);
+        list_remove(process->page_tables, 0, delete_page_table_record);
 
         for (i = 0; i < PAGE_TABLE_ENTRIES; i++) {
             if (page_table->pages[i].physical_page_addr != 0xFFFFF) {
@@ -313,6 +434,242 @@ void unmap_process(PCB_t *pcb) {
             }
         }
     }
-    unmap_page((uint32_t)pcb->page_dir_kernel_mapping);
-    list_free(&pcb->page_tables, NULL);
+    unmap_page((uint32_t)process->page_dir_kernel_mapping);
+    list_free(&process->page_tables, NULL);
+}
+
+static page_table_t *get_user_page_table(process_t *process, uint32_t virtual_addr) {
+    // the page tables of the process are mapped only into the kernel page dir, so it must be loaded
+    page_directory_entry_t *dir_entry = &process->page_dir_kernel_mapping->page_tables[virtual_addr >> 22];
+    if (dir_entry->present == 0 || dir_entry->user_mode == 0)
+        return NULL;
+
+    list_node_t *curr = process->page_tables->first;
+    for (; curr != NULL; curr = curr->next) {
+        if (get_physical_addr((uint32_t)curr->data) == (uint32_t)dir_entry->page_table_addr << 12)
+            return (page_table_t *)curr->data;
+    }
+    return NULL;
+}
+
+static page_table_entry_t *get_user_page(process_t *process, uint32_t virtual_addr) {
+    page_table_t *page_table = get_user_page_table(process, virtual_addr);
+    if (page_table == NULL)
+        return NULL;
+    page_table_entry_t *page = &page_table->pages[(virtual_addr >> 12) & 0x3FF];
+    if (page->present == 0 || page->user_mode == 0)
+        return NULL;
+    return page;
+}
+
+uint32_t get_user_physical_addr(process_t *process, uint32_t virtual_addr) {
+    page_table_entry_t *page = get_user_page(process, virtual_addr);
+    if (page == NULL)
+        return 0;
+    return ((uint32_t)page->physical_page_addr << 12) | (virtual_addr & 0xFFF);
+}
+
+uint32_t replace_user_frame(process_t *process, uint32_t virtual_addr, uint32_t frame_addr) {
+    uint32_t old_frame_addr = 0;
+
+    // the caller is responsible for flushing the TLBs (the kernel page dir must be loaded)
+    spinlock_acquire(&process->lock);
+    page_table_entry_t *page = get_user_page(process, virtual_addr);
+    if (page != NULL && page->read_write) {
+        old_frame_addr = (uint32_t)page->physical_page_addr << 12;
+        page->physical_page_addr = (frame_addr & 0xFFFFF000) >> 12;
+    }
+    spinlock_release(&process->lock);
+    return old_frame_addr;
+}
+
+uint8_t map_user_heap_page(process_t *process, uint32_t virtual_addr) {
+    uint32_t page_addr = virtual_addr & ~(FRAME_SIZE - 1);
+    uint32_t cr3 = _get_page_dir();
+    uint8_t result = 1;
+
+    // it's called from the page fault handler, so it may run on top of any page dir
+    _load_page_dir(PAGE_DIR_ADDR);
+    spinlock_acquire(&process->lock);
+    page_table_t *page_table = get_user_page_table(process, page_addr);
+    if (page_addr >= PROCESS_HEAP_START_ADDR && page_addr < process->brk && page_table != NULL) {
+        // another thread may have faulted on the same page in the meantime
+        page_table_entry_t *page = &page_table->pages[(page_addr >> 12) & 0x3FF];
+        if (page->present == 0) {
+            // the frame is cleared out before the process can see what it was used for
+            uint32_t kernel_page = allocate_page(1);
+            memset((void *)kernel_page, 0, FRAME_SIZE);
+            page->physical_page_addr = get_physical_addr(kernel_page) >> 12;
+            detach_page(kernel_page);
+            page->read_write = 1;
+            page->user_mode = 1;
+            page->present = 1;
+        }
+        result = 0;
+    }
+    spinlock_release(&process->lock);
+    _load_page_dir(cr3);
+    return result;
+}
+
+uint32_t set_user_brk(process_t *process, uint32_t new_brk) {
+    // the address space of the process must be loaded
+    spinlock_acquire(&process->lock);
+    uint32_t old_brk = process->brk;
+    if (new_brk < PROCESS_HEAP_START_ADDR || new_brk > PROCESS_HEAP_END_ADDR) {
+        spinlock_release(&process->lock);
+        return old_brk;
+    }
+    process->brk = new_brk;
+    spinlock_release(&process->lock);
+
+    // give back the frames of the pages which are no longer part of the heap
+    // (they can be reused only once no CPU can reach them through a stale TLB entry)
+    uint32_t addr = (new_brk + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1);
+    for (; addr < old_brk; addr += FRAME_SIZE) {
+        uint32_t frame_addr = 0;
+        _load_page_dir(PAGE_DIR_ADDR);
+        spinlock_acquire(&process->lock);
+        page_table_entry_t *page = get_user_page(process, addr);
+        if (page != NULL && addr >= process->brk) {
+            frame_addr = (uint32_t)page->physical_page_addr << 12;
+            memset(page, 0, sizeof(page_table_entry_t));
+            page->physical_page_addr = 0xFFFFF;
+        }
+        spinlock_release(&process->lock);
+        _load_page_dir(process->cr3);
+
+        if (frame_addr != 0) {
+            SMP_flush_tlb(process->cr3, addr);
+            frame_set_state(frame_addr / FRAME_SIZE, 0);
+        }
+    }
+    return new_brk;
+}
+
+static void fd_open(fd_t *fd) {
+    if (fd->pipe != NULL)
+        pipe_open_end(fd->pipe, fd->write_end);
+    else if (fd->file != NULL)
+        dup_fd(fd->file);
+}
+
+static void fd_release(fd_t *fd) {
+    if (fd->pipe != NULL)
+        pipe_close_end(fd->pipe, fd->write_end);
+    else if (fd->file != NULL)
+        close_fd(fd->file);
+}
+
+static int fd_install_entry(process_t *process, fd_t *entry) {
+    uint32_t fd;
+    spinlock_acquire(&process->lock);
+
+    // the standard ones are only ever set up through fd_dup2()
+    for (fd = STDOUT_FD + 1; fd < MAX_FDS; fd++) {
+        if (process->fds[fd].pipe == NULL && process->fds[fd].file == NULL) {
+            process->fds[fd] = *entry;
+            spinlock_release(&process->lock);
+            return fd;
+        }
+    }
+    spinlock_release(&process->lock);
+    return -1;
+}
+
+int fd_install(process_t *process, pipe_t *pipe, uint8_t write_end) {
+    fd_t entry = { pipe, write_end, NULL };
+    int fd = fd_install_entry(process, &entry);
+    if (fd != -1)
+        pipe_open_end(pipe, write_end);
+    return fd;
+}
+
+int fd_install_file(process_t *process, open_file_t *file) {
+    // the descriptor takes over the reference of the caller
+    fd_t entry = { NULL, 0, file };
+    return fd_install_entry(process, &entry);
+}
+
+pipe_t *fd_get_pipe(process_t *process, uint32_t fd, uint8_t *write_end) {
+    if (fd >= MAX_FDS)
+        return NULL;
+
+    // the caller gets its own reference, so another thread may close the descriptor
+    // in the meantime (it must be released through pipe_close_end() once done)
+    spinlock_acquire(&process->lock);
+    pipe_t *pipe = process->fds[fd].pipe;
+    if (pipe != NULL) {
+        *write_end = process->fds[fd].write_end;
+        pipe_open_end(pipe, *write_end);
+    }
+    spinlock_release(&process->lock);
+    return pipe;
+}
+
+open_file_t *fd_get_file(process_t *process, uint32_t fd) {
+    if (fd >= MAX_FDS)
+        return NULL;
+
+    // the same as with pipes (the reference is released through close_fd())
+    spinlock_acquire(&process->lock);
+    open_file_t *file = process->fds[fd].file;
+    if (file != NULL)
+        dup_fd(file);
+    spinlock_release(&process->lock);
+    return file;
+}
+
+int fd_close(process_t *process, uint32_t fd) {
+    if (fd >= MAX_FDS)
+        return 1;
+
+    spinlock_acquire(&process->lock);
+    fd_t closed = process->fds[fd];
+    process->fds[fd].pipe = NULL;
+    process->fds[fd].file = NULL;
+    spinlock_release(&process->lock);
+
+    if (closed.pipe == NULL && closed.file == NULL)
+        return 1;
+    fd_release(&closed);
+    return 0;
+}
+
+int fd_dup2(process_t *process, uint32_t old_fd, uint32_t new_fd) {
+    if (old_fd >= MAX_FDS || new_fd >= MAX_FDS)
+        return 1;
+
+    spinlock_acquire(&process->lock);
+    fd_t dup = process->fds[old_fd];
+    fd_t replaced = process->fds[new_fd];
+    if (dup.pipe == NULL && dup.file == NULL) {
+        spinlock_release(&process->lock);
+        return 1;
+    }
+    process->fds[new_fd] = dup;
+    fd_open(&dup);
+    spinlock_release(&process->lock);
+
+    fd_release(&replaced);
+    return 0;
+}
+
+void fd_copy_table(process_t *dest, process_t *src) {
+    uint32_t fd;
+
+    // the new process is not running yet, so only the source needs to be locked
+    // (the file descriptors share the open files, including their positions)
+    spinlock_acquire(&src->lock);
+    for (fd = 0; fd < MAX_FDS; fd++) {
+        dest->fds[fd] = src->fds[fd];
+        fd_open(&dest->fds[fd]);
+    }
+    spinlock_release(&src->lock);
+}
+
+void fd_close_all(process_t *process) {
+    uint32_t fd;
+    for (fd = 0; fd < MAX_FDS; fd++)
+        fd_close(process, fd);
 }
@@ -5,23 +5,44 @@
 #include <string.h>
 #include <fs/vfs.h>
 #include <memory.h>
+#include <spinlock.h>
+#include <smp/smp.h>
+#include <mem/gdt.h>
+#include <fpu/fpu.h>
+#include <processes/futex.h>
+#include <drivers/keyboard/keyboard.h>
 
 extern "C" {
     void _switch_task(regs_t *regs);
+    void _switch_stack_and_call(uint32_t stack_top, void (*fce)());
+    void _yield_kernel_context(uint32_t *esp_slot, uint32_t stack_top, void (*fce)());
+    void _resume_kernel_context(uint32_t esp);
 }
 
-static PCB_t *running_process;
 static PCB_t *latest_running_non_idle_process[NUMBER_OF_TERMINALS];
-static PCB_t *idle_process;
 static uint32_t focused_terminal;
 
-list_t *ready_processes = NULL;
+// Protects all_processes and all wait queues. If the run queue of a CPU
+// needs to be locked as well, process_lock must always be acquired first.
+static spinlock_t process_lock;
+
 list_t *all_processes = NULL;
-list_t *blocked_on_process_processes = NULL;
-list_t *blocked_on_keyboard_processes = NULL;
+
+// all processes (the same ones as in all_processes) indexed by their pids
+static PCB_t *processes_by_pid[MAX_NUMBER_OF_PROCESSES];
+
+// processes waiting for a line of input, one queue per terminal
+static wait_queue_t keyboard_waiters[NUMBER_OF_TERMINALS];
+
+// line of input nobody has been waiting for yet (only the last one is kept)
+static char pending_lines[NUMBER_OF_TERMINALS][KEYBOARD_BUFF_SIZE];
+static uint8_t has_pending_line[NUMBER_OF_TERMINALS];
+
+// threads polling with a timeout, sorted by their deadlines
+static wait_queue_t timer_waiters;
 
 PCB_t *get_running_process() {
-    return running_process;
+    return get_cpu()->running_process;
 }
 
 PCB_t *get_latest_running_non_idle_process() {
@@ -29,101 +50,331 @@ PCB_t *get_latest_running_non_idle_process() {
 }
 
 void print_all_processes() {
+    spinlock_acquire(&process_lock);
     list_print(all_processes, &print_pcb);
+    spinlock_release(&process_lock);
 }
 
-static uint8_t comparePcb(void *data1, void *data2){
-    return data1 == data2;
+static uint8_t is_idle_process(PCB_t *pcb) {
+    return get_cpu_by_index(pcb->cpu)->idle_process == pcb;
 }
 
-uint8_t is_blocked_elsewhere(PCB_t *pcb, list_t *originalQueue) {
-    if(blocked_on_keyboard_processes != originalQueue && list_contains(blocked_on_keyboard_processes, pcb, comparePcb)){
-        return 1;
+static PCB_t *dequeue_ready_process(cpu_t *cpu, uint8_t from_tail) {
+    PCB_t *pcb = NULL;
+    spinlock_acquire(&cpu->ready_lock);
+    if (cpu->ready_processes->size != 0) {
+        if (from_tail) {
+            pcb = (PCB_t *)cpu->ready_processes->last->data;
+            list_remove(cpu->ready_processes, cpu->ready_processes->size - 1, NULL);
+        } else {
+            pcb = (PCB_t *)cpu->ready_processes->first->data;
+            list_remove(cpu->ready_processes, 0, NULL);
+        }
     }
-    if(blocked_on_process_processes != originalQueue && list_contains(blocked_on_process_processes, pcb, comparePcb)){
-        return 1;
+    spinlock_release(&cpu->ready_lock);
+    return pcb;
+}
+
+static PCB_t *steal_ready_process(cpu_t *thief) {
+    // take the most recently queued process of the CPU with the longest run
+    // queue (the size is only a hint, the queue itself is checked under its lock)
+    cpu_t *victim = NULL;
+    uint32_t i;
+    for (i = 0; i < get_cpu_count(); i++) {
+        cpu_t *cpu = get_cpu_by_index(i);
+        if (cpu == thief || cpu->ready_processes->size == 0)
+            continue;
+        if (victim == NULL || cpu->ready_processes->size > victim->ready_processes->size)
+            victim = cpu;
     }
-    return 0;
+    if (victim == NULL)
+        return NULL;
+    return dequeue_ready_process(victim, 1);
 }
 
-void switch_to_next_process() {
-    if(all_processes->first == all_processes->last){
+static PCB_t *pick_next_process(cpu_t *cpu) {
+    PCB_t *pcb;
+    while (1) {
+        pcb = dequeue_ready_process(cpu, 0);
+        if (pcb == NULL)
+            pcb = steal_ready_process(cpu);
+        if (pcb == NULL)
+            return cpu->idle_process;
+
+        // once the process has been marked as running, nobody
+        // else will try to kill it but the CPU it's running on
+        // (a killed one suspended within the kernel has to unwind first,
+        // it's killed here once it's been through the syscall)
+        spinlock_acquire(&process_lock);
+        if (pcb->pending_kill == 0 || pcb->kernel_esp != 0) {
+            pcb->state = PROCESS_STATE_RUNNING;
+            pcb->cpu = cpu->index;
+            cpu->running_process = pcb;
+            spinlock_release(&process_lock);
+            return pcb;
+        }
+        // it's neither queued nor running anywhere, so kill_process() can get rid of it
+        pcb->state = PROCESS_STATE_TERMINATION;
+        spinlock_release(&process_lock);
+        kill_process(pcb);
+    }
+}
+
+static void schedule() {
+    cpu_t *cpu = get_cpu();
+    PCB_t *prev = cpu->running_process;
+
+    // we've left the kernel stack of the previous process, so it's safe
+    // to let it go (it may have been put back into a run queue already)
+    cpu->preempt_count = 0;
+    cpu->need_resched = 0;
+    scratch_reset();
+    FPU_switch_out(cpu->dead_process != NULL ? NULL : prev);
+    if (cpu->dead_process != NULL) {
+        kfree((void *)cpu->dead_process->kernel_stack);
+        kfree(cpu->dead_process);
+        cpu->dead_process = NULL;
+    } else if (prev != NULL) {
+        prev->on_cpu = 0;
+    }
+    cpu->running_process = NULL;
+
+    // the idle processes are the only ones left
+    if(all_processes->size <= get_cpu_count()){
         set_color(FOREGROUND_GREEN);
         kprintf("System shutting down ...\r\n");
         kprintf("(It is safe to turn off the PC now)\r\n");
         _panic();
     }
-    running_process = idle_process;
-    while (ready_processes->first != NULL && running_process == idle_process) {
-        running_process = (PCB_t *)ready_processes->first->data;
-        list_remove(ready_processes, 0, NULL);
-    }
-    if (running_process != idle_process) {
-        latest_running_non_idle_process[running_process->shell_id-1] = running_process;
+    PCB_t *pcb = pick_next_process(cpu);
+    if (pcb->shell_id != 0) {
+        latest_running_non_idle_process[pcb->shell_id-1] = pcb;
     }
-    switch_process(running_process);
+    switch_process(pcb);
+}
+
+static void requeue_and_schedule() {
+    set_process_as_ready(get_cpu()->running_process);
+    schedule();
+}
+
+void switch_to_next_process() {
+    // leave the kernel stack of the current process first, as another CPU
+    // may pick the process up as soon as it's been put into a run queue
+    _switch_stack_and_call(get_cpu()->kernel_stack_top, &schedule);
 }
 
 void switch_process(PCB_t *pcb) {
+    cpu_t *cpu = get_cpu();
+
+    // the CPU which ran the process last may still be on its kernel stack
+    while (pcb->on_cpu)
+        _pause();
+    pcb->on_cpu = 1;
+
+    cpu->running_process = pcb;
+    cpu->ticks = 0;
+    pcb->cpu = cpu->index;
     pcb->state = PROCESS_STATE_RUNNING;
+    TSS_set_kernel_stack(cpu->index, pcb->kernel_stack + PROCESS_KERNEL_STACK_SIZE);
     _load_page_dir(pcb->regs.cr3);
+    cpu->cr3 = pcb->regs.cr3;
+
+    // the process was preempted within the kernel, so let it finish its work first
+    if (pcb->kernel_esp != 0) {
+        uint32_t kernel_esp = pcb->kernel_esp;
+        pcb->kernel_esp = 0;
+        _resume_kernel_context(kernel_esp);
+    }
     _switch_task(&pcb->regs);
 }
 
+void preempt_point() {
+    cpu_t *cpu = get_cpu();
+    if (cpu->preempt_count != 0 || cpu->running_process == cpu->idle_process)
+        return;
+
+    // let the pending interrupts in, the timer may ask for a reschedule
+    cpu->preempt_count++;
+    cpu->in_preempt_point = 1;
+    _interrupt_window();
+    cpu->in_preempt_point = 0;
+    cpu->preempt_count--;
+
+    if (cpu->need_resched) {
+        // it returns once the process has been scheduled again (possibly on another CPU)
+        _yield_kernel_context(&cpu->running_process->kernel_esp, cpu->kernel_stack_top, &requeue_and_schedule);
+    }
+}
+
 void set_process_as_ready(PCB_t *pcb) {
-    if (list_contains(ready_processes, pcb, comparePcb)) {
+    // idle processes are picked up only when the run queue is empty
+    if (is_idle_process(pcb)) {
         return;
     }
-    pcb->state = PROCESS_STATE_READY;
-    list_add_last(ready_processes, pcb);
+    cpu_t *cpu = get_cpu_by_index(pcb->cpu);
+    spinlock_acquire(&cpu->ready_lock);
+    if (pcb->state != PROCESS_STATE_READY) {
+        pcb->state = PROCESS_STATE_READY;
+        list_add_last(cpu->ready_processes, pcb);
+    }
+    spinlock_release(&cpu->ready_lock);
+}
+
+static PCB_t *get_process_locked(uint32_t pid) {
+    // the pid may come from the userspace
+    if (pid >= MAX_NUMBER_OF_PROCESSES)
+        return NULL;
+    return processes_by_pid[pid];
+}
+
+static uint8_t exists_process_locked(uint32_t pid) {
+    return get_process_locked(pid) != NULL;
 }
 
-void block_process_on_another_process(PCB_t *pcb) {
+static void sleep_on_locked(wait_queue_t *queue, PCB_t *pcb) {
+    // the process has been killed in the meantime, let the scheduler get rid of it
+    if (pcb->pending_kill) {
+        set_process_as_ready(pcb);
+        return;
+    }
     pcb->state = PROCESS_STATE_WAITING;
-    list_add_last(blocked_on_process_processes, pcb);
+    wait_queue_push(queue, &pcb->wait_node);
+}
+
+static void wake_poller_locked(wait_queue_node_t *node) {
+    // the thread may have been woken up through another one of its nodes already
+    PCB_t *pcb = (PCB_t *)node->pcb;
+    wait_queue_remove(node);
+    if (pcb->state == PROCESS_STATE_WAITING)
+        set_process_as_ready(pcb);
 }
 
-void wake_up_parent_process(uint32_t ppid, uint32_t exit_code) {
-    PCB_t *parent = NULL;
-    list_node_t *curr = blocked_on_process_processes->first;
-    for (; curr != NULL; curr = curr->next) {
-        if (((PCB_t *)curr->data)->pid == ppid) {
-            parent = (PCB_t *)curr->data;
-            break;
+static void wake_sleeper_locked(wait_queue_node_t *node, uint32_t result) {
+    PCB_t *pcb = (PCB_t *)node->pcb;
+    wait_queue_remove(node);
+
+    // the result must be in place before another CPU may resume the process
+    pcb->regs.eax = result;
+    set_process_as_ready(pcb);
+}
+
+static uint8_t wake_one_locked(wait_queue_t *queue, uint32_t result) {
+    wait_queue_node_t *node;
+    wait_queue_node_t *next;
+    uint8_t woken = 0;
+
+    // pollers don't take the resource, so all of them get to check it
+    // (the first regular sleeper is the only one that's handed it over)
+    for (node = queue->first; node != NULL; node = next) {
+        next = node->next;
+        if (node->poll) {
+            wake_poller_locked(node);
+        } else if (woken == 0) {
+            wake_sleeper_locked(node, result);
+            woken = 1;
         }
     }
-    if (parent == NULL)
-        return;
+    return woken;
+}
+
+static uint32_t wake_all_locked(wait_queue_t *queue, uint32_t result) {
+    wait_queue_node_t *node;
+    uint32_t woken = 0;
+    while ((node = queue->first) != NULL) {
+        if (node->poll) {
+            wake_poller_locked(node);
+        } else {
+            wake_sleeper_locked(node, result);
+            woken++;
+        }
+    }
+    return woken;
+}
+
+void sleep_on(wait_queue_t *queue, PCB_t *pcb) {
+    spinlock_acquire(&process_lock);
+    sleep_on_locked(queue, pcb);
+    spinlock_release(&process_lock);
+}
+
+uint8_t wake_one(wait_queue_t *queue, uint32_t result) {
+    spinlock_acquire(&process_lock);
+    uint8_t woken = wake_one_locked(queue, result);
+    spinlock_release(&process_lock);
+    return woken;
+}
+
+uint32_t wake_all(wait_queue_t *queue, uint32_t result) {
+    spinlock_acquire(&process_lock);
+    uint32_t woken = wake_all_locked(queue, result);
+    spinlock_release(&process_lock);
+    return woken;
+}
+
+uint8_t sleep_until_woken(wait_queue_t *queue, spinlock_t *lock) {
+    cpu_t *cpu = get_cpu();
+    PCB_t *pcb = cpu->running_process;
 
-    list_remove_data(blocked_on_process_processes, parent, NULL);
-    parent->regs.eax = exit_code;
-    if(is_blocked_elsewhere(parent, blocked_on_process_processes) == 0){
-        set_process_as_ready(parent);
+    // a killed process doesn't go to sleep anymore, the caller gives up waiting
+    // and lets go of what it holds on its way out of the kernel (1 = killed)
+    spinlock_acquire(&process_lock);
+    if (pcb->pending_kill) {
+        spinlock_release(&process_lock);
+        return 1;
     }
+
+    // the lock guards the condition the process is waiting for, so once the process
+    // is in the queue, whoever changes the condition is going to find it there
+    pcb->state = PROCESS_STATE_WAITING;
+    wait_queue_push(queue, &pcb->wait_node);
+    spinlock_release(&process_lock);
+    spinlock_release(lock);
+
+    // it returns once the process has been woken up and scheduled again (possibly on another CPU)
+    _yield_kernel_context(&pcb->kernel_esp, cpu->kernel_stack_top, &schedule);
+    spinlock_acquire(lock);
+    return pcb->pending_kill;
 }
 
-uint8_t compare_by_pid(void *data1, void *data2) {
-    PCB_t *pcb = (PCB_t *)data1;
-    uint32_t pid = *(uint32_t *)data2;
-    return pcb->pid == pid;
+uint8_t block_process_on_another_process(PCB_t *pcb, uint32_t pid) {
+    spinlock_acquire(&process_lock);
+    // the other process may be terminating on another CPU, so its existence must be checked
+    // under the same lock its exit waiters are woken up under (otherwise we could miss it)
+    PCB_t *other = get_process_locked(pid);
+    if (other == NULL) {
+        spinlock_release(&process_lock);
+        return 1;
+    }
+    sleep_on_locked(&other->exit_waiters, pcb);
+    spinlock_release(&process_lock);
+    return 0;
 }
 
 uint8_t exists_process(uint32_t pid) {
-    uint32_t *pid_storage = (uint32_t *)kmalloc(sizeof(uint32_t));
-    *pid_storage = pid;
-    uint8_t exists = list_contains(all_processes, pid_storage, compare_by_pid);
-    kfree(pid_storage);
+    spinlock_acquire(&process_lock);
+    uint8_t exists = exists_process_locked(pid);
+    spinlock_release(&process_lock);
     return exists;
 }
 
 void wake_process_waiting_for_keyboard(char *data) {
-    PCB_t *pcb = (PCB_t *)list_get(blocked_on_keyboard_processes, 0);
-    if (pcb == NULL)
-        return;
-
-    if (pcb->shell_id != focused_terminal){
+    spinlock_acquire(&process_lock);
+    uint32_t terminal = focused_terminal - 1;
+    wait_queue_t *queue = &keyboard_waiters[terminal];
+    wait_queue_node_t *node = queue->first;
+    while (node != NULL && node->poll)
+        node = node->next;
+
+    // nobody is reading, so keep the line for later (and let the pollers know it's there)
+    if (node == NULL) {
+        strcpy(pending_lines[terminal], data);
+        has_pending_line[terminal] = 1;
+        wake_all_locked(queue, 0);
+        spinlock_release(&process_lock);
         return;
     }
+    PCB_t *pcb = (PCB_t *)node->pcb;
 
     uint32_t cr3 = _get_page_dir();
     _load_page_dir(pcb->regs.cr3);
@@ -131,64 +382,141 @@ void wake_process_waiting_for_keyboard(char *data) {
     strcpy((char *)pcb->regs.edi, data);
     print_to_stream(pcb, data, 1);      // 1  Adds newline
 
-    list_remove(blocked_on_keyboard_processes, 0, NULL);
-    if(is_blocked_elsewhere(pcb, blocked_on_keyboard_processes) == 0){
-        set_process_as_ready(pcb);
-    }
     _load_page_dir(cr3);
+    wake_one_locked(queue, 0);
+    spinlock_release(&process_lock);
 }
 
 void block_process_on_keyboard(PCB_t *pcb) {
-    pcb->state = PROCESS_STATE_WAITING;
-    list_add_first(blocked_on_keyboard_processes, pcb);
+    spinlock_acquire(&process_lock);
+    uint32_t terminal = pcb->shell_id - 1;
+    if (has_pending_line[terminal] == 0) {
+        sleep_on_locked(&keyboard_waiters[terminal], pcb);
+        spinlock_release(&process_lock);
+        return;
+    }
+
+    // the line has been typed in already (the address space of the process is the one loaded)
+    strcpy((char *)pcb->regs.edi, pending_lines[terminal]);
+    print_to_stream(pcb, pending_lines[terminal], 1);
+    has_pending_line[terminal] = 0;
+    pcb->regs.eax = 0;
+    set_process_as_ready(pcb);
+    spinlock_release(&process_lock);
 }
 
-uint32_t get_focused_terminal() {
-    return focused_terminal;
+wait_queue_t *get_keyboard_wait_queue(PCB_t *pcb) {
+    return &keyboard_waiters[pcb->shell_id - 1];
 }
 
-static void reschedule_process(uint32_t pid, list_t *blocked_processes) {
-    list_t *pcbs = list_create();
-    list_node_t *curr = blocked_processes->first;
-    while (curr != NULL) {
-        if (((PCB_t *)curr->data)->shell_id == pid)
-            list_add_last(pcbs, curr->data);
-        curr = curr->next;
-    }
-    curr = pcbs->first;
-    while (curr != NULL) {
-        list_remove_data(blocked_processes, curr->data, NULL);
-        curr = curr->next;
+uint8_t is_keyboard_line_pending(PCB_t *pcb) {
+    spinlock_acquire(&process_lock);
+    uint8_t pending = has_pending_line[pcb->shell_id - 1];
+    spinlock_release(&process_lock);
+    return pending;
+}
+
+static void cancel_poll_locked(PCB_t *pcb) {
+    uint32_t i;
+    for (i = 0; i < MAX_POLL_ENTRIES; i++) {
+        if (pcb->poll_nodes[i].queue != NULL)
+            wait_queue_remove(&pcb->poll_nodes[i]);
     }
-    curr = pcbs->last;
-    while (curr != NULL) {
-        list_add_first(blocked_processes, curr->data);
-        curr = curr->prev;
+    if (pcb->timer_node.queue != NULL)
+        wait_queue_remove(&pcb->timer_node);
+}
+
+uint8_t poll_begin(PCB_t *pcb) {
+    // the process has been killed in the meantime, so it's not going to sleep (1 = killed)
+    spinlock_acquire(&process_lock);
+    uint8_t killed = pcb->pending_kill;
+    if (killed == 0)
+        pcb->state = PROCESS_STATE_WAITING;
+    spinlock_release(&process_lock);
+    return killed;
+}
+
+void poll_on_queue(PCB_t *pcb, uint32_t index, wait_queue_t *queue) {
+    // the thread has been killed or woken up already (there's no point in queueing it up)
+    spinlock_acquire(&process_lock);
+    if (pcb->state == PROCESS_STATE_WAITING)
+        wait_queue_push(queue, &pcb->poll_nodes[index]);
+    spinlock_release(&process_lock);
+}
+
+uint8_t poll_on_process(PCB_t *pcb, uint32_t index, uint32_t pid) {
+    // the other process cannot terminate while we're looking it up
+    spinlock_acquire(&process_lock);
+    PCB_t *other = get_process_locked(pid);
+    if (other != NULL && pcb->state == PROCESS_STATE_WAITING)
+        wait_queue_push(&other->exit_waiters, &pcb->poll_nodes[index]);
+    spinlock_release(&process_lock);
+    return other == NULL;
+}
+
+void poll_on_timer(PCB_t *pcb, uint32_t deadline) {
+    spinlock_acquire(&process_lock);
+    if (pcb->state == PROCESS_STATE_WAITING) {
+        wait_queue_node_t *next = timer_waiters.first;
+        while (next != NULL && (int32_t)(((PCB_t *)next->pcb)->timer_deadline - deadline) <= 0)
+            next = next->next;
+        pcb->timer_deadline = deadline;
+        wait_queue_insert_before(&timer_waiters, &pcb->timer_node, next);
     }
-    list_free(&pcbs, NULL);
+    spinlock_release(&process_lock);
+}
+
+void poll_wake_up(PCB_t *pcb) {
+    spinlock_acquire(&process_lock);
+    if (pcb->state == PROCESS_STATE_WAITING)
+        set_process_as_ready(pcb);
+    spinlock_release(&process_lock);
+}
+
+void poll_sleep(PCB_t *pcb) {
+    cpu_t *cpu = get_cpu();
+
+    // once the thread has been marked as waiting, it may have been killed,
+    // so it must leave the CPU regardless of whether it's been woken up already
+    _yield_kernel_context(&pcb->kernel_esp, cpu->kernel_stack_top, &schedule);
+
+    spinlock_acquire(&process_lock);
+    cancel_poll_locked(pcb);
+    spinlock_release(&process_lock);
+}
+
+void wake_up_expired_timers(uint32_t now) {
+    // called on every tick, so don't bother locking if there's nobody to wake up
+    if (timer_waiters.first == NULL)
+        return;
+
+    spinlock_acquire(&process_lock);
+    while (timer_waiters.first != NULL && (int32_t)(now - ((PCB_t *)timer_waiters.first->pcb)->timer_deadline) >= 0)
+        wake_poller_locked(timer_waiters.first);
+    spinlock_release(&process_lock);
+}
+
+uint32_t get_focused_terminal() {
+    return focused_terminal;
 }
 
 void switch_to_terminal(uint32_t pid) {
-    PCB_t *pcb = NULL;
-    list_node_t *curr = all_processes->first;
-    while (curr != NULL) {
-        if (((PCB_t *)curr->data)->pid == pid) {
-            pcb = (PCB_t *)curr->data;
-            break;
-        }
-        curr = curr->next;
-    }
-    if (pcb == NULL)
+    spinlock_acquire(&process_lock);
+    PCB_t *pcb = get_process_locked(pid);
+    if (pcb == NULL) {
+        spinlock_release(&process_lock);
         return;
+    }
 
     focused_terminal = pid;
+    spinlock_release(&process_lock);
+    preempt_point();
 
-    reschedule_process(pid, blocked_on_keyboard_processes);
-    reschedule_process(pid, blocked_on_process_processes);
-
+    // shells never terminate, so the pcb cannot go away from now on
     clear_screen();
     uint32_t file_size = get_file_size(pcb->stdout);
-    char *buffer = (char *)kmalloc(MAX_SHELL_FILE_SIZE + 1);
+    scratch_mark_t mark = scratch_begin();
+    char *buffer = (char *)scratch_alloc(MAX_SHELL_FILE_SIZE + 1);
     uint32_t offset;
     uint32_t len;
     if ((int)file_size - MAX_SHELL_FILE_SIZE <= 0) {
@@ -198,30 +526,52 @@ void switch_to_terminal(uint32_t pid) {
         offset = file_size - MAX_SHELL_FILE_SIZE;
         len = MAX_SHELL_FILE_SIZE;
     }
-    memset(buffer, 0, MAX_SHELL_FILE_SIZE);
-    read(pcb->stdout, buffer, offset, len);
-    buffer[len] = '\0';
-    kprintf("%s", buffer);
-    kfree(buffer);
+
+    // out of memory, the output of the shell is not redrawn
+    if (buffer != NULL) {
+        memset(buffer, 0, MAX_SHELL_FILE_SIZE);
+        read(pcb->stdout, buffer, offset, len);
+        buffer[len] = '\0';
+        kprintf("%s", buffer);
+    }
+    scratch_end(mark);
 
     set_color(FOREGROUND_CYAN);
     print_terminal_index(pid);
     reset_color();
 }
 
+static PCB_t *create_idle_process(cpu_t *cpu) {
+    PCB_t *idle_process = create_process("idle.exe", 0, NULL, 0);
+    idle_process->state = PROCESS_STATE_WAITING;
+    idle_process->cpu = cpu->index;
+    cpu->idle_process = idle_process;
+    cpu->running_process = idle_process;
+    return idle_process;
+}
+
 void init_process_scheduler() {
-    ready_processes = list_create();
+    spinlock_init(&process_lock);
     all_processes = list_create();
-    blocked_on_process_processes = list_create();
-    blocked_on_keyboard_processes = list_create();
 
-    idle_process = create_process("idle.exe", 0, NULL, 0);
-    idle_process->state = PROCESS_STATE_WAITING;
-    running_process = idle_process;
+    uint32_t i;
+    for (i = 0; i < NUMBER_OF_TERMINALS; i++) {
+        wait_queue_init(&keyboard_waiters[i]);
+        has_pending_line[i] = 0;
+    }
+    wait_queue_init(&timer_waiters);
+    for (i = 0; i < get_cpu_count(); i++) {
+        cpu_t *cpu = get_cpu_by_index(i);
+        cpu->ready_processes = list_create();
+        spinlock_init(&cpu->ready_lock);
+    }
+
+    // the idle process of the BSP comes first, so it gets pid 0
+    // and the shells keep their pids 1-4 regardless of the number of CPUs
+    create_idle_process(get_cpu_by_index(BSP_INDEX));
 
     char stdout[] = "shell_?";
     int index_pos = strlen(stdout) - 1;
-    int i;
     PCB_t *first = NULL;
     for (i = 0; i < NUMBER_OF_TERMINALS; i++) {
         stdout[index_pos] = '0' + (i + 1);
@@ -237,6 +587,12 @@ void init_process_scheduler() {
         }
     }
     set_process_as_ready(first);
+
+    for (i = 0; i < get_cpu_count(); i++) {
+        if (i != BSP_INDEX)
+            create_idle_process(get_cpu_by_index(i));
+    }
+
     focused_terminal = 1;
     set_color(FOREGROUND_CYAN);
     print_terminal_index(1);
@@ -256,37 +612,162 @@ void save_process_context(PCB_t *pcb, Interrupt_generic_registers_t *regs) {
     pcb->regs.eip = regs->eip;
 }
 
+static uint32_t get_least_loaded_cpu() {
+    uint32_t i;
+    uint32_t least_loaded = BSP_INDEX;
+    for (i = 1; i < get_cpu_count(); i++) {
+        if (get_cpu_by_index(i)->ready_processes->size < get_cpu_by_index(least_loaded)->ready_processes->size)
+            least_loaded = i;
+    }
+    return least_loaded;
+}
+
+static void add_process(PCB_t *pcb) {
+    pcb->cpu = get_least_loaded_cpu();
+    spinlock_acquire(&process_lock);
+    list_add_last(all_processes, pcb);
+    processes_by_pid[pcb->pid] = pcb;
+    spinlock_release(&process_lock);
+}
+
 PCB_t *create_process(const char *filename, uint32_t ppid, const char *stdout, uint32_t shell_id) {
     PCB_t *pcb = create_process_virtual_addr_space(filename, ppid, stdout, shell_id);
-    if (pcb != NULL) {
-        list_add_last(all_processes, pcb);
-    }
+    if (pcb != NULL)
+        add_process(pcb);
+    return pcb;
+}
+
+PCB_t *create_user_thread(PCB_t *creator, uint32_t entry, uint32_t fce, uint32_t arg) {
+    PCB_t *pcb = create_thread(creator, entry, fce, arg);
+    if (pcb != NULL)
+        add_process(pcb);
     return pcb;
 }
 
+uint8_t is_thread_of(uint32_t pid, PCB_t *pcb) {
+    spinlock_acquire(&process_lock);
+    PCB_t *thread = get_process_locked(pid);
+    uint8_t found = thread != NULL && thread->process == pcb->process;
+    spinlock_release(&process_lock);
+    return found;
+}
+
+static void destroy_process(PCB_t *pcb) {
+    process_t *process = pcb->process;
+
+    // the address space (along with the open files) is shared by all threads
+    // of the process, so only the last one to terminate gets rid of it
+    if (release_thread(pcb)) {
+        // we cannot free the page directory while it's still loaded on any CPU
+        // (this one included - it will load another one when switching anyway)
+        _load_page_dir(PAGE_DIR_ADDR);
+        get_cpu()->cr3 = PAGE_DIR_ADDR;
+        wait_until_address_space_unused(process->cr3);
+        unmap_process(process);
+
+        // close up all open files
+        while (process->open_files->size != 0) {
+            void *filename = list_get(process->open_files, 0);
+            close_file((char *)filename);
+            kfree(filename);
+            list_remove(process->open_files, 0, NULL);
+        }
+        // we do not need to provide any remove function as we
+        // just erased all filenames manually one by one
+        list_free(&process->open_files, NULL);
+
+        // the other ends of the pipes may be waiting for us to go away
+        fd_close_all(process);
+        kfree(process);
+    }
+    FPU_free_process(pcb);
+
+    // free the kernel stack as well as the pcb record, unless we're still running on
+    // the stack (the process has killed itself) - it's freed once we've left it then
+    cpu_t *cpu = get_cpu();
+    if (pcb == cpu->running_process) {
+        cpu->dead_process = pcb;
+    } else {
+        while (pcb->on_cpu)
+            _pause();
+        kfree((void *)pcb->kernel_stack);
+        kfree(pcb);
+    }
+}
+
+static uint8_t has_kernel_context(PCB_t *pcb) {
+    // the process is suspended within the kernel (preempted or asleep), or it's still on its
+    // way to sleep there (on_cpu goes first, the kernel stack pointer is saved before it's cleared)
+    if (pcb->state == PROCESS_STATE_WAITING && pcb->on_cpu)
+        return 1;
+    return pcb->kernel_esp != 0;
+}
+
+static void defer_kill_locked(PCB_t *pcb) {
+    // futex_block() checks the flag under the lock of its bucket only, so the thread
+    // may have got into a futex queue just before the flag was set - it's taken out
+    // of there and left to the scheduler to get rid of
+    pcb->pending_kill = 1;
+    __sync_synchronize();
+    if (futex_cancel(pcb))
+        set_process_as_ready(pcb);
+}
+
 void kill_process(PCB_t *pcb) {
-    free_pid(pcb->pid);
-    unmap_process(pcb);
+    spinlock_acquire(&process_lock);
+    cpu_t *cpu = get_cpu_by_index(pcb->cpu);
 
-    // remove the pcb from all queues
-    list_remove_data(ready_processes, pcb, NULL);
-    list_remove_data(all_processes, pcb, NULL);
-    list_remove_data(blocked_on_process_processes, pcb, NULL);
-    list_remove_data(blocked_on_keyboard_processes, pcb, NULL);
+    // a thread woken up after this point has already been marked as ready
+    futex_cancel(pcb);
 
-    // close up all open files
-    while (pcb->open_files->size != 0) {
-        void *filename = list_get(pcb->open_files, 0);
-        close_file((char *)filename);
-        kfree(filename);
-        list_remove(pcb->open_files, 0, NULL);
+    // the process is running on another CPU (or another CPU has just taken it
+    // off its run queue), so leave it up to that CPU to kill it
+    if (pcb->state == PROCESS_STATE_RUNNING && cpu->running_process == pcb && cpu != get_cpu()) {
+        defer_kill_locked(pcb);
+        spinlock_release(&process_lock);
+        return;
+    }
+    // the process holds whatever it has taken on the way into the kernel (pipes, frames, ...),
+    // so it's woken up to let go of it and killed once it's out (see pick_next_process())
+    if (has_kernel_context(pcb)) {
+        if (pcb->wait_node.queue != NULL)
+            wait_queue_remove(&pcb->wait_node);
+        cancel_poll_locked(pcb);
+        defer_kill_locked(pcb);
+        if (pcb->state == PROCESS_STATE_WAITING)
+            set_process_as_ready(pcb);
+        spinlock_release(&process_lock);
+        return;
+    }
+    if (pcb->state == PROCESS_STATE_READY) {
+        spinlock_acquire(&cpu->ready_lock);
+        uint8_t removed = list_remove_data(cpu->ready_processes, pcb, NULL);
+        spinlock_release(&cpu->ready_lock);
+        if (removed == 0) {
+            defer_kill_locked(pcb);
+            spinlock_release(&process_lock);
+            return;
+        }
     }
-    // we do not need to provide any remove function as we
-    // just erased all filenames manually one by one
-    list_free(&pcb->open_files, NULL);
 
-    latest_running_non_idle_process[pcb->shell_id - 1] = idle_process;
+    // remove the pcb from all queues
+    list_remove_data(all_processes, pcb, NULL);
+    processes_by_pid[pcb->pid] = NULL;
+
+    // stop waiting for whatever the process has been waiting for, and
+    // let go of everybody who has been waiting for the process to terminate
+    if (pcb->wait_node.queue != NULL)
+        wait_queue_remove(&pcb->wait_node);
+    cancel_poll_locked(pcb);
+    wake_all_locked(&pcb->exit_waiters, pcb->exit_code);
+
+    // nobody is going to wake the process up anymore (another CPU
+    // may be still leaving its kernel stack though)
+    pcb->state = PROCESS_STATE_TERMINATION;
+    free_pid(pcb->pid);
 
-    // free the pcb record
-    kfree(pcb);
-}
\ No newline at end of file
+    latest_running_non_idle_process[pcb->shell_id - 1] = get_cpu_by_index(BSP_INDEX)->idle_process;
+    spinlock_release(&process_lock);
+
+    destroy_process(pcb);
+}
@@ -5,8 +5,16 @@
 #include <processes/user_programs.h>
 #include <common.h>
 #include <fs/vfs.h>
+#include <fs/bcache.h>
+#include <fpu/fpu.h>
+#include <processes/futex.h>
+#include <processes/mq.h>
+#include <processes/poll.h>
+#include <drivers/pit/pit.h>
+#include <drivers/keyboard/keyboard.h>
 #include <string.h>
 #include <memory.h>
+#include <mem/scratch.h>
 
 // #define DEBUG_PIDS
 
@@ -15,13 +23,26 @@ static int last_exit_code = 0;
 static void sys_call_exit(PCB_t *pcb) {
     _load_page_dir(PAGE_DIR_ADDR);
     last_exit_code = pcb->regs.ebx;
-    wake_up_parent_process(pcb->ppid, pcb->regs.ebx);
+
+    // those waiting for the process get the exit code once it's gone
+    pcb->exit_code = pcb->regs.ebx;
     kill_process(pcb);
 }
 
 void sys_call_printf(PCB_t *pcb) {
     char *buffer = (char *)pcb->regs.esi;
 
+    // the output has been redirected into a pipe
+    uint8_t write_end;
+    pipe_t *pipe = fd_get_pipe(pcb->process, STDOUT_FD, &write_end);
+    if (pipe != NULL) {
+        if (write_end)
+            pipe_write(pipe, buffer, strlen(buffer));
+        pipe_close_end(pipe, write_end);
+        set_process_as_ready(pcb);
+        return;
+    }
+
     if (get_focused_terminal() == pcb->shell_id) {
         #ifdef DEBUG_PIDS
             set_color(FOREGROUND_DARKGRAY);
@@ -34,16 +55,9 @@ void sys_call_printf(PCB_t *pcb) {
     set_process_as_ready(pcb);
 }
 
-static void sys_call_malloc(PCB_t *pcb) {
+static void sys_call_brk(PCB_t *pcb) {
     _load_page_dir(pcb->regs.cr3);
-    pcb->regs.eax = (uint32_t)heap_malloc(&pcb->heap, pcb->regs.ebx);
-    last_exit_code = pcb->regs.eax;
-    set_process_as_ready(pcb);
-}
-
-static void sys_call_free(PCB_t *pcb) {
-    _load_page_dir(pcb->regs.cr3);
-    heap_free(&pcb->heap, (void *)pcb->regs.ebx);
+    pcb->regs.eax = set_user_brk(pcb->process, pcb->regs.ebx);
     set_process_as_ready(pcb);
 }
 
@@ -61,29 +75,37 @@ static void sys_call_exec(PCB_t *pcb) {
     char filename[256];
     strcpy(filename, (char *)pcb->regs.ebx);
     _load_page_dir(PAGE_DIR_ADDR);
-    set_process_as_ready(pcb);
 
     pcb->regs.eax = 0;
     PCB_t *child = create_process(filename, pcb->pid, pcb->stdout, pcb->shell_id);
     if (child != NULL) {
+        fd_copy_table(child->process, pcb->process);
         pcb->regs.eax = child->pid;
         set_process_as_ready(child);
     }
     last_exit_code = pcb->regs.eax;
+
+    // another CPU may pick the process up as soon as it's ready,
+    // so all its registers must be set by then
+    set_process_as_ready(pcb);
 }
 
-static void sys_call_open(PCB_t *pcb) {
-    char *filename = (char *)pcb->regs.ebx;
-    if (file_exists(filename) == 0) {
-        pcb->regs.eax = 1;
-    } else {
-        pcb->regs.eax = open_file(filename);
-        if (pcb->regs.eax == 0) {
-            char *open_file = (char *) kmalloc(FILE_NAME_LEN);
-            strcpy(open_file, filename);
-            list_add_last(pcb->open_files, open_file);
-        }
+static uint32_t do_open(process_t *process, char *filename) {
+    if (file_exists(filename) == 0)
+        return 1;
+    uint32_t result = open_file(filename);
+    if (result == 0) {
+        char *open_file = (char *) kmalloc(strlen(filename) + 1);
+        strcpy(open_file, filename);
+        spinlock_acquire(&process->lock);
+        list_add_last(process->open_files, open_file);
+        spinlock_release(&process->lock);
     }
+    return result;
+}
+
+static void sys_call_open(PCB_t *pcb) {
+    pcb->regs.eax = do_open(pcb->process, (char *)pcb->regs.ebx);
     last_exit_code = pcb->regs.eax;
     set_process_as_ready(pcb);
 }
@@ -96,44 +118,59 @@ static void remove_filename(void *data) {
     kfree(data);
 }
 
-static void sys_call_close(PCB_t *pcb) {
-    char *filename = (char *)pcb->regs.ebx;
-    if (list_contains(pcb->open_files, filename, &filename_cmp) == 1) {
-        pcb->regs.eax = close_file(filename);
-        list_remove_data(pcb->open_files, filename, &remove_filename);
-    } else {
-        pcb->regs.eax = 1;
+static uint8_t is_file_open(process_t *process, char *filename) {
+    // the list of open files is shared by all threads of the process
+    spinlock_acquire(&process->lock);
+    uint8_t open = list_contains(process->open_files, filename, &filename_cmp);
+    spinlock_release(&process->lock);
+    return open;
+}
+
+static uint32_t do_close(process_t *process, char *filename) {
+    char *open_file = NULL;
+
+    // look up the copy of the filename stored when the file was opened
+    spinlock_acquire(&process->lock);
+    list_node_t *curr = process->open_files->first;
+    for (; curr != NULL && open_file == NULL; curr = curr->next) {
+        if (filename_cmp(filename, curr->data) == 1)
+            open_file = (char *)curr->data;
     }
+    if (open_file != NULL)
+        list_remove_data(process->open_files, open_file, &remove_filename);
+    spinlock_release(&process->lock);
+
+    if (open_file == NULL)
+        return 1;
+    return close_file(filename);
+}
+
+static void sys_call_close(PCB_t *pcb) {
+    pcb->regs.eax = do_close(pcb->process, (char *)pcb->regs.ebx);
     last_exit_code = pcb->regs.eax;
     set_process_as_ready(pcb);
 }
 
-static void sys_call_read(PCB_t *pcb) {
-    char *filename = (char *)pcb->regs.esi;
-    char *buffer = (char *)pcb->regs.ebx;
-    uint32_t offset = pcb->regs.ecx;
-    uint32_t len = pcb->regs.edx;
+static uint32_t do_read(process_t *process, char *filename, char *buffer, uint32_t offset, uint32_t len) {
+    if (file_exists(filename) == 0 || is_file_open(process, filename) == 0)
+        return 1;
+    return read(filename, buffer, offset, len);
+}
 
-    if (file_exists(filename) == 0 || list_contains(pcb->open_files, filename, &filename_cmp) == 0) {
-        pcb->regs.eax = 1;
-    } else {
-        pcb->regs.eax = read(filename, buffer, offset, len);
-    }
+static void sys_call_read(PCB_t *pcb) {
+    pcb->regs.eax = do_read(pcb->process, (char *)pcb->regs.esi, (char *)pcb->regs.ebx, pcb->regs.ecx, pcb->regs.edx);
     last_exit_code = pcb->regs.eax;
     set_process_as_ready(pcb);
 }
 
-static void sys_call_write(PCB_t *pcb) {
-    char *filename = (char *)pcb->regs.esi;
-    char *buffer = (char *)pcb->regs.ebx;
-    uint32_t offset = pcb->regs.ecx;
-    uint32_t len = pcb->regs.edx;
+static uint32_t do_write(process_t *process, char *filename, char *buffer, uint32_t offset, uint32_t len) {
+    if (file_exists(filename) == 0 || is_file_open(process, filename) == 0)
+        return 1;
+    return write(filename, buffer, offset, len);
+}
 
-    if (file_exists(filename) == 0 || list_contains(pcb->open_files, filename, &filename_cmp) == 0) {
-        pcb->regs.eax = 1;
-    } else {
-        pcb->regs.eax = write(filename, buffer, offset, len);
-    }
+static void sys_call_write(PCB_t *pcb) {
+    pcb->regs.eax = do_write(pcb->process, (char *)pcb->regs.esi, (char *)pcb->regs.ebx, pcb->regs.ecx, pcb->regs.edx);
     last_exit_code = pcb->regs.eax;
     set_process_as_ready(pcb);
 }
@@ -145,7 +182,8 @@ static void sys_call_touch(PCB_t *pcb) {
 }
 
 static void sys_call_ls(PCB_t *pcb) {
-    ls();
+    pcb->regs.eax = ls((char *)pcb->regs.ebx);
+    last_exit_code = pcb->regs.eax;
     set_process_as_ready(pcb);
 }
 
@@ -161,6 +199,27 @@ static void sys_call_cp(PCB_t *pcb) {
     set_process_as_ready(pcb);
 }
 
+static void sys_call_mkdir(PCB_t *pcb) {
+    pcb->regs.eax = mkdir((char *)pcb->regs.ebx);
+    last_exit_code = pcb->regs.eax;
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_rmdir(PCB_t *pcb) {
+    pcb->regs.eax = rmdir((char *)pcb->regs.ebx);
+    last_exit_code = pcb->regs.eax;
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_sync(PCB_t *pcb) {
+    pcb->regs.eax = fs_sync();
+    if (pcb->regs.eax == 0) {
+        kprintf("disk: ");
+        bcache_print_stats();
+    }
+    set_process_as_ready(pcb);
+}
+
 static void sys_call_rm(PCB_t *pcb) {
     pcb->regs.eax = rm((char *)pcb->regs.ebx);
     last_exit_code = pcb->regs.eax;
@@ -192,25 +251,74 @@ static void sys_call_exit_code(PCB_t *pcb) {
 }
 
 static void sys_call_wait(PCB_t *pcb) {
-    if (exists_process(pcb->regs.ebx) == 0) {
+    if (block_process_on_another_process(pcb, pcb->regs.ebx) != 0) {
         pcb->regs.eax = 1;
         last_exit_code = pcb->regs.eax;
         set_process_as_ready(pcb);
-    } else {
-        block_process_on_another_process(pcb);
     }
 }
 
+static void fault_in_user_buffer(process_t *process, uint32_t addr, uint32_t len) {
+    // the heap pages of the buffer get their frames up front (the pages outside the heap are always there)
+    uint32_t page;
+    for (page = addr & ~(FRAME_SIZE - 1); page < addr + len; page += FRAME_SIZE)
+        map_user_heap_page(process, page);
+}
+
 static void sys_call_read_line(PCB_t *pcb) {
-    block_process_on_keyboard(pcb);
+    uint8_t write_end;
+    pipe_t *pipe = fd_get_pipe(pcb->process, STDIN_FD, &write_end);
+    if (pipe == NULL) {
+        // the line is copied into the buffer by the keyboard interrupt on top of another
+        // process's address space, where a fault could not be resolved on our behalf
+        fault_in_user_buffer(pcb->process, pcb->regs.edi, KEYBOARD_BUFF_SIZE);
+        block_process_on_keyboard(pcb);
+        return;
+    }
+
+    // the input has been redirected from a pipe (1 = EOF)
+    pcb->regs.eax = 1;
+    if (write_end == 0)
+        pcb->regs.eax = pipe_read_line(pipe, (char *)pcb->regs.edi, KEYBOARD_BUFF_SIZE) == PIPE_EOF;
+    pipe_close_end(pipe, write_end);
+    set_process_as_ready(pcb);
+}
+
+static uint8_t copy_user_page(PCB_t *child, PCB_t *parent, uint32_t virtual_addr) {
+    // the page goes through a bounce buffer, as only one address space can be loaded at a time
+    scratch_mark_t mark = scratch_begin();
+    char *buff = (char *)scratch_alloc(FRAME_SIZE);
+    if (buff == NULL) {
+        scratch_end(mark);
+        return 1;
+    }
+    _load_page_dir(parent->regs.cr3);
+    memcpy(buff, (char *)virtual_addr, FRAME_SIZE);
+    _load_page_dir(child->regs.cr3);
+    memcpy((char *)virtual_addr, buff, FRAME_SIZE);
+    scratch_end(mark);
+    return 0;
+}
+
+static void fail_fork(PCB_t *parent, PCB_t *child) {
+    // the child has never run, it goes away along with the pages it has got so far
+    _load_page_dir(PAGE_DIR_ADDR);
+    if (child != NULL)
+        kill_process(child);
+    parent->regs.eax = (uint32_t)-1;
+    last_exit_code = parent->regs.eax;
+    set_process_as_ready(parent);
 }
 
 static void sys_call_fork(PCB_t *parent) {
     _load_page_dir(PAGE_DIR_ADDR);
     PCB_t *child = create_process(parent->name, parent->pid, parent->stdout, parent->shell_id);
+    if (child == NULL) {
+        fail_fork(parent, child);
+        return;
+    }
 
-    uint32_t i, j;
-    char *buff = (char *)kmalloc(FRAME_SIZE);
+    uint32_t i;
 
     // copy registers
     child->regs.ecx = parent->regs.ecx;
@@ -226,25 +334,29 @@ static void sys_call_fork(PCB_t *parent) {
     // copy stack
     uint32_t stack_addr = PAGE_TABLE_ADDR(PROCESS_STACK_PAGE_TABLE);
     for (i = 0; i < PAGE_TABLE_ENTRIES; i++) {
-        _load_page_dir(parent->regs.cr3);
-        memcpy(buff, (char *)(stack_addr + (i * FRAME_SIZE)), FRAME_SIZE);
-        _load_page_dir(child->regs.cr3);
-        memcpy((char *)(stack_addr + (i * FRAME_SIZE)), buff, FRAME_SIZE);
+        preempt_point();
+        if (copy_user_page(child, parent, stack_addr + (i * FRAME_SIZE)) != 0) {
+            fail_fork(parent, child);
+            return;
+        }
     }
 
-    // copy heap
+    // copy heap (only the pages the parent has touched so far have a frame)
     uint32_t heap_addr;
-    for (i = PROCESS_HEAP_START_PAGE_TABLE; i <= PROCESS_HEAP_END_PAGE_TABLE; i++) {
-        heap_addr = PAGE_TABLE_ADDR(i);
-        for (j = 0; j < PAGE_TABLE_ENTRIES; j++) {
-            _load_page_dir(parent->regs.cr3);
-            memcpy(buff, (char *)(heap_addr + (j * FRAME_SIZE)), FRAME_SIZE);
-            _load_page_dir(child->regs.cr3);
-            memcpy((char *)(heap_addr + (j * FRAME_SIZE)), buff, FRAME_SIZE);
+    child->process->brk = parent->process->brk;
+    for (heap_addr = PROCESS_HEAP_START_ADDR; heap_addr < child->process->brk; heap_addr += FRAME_SIZE) {
+        preempt_point();
+        _load_page_dir(PAGE_DIR_ADDR);
+        if (get_user_physical_addr(parent->process, heap_addr) == 0 || map_user_heap_page(child->process, heap_addr) != 0)
+            continue;
+        if (copy_user_page(child, parent, heap_addr) != 0) {
+            fail_fork(parent, child);
+            return;
         }
     }
 
-    kfree(buff);
+    FPU_copy_state(child, parent);
+    fd_copy_table(child->process, parent->process);
     parent->regs.eax = 1; // you're the parent
     child->regs.eax = 0;  // you're the child
 
@@ -253,18 +365,293 @@ static void sys_call_fork(PCB_t *parent) {
     set_process_as_ready(child);
 }
 
-static void sys_call_file_append(PCB_t *pcb) {
-    char *filename = (char *)pcb->regs.ebx;
-    char *buffer = (char *)pcb->regs.ecx;
-    uint32_t file_size = get_file_size(filename);
-    uint32_t buff_size = strlen(buffer);
+static void sys_call_thread_create(PCB_t *pcb) {
+    uint32_t entry = pcb->regs.ebx;
+    uint32_t fce = pcb->regs.ecx;
+    uint32_t arg = pcb->regs.edx;
+
+    // the stack of the new thread is set up through the shared address space
+    _load_page_dir(pcb->regs.cr3);
+    pcb->regs.eax = 0;
+    PCB_t *thread = create_user_thread(pcb, entry, fce, arg);
+    if (thread != NULL) {
+        pcb->regs.eax = thread->pid;
+        set_process_as_ready(thread);
+    }
+    last_exit_code = pcb->regs.eax;
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_thread_join(PCB_t *pcb) {
+    uint32_t tid = pcb->regs.ebx;
+
+    // only threads of the same process can be joined (they wake up their creator on exit)
+    if (tid == pcb->pid || is_thread_of(tid, pcb) == 0 || block_process_on_another_process(pcb, tid) != 0) {
+        pcb->regs.eax = 1;
+        last_exit_code = pcb->regs.eax;
+        set_process_as_ready(pcb);
+    }
+}
+
+static uint32_t get_futex_key(PCB_t *pcb, uint32_t addr) {
+    // futexes are identified by the physical address of the word, so they work
+    // no matter what (or how many) virtual addresses the word is mapped at
+    if (addr % sizeof(uint32_t) != 0 || addr >= PAGE_TABLE_ADDR(768))
+        return 0;
+    _load_page_dir(PAGE_DIR_ADDR);
+    uint32_t key = get_user_physical_addr(pcb->process, addr);
+    _load_page_dir(pcb->regs.cr3);
+    return key;
+}
+
+static void sys_call_futex_wait(PCB_t *pcb) {
+    uint32_t key = get_futex_key(pcb, pcb->regs.ebx);
+
+    // the thread may be resumed by another CPU as soon as it's been woken up
+    pcb->regs.eax = 0;
+    if (key == 0 || futex_block(pcb, key, (uint32_t *)pcb->regs.ebx, pcb->regs.ecx) != 0) {
+        pcb->regs.eax = 1;
+        set_process_as_ready(pcb);
+    }
+}
+
+static void sys_call_futex_wake(PCB_t *pcb) {
+    uint32_t key = get_futex_key(pcb, pcb->regs.ebx);
+    pcb->regs.eax = key == 0 ? 0 : futex_wake_up(key, pcb->regs.ecx);
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_pipe(PCB_t *pcb) {
+    int *fds = (int *)pcb->regs.ebx;
+    pcb->regs.eax = 1;
+
+    pipe_t *pipe = pipe_create();
+    if (pipe == NULL) {
+        set_process_as_ready(pcb);
+        return;
+    }
+    // the pipe goes away along with its last end, so hold it until both are installed
+    pipe_open_end(pipe, 0);
+    int read_fd = fd_install(pcb->process, pipe, 0);
+    int write_fd = fd_install(pcb->process, pipe, 1);
+    if (read_fd >= 0 && write_fd >= 0) {
+        fds[0] = read_fd;
+        fds[1] = write_fd;
+        pcb->regs.eax = 0;
+    } else {
+        if (read_fd >= 0)
+            fd_close(pcb->process, read_fd);
+        if (write_fd >= 0)
+            fd_close(pcb->process, write_fd);
+    }
+    pipe_close_end(pipe, 0);
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_fd_open(PCB_t *pcb) {
+    // the descriptor refers to an open file object holding the position within
+    // the file as well as where the file is, so reads and writes don't look it up again
+    pcb->regs.eax = (uint32_t)-1;
+    open_file_t *file = open_fd((char *)pcb->regs.ebx);
+    if (file != NULL && (pcb->regs.eax = fd_install_file(pcb->process, file)) == (uint32_t)-1)
+        close_fd(file);
+    set_process_as_ready(pcb);
+}
+
+static uint32_t do_fd_read(process_t *process, uint32_t fd, char *buffer, uint32_t len) {
+    uint8_t write_end;
+    uint32_t result = (uint32_t)-1;
+    open_file_t *file = fd_get_file(process, fd);
+    if (file != NULL) {
+        result = read_fd(file, buffer, len);
+        close_fd(file);
+        return result;
+    }
+    pipe_t *pipe = fd_get_pipe(process, fd, &write_end);
+    if (pipe != NULL) {
+        if (write_end == 0)
+            result = pipe_read(pipe, buffer, len);
+        pipe_close_end(pipe, write_end);
+    }
+    return result;
+}
+
+static void sys_call_fd_read(PCB_t *pcb) {
+    pcb->regs.eax = do_fd_read(pcb->process, pcb->regs.ebx, (char *)pcb->regs.ecx, pcb->regs.edx);
+    set_process_as_ready(pcb);
+}
+
+static uint32_t do_fd_write(process_t *process, uint32_t fd, char *buffer, uint32_t len) {
+    uint8_t write_end;
+    uint32_t result = (uint32_t)-1;
+    open_file_t *file = fd_get_file(process, fd);
+    if (file != NULL) {
+        result = write_fd(file, buffer, len);
+        close_fd(file);
+        return result;
+    }
+    pipe_t *pipe = fd_get_pipe(process, fd, &write_end);
+    if (pipe != NULL) {
+        if (write_end)
+            result = pipe_write(pipe, buffer, len);
+        pipe_close_end(pipe, write_end);
+    }
+    return result;
+}
+
+static void sys_call_fd_write(PCB_t *pcb) {
+    pcb->regs.eax = do_fd_write(pcb->process, pcb->regs.ebx, (char *)pcb->regs.ecx, pcb->regs.edx);
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_fd_close(PCB_t *pcb) {
+    pcb->regs.eax = fd_close(pcb->process, pcb->regs.ebx);
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_lseek(PCB_t *pcb) {
+    pcb->regs.eax = (uint32_t)-1;
+    open_file_t *file = fd_get_file(pcb->process, pcb->regs.ebx);
+    if (file != NULL) {
+        pcb->regs.eax = lseek(file, (int32_t)pcb->regs.ecx, pcb->regs.edx);
+        close_fd(file);
+    }
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_dup2(PCB_t *pcb) {
+    pcb->regs.eax = fd_dup2(pcb->process, pcb->regs.ebx, pcb->regs.ecx);
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_mq_open(PCB_t *pcb) {
+    pcb->regs.eax = mq_open((const char *)pcb->regs.ebx);
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_mq_send(PCB_t *pcb) {
+    pcb->regs.eax = mq_send(pcb->process, pcb->regs.ebx, (char *)pcb->regs.ecx, pcb->regs.edx);
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_mq_receive(PCB_t *pcb) {
+    pcb->regs.eax = mq_receive(pcb->process, pcb->regs.ebx, (char *)pcb->regs.ecx, pcb->regs.edx);
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_uptime(PCB_t *pcb) {
+    pcb->regs.eax = PIT_get_uptime_ms();
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_poll(PCB_t *pcb) {
+    pcb->regs.eax = poll(pcb, (poll_entry_t *)pcb->regs.ebx, pcb->regs.ecx, pcb->regs.edx);
+    set_process_as_ready(pcb);
+}
+
+static uint32_t do_file_append(char *filename, char *buffer, uint32_t len) {
     if (file_exists(filename) == 0)
         touch(filename);
-    pcb->regs.eax = write(filename, buffer, file_size, buff_size);
+    return write(filename, buffer, get_file_size(filename), len);
+}
+
+static void sys_call_file_append(PCB_t *pcb) {
+    char *buffer = (char *)pcb->regs.ecx;
+    pcb->regs.eax = do_file_append((char *)pcb->regs.ebx, buffer, strlen(buffer));
     last_exit_code = pcb->regs.eax;
     set_process_as_ready(pcb);
 }
 
+static uint32_t do_ring_op(PCB_t *pcb, ring_sqe_t *sqe) {
+    process_t *process = pcb->process;
+    char *filename = (char *)sqe->args[0];
+    uint32_t *args = sqe->args;
+
+    switch (sqe->op) {
+        case RING_OP_NOP:
+            return 0;
+        case RING_OP_OPEN:
+            return do_open(process, filename);
+        case RING_OP_CLOSE:
+            return do_close(process, filename);
+        case RING_OP_READ:
+            return do_read(process, filename, (char *)args[1], args[2], args[3]);
+        case RING_OP_WRITE:
+            return do_write(process, filename, (char *)args[1], args[2], args[3]);
+        case RING_OP_APPEND:
+            return do_file_append(filename, (char *)args[1], args[2]);
+        case RING_OP_FD_READ:
+            return do_fd_read(process, args[0], (char *)args[1], args[2]);
+        case RING_OP_FD_WRITE:
+            return do_fd_write(process, args[0], (char *)args[1], args[2]);
+        case RING_OP_MQ_SEND:
+            return mq_send(process, args[0], (char *)args[1], args[2]);
+        case RING_OP_MQ_RECEIVE:
+            return mq_receive(process, args[0], (char *)args[1], args[2]);
+    }
+    return RING_RESULT_INVALID;
+}
+
+static uint8_t may_block(uint32_t op) {
+    return op == RING_OP_FD_READ || op == RING_OP_FD_WRITE || op == RING_OP_MQ_SEND || op == RING_OP_MQ_RECEIVE;
+}
+
+uint32_t ring_drain(PCB_t *pcb, uint8_t can_block) {
+    process_t *process = pcb->process;
+    uint32_t completed = 0;
+
+    // the ring is consumed by one thread at a time (the others just find it empty)
+    if (process->ring == NULL || atomic_xchg(&process->ring_busy, 1) != 0)
+        return 0;
+
+    // the ring lives in the user memory, so the indices are not to be trusted - a bogus
+    // sq_tail just makes us go through (at most) RING_ENTRIES garbage entries
+    // (a killed thread leaves the rest of the entries to go away along with the process)
+    ring_t *ring = process->ring;
+    while (ring->sq_head != ring->sq_tail && completed < RING_ENTRIES &&
+           ring->cq_tail - ring->cq_head < RING_ENTRIES && pcb->pending_kill == 0) {
+        ring_sqe_t *sqe = &ring->sqes[ring->sq_head % RING_ENTRIES];
+
+        // the timer interrupt cannot put the process to sleep, so leave those for ring_enter()
+        if (can_block == 0 && may_block(sqe->op))
+            break;
+        ring_cqe_t *cqe = &ring->cqes[ring->cq_tail % RING_ENTRIES];
+        cqe->user_data = sqe->user_data;
+        cqe->result = do_ring_op(pcb, sqe);
+        ring->sq_head++;
+
+        // the process may see the completion as soon as cq_tail moves
+        __sync_synchronize();
+        ring->cq_tail++;
+        completed++;
+    }
+    process->ring_busy = 0;
+    return completed;
+}
+
+static void sys_call_ring_setup(PCB_t *pcb) {
+    uint32_t addr = pcb->regs.ebx;
+    pcb->regs.eax = 1;
+
+    // 0 detaches the ring from the process
+    if (addr == 0) {
+        pcb->process->ring = NULL;
+        pcb->regs.eax = 0;
+    } else if (addr % sizeof(uint32_t) == 0 && addr + sizeof(ring_t) > addr && addr + sizeof(ring_t) <= PAGE_TABLE_ADDR(768)) {
+        ring_t *ring = (ring_t *)addr;
+        ring->sq_head = ring->sq_tail = 0;
+        ring->cq_head = ring->cq_tail = 0;
+        pcb->process->ring = ring;
+        pcb->regs.eax = 0;
+    }
+    set_process_as_ready(pcb);
+}
+
+static void sys_call_ring_enter(PCB_t *pcb) {
+    pcb->regs.eax = ring_drain(pcb, 1);
+    set_process_as_ready(pcb);
+}
+
 static void sys_call_color_command(PCB_t *pcb) {
     if (pcb->shell_id == get_focused_terminal()){
         uint32_t foreground = pcb->regs.ebx;
@@ -310,12 +697,6 @@ void sys_callback() {
         case SYSCALL_READ_LINE:
             sys_call_read_line(pcb);
             break;
-        case SYSCALL_MALLOC:
-            sys_call_malloc(pcb);
-            break;
-        case SYSCALL_FREE:
-            sys_call_free(pcb);
-            break;
         case SYSCALL_PID:
             sys_call_pid(pcb);
             break;
@@ -379,6 +760,72 @@ void sys_callback() {
         case SYSCALL_SET_CURSOR:
             sys_call_set_cursor(pcb);
             break;
+        case SYSCALL_THREAD_CREATE:
+            sys_call_thread_create(pcb);
+            break;
+        case SYSCALL_THREAD_JOIN:
+            sys_call_thread_join(pcb);
+            break;
+        case SYSCALL_FUTEX_WAIT:
+            sys_call_futex_wait(pcb);
+            break;
+        case SYSCALL_FUTEX_WAKE:
+            sys_call_futex_wake(pcb);
+            break;
+        case SYSCALL_PIPE:
+            sys_call_pipe(pcb);
+            break;
+        case SYSCALL_FD_READ:
+            sys_call_fd_read(pcb);
+            break;
+        case SYSCALL_FD_WRITE:
+            sys_call_fd_write(pcb);
+            break;
+        case SYSCALL_FD_CLOSE:
+            sys_call_fd_close(pcb);
+            break;
+        case SYSCALL_DUP2:
+            sys_call_dup2(pcb);
+            break;
+        case SYSCALL_MQ_OPEN:
+            sys_call_mq_open(pcb);
+            break;
+        case SYSCALL_MQ_SEND:
+            sys_call_mq_send(pcb);
+            break;
+        case SYSCALL_MQ_RECEIVE:
+            sys_call_mq_receive(pcb);
+            break;
+        case SYSCALL_UPTIME:
+            sys_call_uptime(pcb);
+            break;
+        case SYSCALL_POLL:
+            sys_call_poll(pcb);
+            break;
+        case SYSCALL_RING_SETUP:
+            sys_call_ring_setup(pcb);
+            break;
+        case SYSCALL_RING_ENTER:
+            sys_call_ring_enter(pcb);
+            break;
+        case SYSCALL_BRK:
+            sys_call_brk(pcb);
+            break;
+        case SYSCALL_FD_OPEN:
+            sys_call_fd_open(pcb);
+            break;
+        case SYSCALL_LSEEK:
+            sys_call_lseek(pcb);
+            break;
+        case SYSCALL_MKDIR:
+            sys_call_mkdir(pcb);
+            break;
+        case SYSCALL_RMDIR:
+            sys_call_rmdir(pcb);
+            break;
+        case SYSCALL_SYNC:
+            sys_call_sync(pcb);
+            break;
         default:
             set_color(FOREGROUND_LIGHTRED);
             kprintf("ERR: Unknown system call %d\n\r", pcb->regs.eax);
@@ -1,51 +1,91 @@
 #include <processes/user_programs.h>
 #include <drivers/screen/screen.h>
 #include <string.h>
+#include <memory.h>
+#include <mem/paging.h>
 
-#include "../../userspace/programs/idle.bin.h"
-#include "../../userspace/programs/test_wait.bin.h"
-#include "../../userspace/programs/test_malloc.bin.h"
-#include "../../userspace/programs/test_fork.bin.h"
-#include "../../userspace/programs/shell.bin.h"
-#include "../../userspace/programs/calc.bin.h"
-#include "../../userspace/programs/ipcalc.bin.h"
-#include "../../userspace/programs/page_fault.bin.h"
-#include "../../userspace/programs/gpf.bin.h"
-#include "../../userspace/programs/zero.bin.h"
-#include "../../userspace/programs/yell_A.bin.h"
-#include "../../userspace/programs/yell_B.bin.h"
-#include "../../userspace/programs/par_demo.bin.h"
-#include "../../userspace/programs/par_demo2.bin.h"
-#include "../../userspace/programs/hanoi.bin.h"
-#include "../../userspace/programs/fibonacci.bin.h"
-#include "../../userspace/programs/rain.bin.h"
-
-static program_t programs[] = {
-    { "idle.exe",        (char *)idle_bin, idle_bin_len               },
-    { "test_fork.exe",   (char *)test_fork_bin, test_fork_bin_len     },
-    { "test_malloc.exe", (char *)test_malloc_bin, test_malloc_bin_len },
-    { "test_wait.exe",   (char *)test_wait_bin, test_wait_bin_len     },
-    { "shell.exe",       (char *)shell_bin, shell_bin_len             },
-    { "calc.exe",        (char *)calc_bin, calc_bin_len               },
-    { "ipcalc.exe",      (char *)ipcalc_bin, ipcalc_bin_len           },
-    { "page_fault.exe",  (char *)page_fault_bin, page_fault_bin_len   },
-    { "gpf.exe",         (char *)gpf_bin, gpf_bin_len                 },
-    { "zero.exe",        (char *)zero_bin, zero_bin_len               },
-    { "yell_A.exe",      (char *)yell_A_bin, yell_A_bin_len           },
-    { "yell_B.exe",      (char *)yell_B_bin, yell_B_bin_len           },
-    { "par_demo.exe",    (char *)par_demo_bin, par_demo_bin_len       },
-    { "par_demo2.exe",   (char *)par_demo2_bin, par_demo2_bin_len     },
-    { "hanoi.exe",       (char *)hanoi_bin, hanoi_bin_len             },
-    { "fibonacci.exe",   (char *)fibonacci_bin, fibonacci_bin_len     },
-    { "rain.exe",        (char *)rain_bin, rain_bin_len     },
-
-};
-
-static uint32_t program_count = sizeof(programs) / sizeof(program_t);
+// The programs come in a tar archive GRUB loads as a module right behind the kernel, so
+// a new program does not have to be linked into the kernel. The archive is left where it
+// is (the first 4MB are mapped into every address space) and the files are found through
+// a hash index on their names which is built once at boot.
 
-program_t *get_program(const char *name) {
+static program_t programs[MAX_PROGRAMS];
+static uint32_t program_count;
+static int32_t program_hash[PROGRAM_HASH_SIZE];
+static uint32_t initrd_addr;
+static uint32_t initrd_size;
+
+static uint32_t parse_octal(const char *field, uint32_t len) {
+    uint32_t value = 0;
     uint32_t i;
-    for (i = 0; i < program_count; i++) {
+    for (i = 0; i < len && field[i] >= '0' && field[i] <= '7'; i++)
+        value = value * 8 + (field[i] - '0');
+    return value;
+}
+
+static void add_program(const char *name, char *code, uint32_t size) {
+    // a file the archive holds twice is found by its last copy
+    if (program_count == MAX_PROGRAMS || strlen(name) >= PROGRAM_NAME_LEN)
+        return;
+    program_t *program = &programs[program_count];
+    strcpy(program->name, name);
+    program->code = code;
+    program->size = size;
+    uint32_t bucket = hash_string(name) & (PROGRAM_HASH_SIZE - 1);
+    program->hash_next = program_hash[bucket];
+    program_hash[bucket] = program_count++;
+}
+
+int load_initrd(multiboot_info_t *multiboot_info) {
+    // called before paging is set up, the module list is reached through the identity mapping
+    uint32_t i;
+    for (i = 0; i < PROGRAM_HASH_SIZE; i++)
+        program_hash[i] = -1;
+    if ((multiboot_info->flags & MULTIBOOT_INFO_MODS) == 0 || multiboot_info->mods_count == 0)
+        return 1;
+    multiboot_module_t *module = (multiboot_module_t *)multiboot_info->mods_addr;
+    if (module->mod_end > PAGE_TABLE_START_ADDR)
+        return 1;
+    initrd_addr = KERNEL_VIRTUAL_BASE + module->mod_start;
+    initrd_size = module->mod_end - module->mod_start;
+
+    // each file is a header block followed by its data (rounded up to whole blocks),
+    // the archive ends with an empty block
+    uint32_t offset = 0;
+    while (offset + TAR_BLOCK_SIZE <= initrd_size) {
+        tar_header_t *header = (tar_header_t *)(initrd_addr + offset);
+        if (header->name[0] == '\0' || memcmp(header->magic, TAR_MAGIC, strlen(TAR_MAGIC)) != 0)
+            break;
+        uint32_t size = parse_octal(header->size, sizeof(header->size));
+        offset += TAR_BLOCK_SIZE;
+        if (size > initrd_size - offset)
+            break;
+
+        char *name = header->name;
+        if (name[0] == '.' && name[1] == '/')
+            name += 2;
+        if (header->type == TAR_TYPE_FILE || header->type == '\0')
+            add_program(name, (char *)(initrd_addr + offset), size);
+        offset += (size + TAR_BLOCK_SIZE - 1) & ~(TAR_BLOCK_SIZE - 1);
+    }
+    return program_count == 0;
+}
+
+uint32_t get_initrd_addr() {
+    return initrd_addr;
+}
+
+uint32_t get_initrd_size() {
+    return initrd_size;
+}
+
+uint32_t get_program_count() {
+    return program_count;
+}
+
+program_t *get_program(const char *name) {
+    int32_t i;
+    for (i = program_hash[hash_string(name) & (PROGRAM_HASH_SIZE - 1)]; i != -1; i = programs[i].hash_next) {
         if (strcmp(name, programs[i].name) == 0)
             return &programs[i];
     }
@@ -57,4 +97,4 @@ void print_all_programs() {
     for (i = 0; i < program_count; i++) {
         kprintf("%s\n\r", programs[i].name);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,54 @@
+#include <processes/wait_queue.h>
+
+void wait_queue_init(wait_queue_t *queue) {
+    queue->first = NULL;
+    queue->last = NULL;
+}
+
+void wait_queue_push(wait_queue_t *queue, wait_queue_node_t *node) {
+    node->next = NULL;
+    node->prev = queue->last;
+    node->queue = queue;
+    if (queue->last != NULL)
+        queue->last->next = node;
+    else
+        queue->first = node;
+    queue->last = node;
+}
+
+void wait_queue_insert_before(wait_queue_t *queue, wait_queue_node_t *node, wait_queue_node_t *next) {
+    if (next == NULL) {
+        wait_queue_push(queue, node);
+        return;
+    }
+    node->next = next;
+    node->prev = next->prev;
+    node->queue = queue;
+    if (next->prev != NULL)
+        next->prev->next = node;
+    else
+        queue->first = node;
+    next->prev = node;
+}
+
+wait_queue_node_t *wait_queue_pop(wait_queue_t *queue) {
+    wait_queue_node_t *node = queue->first;
+    if (node != NULL)
+        wait_queue_remove(node);
+    return node;
+}
+
+void wait_queue_remove(wait_queue_node_t *node) {
+    wait_queue_t *queue = node->queue;
+    if (node->prev != NULL)
+        node->prev->next = node->next;
+    else
+        queue->first = node->next;
+    if (node->next != NULL)
+        node->next->prev = node->prev;
+    else
+        queue->last = node->prev;
+    node->next = NULL;
+    node->prev = NULL;
+    node->queue = NULL;
+}
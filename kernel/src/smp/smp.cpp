@@ -0,0 +1,264 @@
+#include <smp/smp.h>
+#include <drivers/apic/apic.h>
+#include <drivers/pit/pit.h>
+#include <processes/scheduler.h>
+#include <interrupts/idt.h>
+#include <mem/gdt.h>
+#include <mem/heap.h>
+#include <fpu/fpu.h>
+#include <common.h>
+#include <memory.h>
+#include <string.h>
+
+extern "C" {
+    void _ap_trampoline_start();
+    void _ap_trampoline_end();
+    uint32_t _ap_trampoline_stack;
+    uint32_t _ap_trampoline_cpu_index;
+    uint32_t _kernel_stack_top;
+    uint32_t _kernel_virtual_end;
+    void _ap_main(uint32_t cpu_index);
+}
+
+static cpu_t cpus[MAX_CPUS];
+static uint32_t cpu_count = 1;
+
+// translates the ID of a local APIC to the index of the CPU
+static uint8_t lapic_id_to_cpu[256];
+
+// set once the local APIC of the BSP has been mapped (until then, there's only the BSP)
+static uint8_t smp_active;
+
+// set by the BSP once the scheduler is ready to be used by the APs
+static volatile uint8_t aps_released;
+
+static uint8_t checksum(uint8_t *addr, uint32_t len) {
+    uint8_t sum = 0;
+    uint32_t i;
+    for (i = 0; i < len; i++)
+        sum += addr[i];
+    return sum;
+}
+
+static mp_floating_pointer_t *find_mp_floating_pointer(uint32_t start, uint32_t end) {
+    // the structure is always aligned to 16B
+    uint32_t addr;
+    for (addr = start; addr + sizeof(mp_floating_pointer_t) <= end; addr += 16) {
+        mp_floating_pointer_t *mp = reinterpret_cast<mp_floating_pointer_t *>(addr);
+        if (memcmp(mp->signature, MP_FLOATING_POINTER_SIGNATURE, 4) == 0 && checksum((uint8_t *)mp, mp->length * 16) == 0)
+            return mp;
+    }
+    return NULL;
+}
+
+static mp_config_table_t *find_mp_config_table() {
+    // look for the floating pointer in the first 1KB of the EBDA,
+    // and then in the BIOS ROM (the first 1MB is identity-mapped)
+    uint32_t ebda = (*reinterpret_cast<uint16_t *>(BIOS_EBDA_SEGMENT_PTR)) << 4;
+    mp_floating_pointer_t *mp = NULL;
+    if (ebda != 0)
+        mp = find_mp_floating_pointer(ebda, ebda + 1024);
+    if (mp == NULL)
+        mp = find_mp_floating_pointer(BIOS_ROM_START, BIOS_ROM_END);
+
+    // we only support the configuration table being within the identity-mapped first 4MB
+    if (mp == NULL || mp->config_table == 0 || mp->config_table >= PAGE_TABLE_START_ADDR)
+        return NULL;
+
+    mp_config_table_t *config = reinterpret_cast<mp_config_table_t *>(mp->config_table);
+    if (memcmp(config->signature, MP_CONFIG_TABLE_SIGNATURE, 4) != 0 || checksum((uint8_t *)config, config->length) != 0)
+        return NULL;
+    return config;
+}
+
+static void add_cpu(uint32_t lapic_id) {
+    if (cpu_count == MAX_CPUS)
+        return;
+    cpus[cpu_count].index = cpu_count;
+    cpus[cpu_count].lapic_id = lapic_id;
+    lapic_id_to_cpu[lapic_id & 0xFF] = cpu_count;
+    cpu_count++;
+}
+
+static void parse_mp_config_table(mp_config_table_t *config) {
+    uint8_t *entry = reinterpret_cast<uint8_t *>(config) + sizeof(mp_config_table_t);
+    uint32_t i;
+
+    // only processor entries are 20B long, all the other ones are 8B long
+    for (i = 0; i < config->entry_count; i++) {
+        if (*entry == MP_ENTRY_PROCESSOR) {
+            mp_processor_entry_t *processor = reinterpret_cast<mp_processor_entry_t *>(entry);
+            if ((processor->flags & MP_PROCESSOR_ENABLED) && processor->lapic_id != cpus[BSP_INDEX].lapic_id)
+                add_cpu(processor->lapic_id);
+            entry += sizeof(mp_processor_entry_t);
+        } else {
+            entry += 8;
+        }
+    }
+}
+
+static uint8_t start_AP(cpu_t *cpu) {
+    // every AP gets its own kernel stack (it's used as TSS.ESP0 as well)
+    uint8_t *stack = (uint8_t *)kmalloc(CPU_KERNEL_STACK_SIZE);
+    if (stack == NULL)
+        return 1;
+    cpu->kernel_stack_top = (uint32_t)stack + CPU_KERNEL_STACK_SIZE - sizeof(uint32_t);
+    if (scratch_init(&cpu->scratch) != 0)
+        return 1;
+
+    // fill in the data of the trampoline (within its copy in the low memory)
+    uint32_t trampoline_start = (uint32_t)&_ap_trampoline_start;
+    *reinterpret_cast<uint32_t *>(AP_TRAMPOLINE_ADDR + ((uint32_t)&_ap_trampoline_stack - trampoline_start)) = cpu->kernel_stack_top;
+    *reinterpret_cast<uint32_t *>(AP_TRAMPOLINE_ADDR + ((uint32_t)&_ap_trampoline_cpu_index - trampoline_start)) = cpu->index;
+
+    // INIT-SIPI-SIPI sequence as described in the Intel MP specification
+    LAPIC_send_INIT(cpu->lapic_id);
+    PIT_wait(10000);
+    LAPIC_send_SIPI(cpu->lapic_id, AP_TRAMPOLINE_VECTOR);
+    PIT_wait(200);
+    if (cpu->online == 0)
+        LAPIC_send_SIPI(cpu->lapic_id, AP_TRAMPOLINE_VECTOR);
+
+    // wait until the AP lets us know it's up and running
+    uint32_t waited;
+    for (waited = 0; waited < AP_STARTUP_TIMEOUT_US && cpu->online == 0; waited += 1000)
+        PIT_wait(1000);
+    return cpu->online == 0;
+}
+
+int SMP_init() {
+    cpus[BSP_INDEX].index = BSP_INDEX;
+    cpus[BSP_INDEX].online = 1;
+    cpus[BSP_INDEX].kernel_stack_top = (uint32_t)&_kernel_stack_top - 1;
+    if (scratch_init(&cpus[BSP_INDEX].scratch) != 0)
+        return 1;
+
+    // if there's no MP configuration table, we'll just run on the BSP
+    mp_config_table_t *config = find_mp_config_table();
+    if (config == NULL)
+        return 0;
+
+    // the registers of the local APIC are mapped onto the very last page of the
+    // kernel's 4MB, so make sure the kernel itself doesn't reach up there
+    if ((uint32_t)&_kernel_virtual_end > LAPIC_VIRT_ADDR)
+        return 0;
+
+    if (LAPIC_init(config->lapic_addr != 0 ? config->lapic_addr : LAPIC_DEFAULT_PHYS_ADDR) != 0)
+        return 0;
+    cpus[BSP_INDEX].lapic_id = LAPIC_get_id();
+    lapic_id_to_cpu[cpus[BSP_INDEX].lapic_id & 0xFF] = BSP_INDEX;
+    smp_active = 1;
+
+    parse_mp_config_table(config);
+
+    // copy the trampoline into the low memory and start up all APs one by one
+    memcpy((void *)AP_TRAMPOLINE_ADDR, (void *)&_ap_trampoline_start,
+           (uint32_t)&_ap_trampoline_end - (uint32_t)&_ap_trampoline_start);
+
+    uint32_t i;
+    uint32_t detected = cpu_count;
+    cpu_count = 1;
+    for (i = 1; i < detected; i++) {
+        // keep the CPUs which did not start up out of the array
+        cpus[cpu_count] = cpus[i];
+        cpus[cpu_count].index = cpu_count;
+        lapic_id_to_cpu[cpus[i].lapic_id & 0xFF] = cpu_count;
+        if (start_AP(&cpus[cpu_count]) == 0)
+            cpu_count++;
+    }
+    return 0;
+}
+
+void SMP_release_APs() {
+    aps_released = 1;
+}
+
+extern "C" void _ap_main(uint32_t cpu_index) {
+    cpu_t *cpu = &cpus[cpu_index];
+
+    // set up the CPU the same way the BSP has been set up
+    GDT_init_cpu(cpu_index, cpu->kernel_stack_top);
+    IDT_load();
+    FPU_init();
+    LAPIC_enable();
+    cpu->online = 1;
+
+    // wait until the BSP has created the idle processes and the run queues
+    while (aps_released == 0)
+        _pause();
+
+    LAPIC_timer_init();
+    switch_to_next_process();
+}
+
+cpu_t *get_cpu() {
+    if (smp_active == 0)
+        return &cpus[BSP_INDEX];
+    return &cpus[lapic_id_to_cpu[LAPIC_get_id() & 0xFF]];
+}
+
+cpu_t *get_cpu_by_index(uint32_t index) {
+    return &cpus[index];
+}
+
+uint32_t get_cpu_count() {
+    return cpu_count;
+}
+
+void wait_until_address_space_unused(uint32_t cr3) {
+    // another CPU may still be on its way out of the address space
+    // (e.g. it has just blocked the process and is picking another one)
+    cpu_t *cpu = get_cpu();
+    uint32_t i;
+    for (i = 0; i < cpu_count; i++) {
+        if (&cpus[i] == cpu)
+            continue;
+        while (cpus[i].cr3 == cr3)
+            _pause();
+    }
+}
+
+void SMP_handle_tlb_flush() {
+    cpu_t *cpu = get_cpu();
+    uint32_t requests = cpu->tlb_flush_requests;
+
+    // reloading CR3 drops all (non-global) entries, so a single
+    // flush takes care of all the requests made so far
+    if (requests != cpu->tlb_flush_done) {
+        _load_page_dir(_get_page_dir());
+        cpu->tlb_flush_done = requests;
+    }
+}
+
+void SMP_flush_tlb(uint32_t cr3, uint32_t virtual_addr) {
+    cpu_t *cpu = get_cpu();
+    uint32_t tickets[MAX_CPUS];
+    uint32_t i;
+
+    _flush_tlb(virtual_addr);
+    if (smp_active == 0)
+        return;
+
+    // the new mapping must be visible before we check who may still be caching
+    // the old one (a CPU loading cr3 from now on is going to see the new one)
+    __sync_synchronize();
+    for (i = 0; i < cpu_count; i++) {
+        tickets[i] = 0;
+        if (&cpus[i] == cpu || (cr3 != SMP_ALL_ADDRESS_SPACES && cpus[i].cr3 != cr3))
+            continue;
+        tickets[i] = atomic_add(&cpus[i].tlb_flush_requests, 1) + 1;
+        LAPIC_send_IPI(cpus[i].lapic_id, LAPIC_TLB_FLUSH_VECTOR);
+    }
+
+    // the other CPUs take the IPI only once they've enabled interrupts, they may as well
+    // be waiting for us to flush the TLB, so keep handling our own requests meanwhile
+    // (the caller must not hold any locks, the other CPUs could be spinning on them)
+    for (i = 0; i < cpu_count; i++) {
+        if (tickets[i] == 0)
+            continue;
+        while ((int32_t)(cpus[i].tlb_flush_done - tickets[i]) < 0) {
+            SMP_handle_tlb_flush();
+            _pause();
+        }
+    }
+}
@@ -0,0 +1,87 @@
+; https://wiki.osdev.org/Symmetric_Multiprocessing#AP_startup
+; https://wiki.osdev.org/Protected_Mode
+;
+; The code between _ap_trampoline_start and _ap_trampoline_end is copied to
+; AP_TRAMPOLINE_ADDR (smp.h) by the BSP. An AP starts executing it in real mode
+; once it receives the STARTUP IPI, so all addresses must be calculated relative
+; to the start of the trampoline rather than to where the kernel was linked.
+;----------------------------------------------------------
+;            ELSEWHERE DEFINED FUNCTIONS
+;----------------------------------------------------------
+extern _ap_main                                             ; the c++ entry point of an AP (smp.cpp)
+;----------------------------------------------------------
+;                     CONSTANTS
+;----------------------------------------------------------
+TRAMPOLINE_ADDR     equ 0x8000                              ; must match AP_TRAMPOLINE_ADDR in smp.h
+PG_DIR_ADDR         equ 0x9A000                             ; page directory of the kernel (loader.asm)
+CR0_PE_BIT          equ (1 << 0)                            ; bit in CR0 to enable protected mode
+CR0_PG_BIT          equ (1 << 31)                           ; bit in CR0 to enable paging
+
+%define REL(label) ((label) - _ap_trampoline_start)         ; offset within the trampoline (real mode, CS = TRAMPOLINE_ADDR >> 4)
+%define ABS(label) (TRAMPOLINE_ADDR + REL(label))           ; physical address of the copy of the trampoline
+;----------------------------------------------------------
+;              REAL MODE (16 BIT) PART
+;----------------------------------------------------------
+section .text
+[bits 16]
+global _ap_trampoline_start
+_ap_trampoline_start:
+    cli                                                     ; the AP must not be interrupted until it's set up
+    cld
+    mov     ax, cs                                          ; CS = TRAMPOLINE_ADDR >> 4, so use it as the data segment as well
+    mov     ds, ax
+    lgdt    [REL(ap_gdt_desc)]                              ; load a temporary flat GDT
+
+    mov     eax, cr0                                        ; enable protected mode
+    or      eax, CR0_PE_BIT
+    mov     cr0, eax
+    jmp     dword 0x08:ABS(ap_protected_mode)               ; far jump to load CS with the 32bit code segment
+;----------------------------------------------------------
+;            PROTECTED MODE (32 BIT) PART
+;----------------------------------------------------------
+[bits 32]
+ap_protected_mode:
+    mov     ax, 0x10                                        ; KERNEL_DATA_SEG
+    mov     ds, ax
+    mov     es, ax
+    mov     fs, ax
+    mov     gs, ax
+    mov     ss, ax
+
+    mov     eax, PG_DIR_ADDR                                ; use the kernel page directory (the same one the BSP uses)
+    mov     cr3, eax
+    mov     eax, cr0                                        ; enable paging
+    or      eax, CR0_PG_BIT
+    mov     cr0, eax
+
+    mov     esp, [ABS(_ap_trampoline_stack)]                ; switch to the kernel stack prepared by the BSP
+    push    dword [ABS(_ap_trampoline_cpu_index)]           ; pass the index of the CPU to the c++ code
+    mov     eax, _ap_main                                   ; jump to the higher-half
+    call    eax
+ap_halt:
+    cli                                                     ; the AP should never get here
+    hlt
+    jmp     ap_halt
+;----------------------------------------------------------
+;       TEMPORARY GDT (THE SAME LAYOUT AS IN gdt.cpp)
+;----------------------------------------------------------
+align 8
+ap_gdt:
+    dq 0x0000000000000000                                   ; NULL descriptor
+    dq 0x00CF9A000000FFFF                                   ; 0x08 - kernel code (4GB, ring 0)
+    dq 0x00CF92000000FFFF                                   ; 0x10 - kernel data (4GB, ring 0)
+ap_gdt_desc:
+    dw (ap_gdt_desc - ap_gdt - 1)                           ; size of the GDT
+    dd ABS(ap_gdt)                                          ; physical address of the GDT
+;----------------------------------------------------------
+;            DATA FILLED IN BY THE BSP
+;----------------------------------------------------------
+align 4
+global _ap_trampoline_stack
+_ap_trampoline_stack:
+    dd 0                                                    ; top of the kernel stack of the AP
+global _ap_trampoline_cpu_index
+_ap_trampoline_cpu_index:
+    dd 0                                                    ; index of the AP (cpu_t)
+global _ap_trampoline_end
+_ap_trampoline_end:
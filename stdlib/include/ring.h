@@ -0,0 +1,51 @@
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <stdint.h>
+
+// Submission/completion ring shared by a process and the kernel (https://kernel.dk/io_uring.pdf).
+// The process queues up operations at sq_tail, the kernel consumes them from sq_head and posts
+// their results at cq_tail. It does so on ring_enter(), or on the next timer tick if the process
+// is running at the time (the tick only gets through the file operations - the rest may block).
+
+#define RING_ENTRIES 64 // must be a power of two
+
+#define RING_OP_NOP        0
+#define RING_OP_OPEN       1 // arg0 = filename
+#define RING_OP_CLOSE      2 // arg0 = filename
+#define RING_OP_READ       3 // arg0 = filename, arg1 = buffer, arg2 = offset, arg3 = length
+#define RING_OP_WRITE      4 // arg0 = filename, arg1 = buffer, arg2 = offset, arg3 = length
+#define RING_OP_APPEND     5 // arg0 = filename, arg1 = buffer, arg2 = length
+#define RING_OP_FD_READ    6 // arg0 = fd, arg1 = buffer, arg2 = length
+#define RING_OP_FD_WRITE   7 // arg0 = fd, arg1 = buffer, arg2 = length
+#define RING_OP_MQ_SEND    8 // arg0 = queue, arg1 = buffer, arg2 = length
+#define RING_OP_MQ_RECEIVE 9 // arg0 = queue, arg1 = buffer, arg2 = size of the buffer
+
+#define RING_RESULT_INVALID 0xFFFFFFFF // unknown operation
+
+typedef struct {
+    uint32_t op;
+    uint32_t user_data;   // passed on to the completion
+    uint32_t args[4];
+} ring_sqe_t;
+
+typedef struct {
+    uint32_t user_data;
+    uint32_t result;      // the same as the corresponding system call would return
+} ring_cqe_t;
+
+typedef struct {
+    volatile uint32_t sq_head; // written by the kernel
+    volatile uint32_t sq_tail; // written by the process
+    volatile uint32_t cq_head; // written by the process
+    volatile uint32_t cq_tail; // written by the kernel
+    ring_sqe_t sqes[RING_ENTRIES];
+    ring_cqe_t cqes[RING_ENTRIES];
+} ring_t;
+
+ring_sqe_t *ring_get_sqe(ring_t *ring);
+void ring_submit(ring_t *ring);
+ring_cqe_t *ring_peek_cqe(ring_t *ring);
+void ring_cqe_seen(ring_t *ring);
+
+#endif
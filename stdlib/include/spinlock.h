@@ -9,6 +9,11 @@ extern "C" {
     void spinlock_init(spinlock_t *lock);
     void spinlock_acquire(spinlock_t *lock);
     void spinlock_release(spinlock_t *lock);
+
+    // all of them return the previous value
+    unsigned int atomic_cmpxchg(volatile unsigned int *addr, unsigned int expected, unsigned int desired);
+    unsigned int atomic_xchg(volatile unsigned int *addr, unsigned int value);
+    unsigned int atomic_add(volatile unsigned int *addr, unsigned int value);
 }
 
 #endif
\ No newline at end of file
@@ -8,6 +8,7 @@
 uint32_t strlen(const char *str);
 uint32_t strcmp(const char* str1, const char* str2);
 uint32_t strcmp(const char* str1, const char* str2, uint32_t n);
+uint32_t hash_string(const char *str);
 char* strcpy(char* dest, const char* src);
 char* strncpy(char* dest, const char* src, uint32_t n);
 char* reverse(char* str);
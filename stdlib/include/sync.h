@@ -0,0 +1,47 @@
+#ifndef _SYNC_H_
+#define _SYNC_H_
+
+#include <stdint.h>
+
+// Blocking synchronization primitives built on top of futexes.
+// They only enter the kernel if a thread actually has to wait
+// (or there is a waiting thread to be woken up).
+
+#define MUTEX_UNLOCKED  0
+#define MUTEX_LOCKED    1
+#define MUTEX_CONTENDED 2 // locked, and there may be threads waiting for it
+
+#define MUTEX_INITIALIZER      { MUTEX_UNLOCKED }
+#define CONDVAR_INITIALIZER    { 0, 0 }
+#define SEMAPHORE_INITIALIZER(value) { (value), 0 }
+
+typedef struct {
+    volatile uint32_t state;
+} mutex_t;
+
+typedef struct {
+    volatile uint32_t seq;     // bumped by every signal
+    volatile uint32_t waiters;
+} condvar_t;
+
+typedef struct {
+    volatile uint32_t value;
+    volatile uint32_t waiters;
+} semaphore_t;
+
+void mutex_init(mutex_t *mutex);
+void mutex_lock(mutex_t *mutex);
+int mutex_trylock(mutex_t *mutex);
+void mutex_unlock(mutex_t *mutex);
+
+void condvar_init(condvar_t *cond);
+void condvar_wait(condvar_t *cond, mutex_t *mutex);
+void condvar_signal(condvar_t *cond);
+void condvar_broadcast(condvar_t *cond);
+
+void semaphore_init(semaphore_t *sem, uint32_t value);
+void semaphore_wait(semaphore_t *sem);
+int semaphore_trywait(semaphore_t *sem);
+void semaphore_post(semaphore_t *sem);
+
+#endif
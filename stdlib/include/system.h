@@ -2,15 +2,40 @@
 #define _SYSTEM_H_
 
 #include <stdint.h>
+#include <ring.h>
 
 #define PRINT_BUFF_SIZE 256
 
+#define STDIN  0
+#define STDOUT 1
+
+#define SEEK_SET 0               // lseek() offset from the start of the file
+#define SEEK_CUR 1               // from the current position
+#define SEEK_END 2               // from the end of the file
+
+#define POLL_KEYBOARD 1          // a line of input is available (id is not used)
+#define POLL_CHILD    2          // the process whose pid is id has terminated
+#define POLL_PIPE     3          // fd id can be read from/written into without blocking
+#define POLL_MQ       4          // message queue id holds a message
+#define POLL_INVALID  2          // value of ready if the entry is not valid
+#define POLL_INFINITE 0xFFFFFFFF // no timeout
+
+typedef struct {
+    uint32_t type;
+    uint32_t id;
+    uint32_t ready;              // set by poll()
+} poll_entry_t;
+
 void printf(const char *str, ...);
 
 extern "C" {
     void exit(int exit_code);
     void *malloc(uint32_t size);
     void free(void *addr);
+    void *realloc(void *addr, uint32_t size);
+    void *calloc(uint32_t count, uint32_t size);
+    uint32_t brk(uint32_t addr);
+    void *sbrk(int32_t increment);
     int get_pid();
     int get_ppid();
     int exec(const char *program);
@@ -19,9 +44,12 @@ extern "C" {
     int read(char *filename, char *buffer, uint32_t offset, uint32_t len);
     int write(char *filename, char *buffer, uint32_t offset, uint32_t len);
     int touch(const char *filename);
-    void ls();
+    int ls(const char *path);
     int cat(const char *filename);
     int rm(const char *filename);
+    int mkdir(const char *path);
+    int rmdir(const char *path);
+    int sync();
     int cp(const char *filename1 , const char *filename2);
     void ps();
     void lp();
@@ -29,11 +57,30 @@ extern "C" {
     int wait_for_child(int pid);
     int get_last_process_return_value();
     void clear_screen_command();
-    void read_line(char *buffer);
+    int read_line(char *buffer);
     void file_append(char *filename, char *buffer);
     void color_screen_command(uint32_t foreground, uint32_t background);
     void color_screen_command(uint32_t foreground, uint32_t background);
     void set_cursor_command(uint32_t xAxis, uint32_t yAxis);
+    int thread_create(void (*fce)(void *arg), void *arg);
+    int thread_join(int tid);
+    int futex_wait(volatile uint32_t *addr, uint32_t expected);
+    int futex_wake(volatile uint32_t *addr, uint32_t count);
+    int pipe(int fds[2]);
+    int fd_read(int fd, char *buffer, uint32_t len);
+    int fd_write(int fd, char *buffer, uint32_t len);
+    int fd_close(int fd);
+    int dup2(int old_fd, int new_fd);
+    int fd_open(const char *filename);
+    int lseek(int fd, int32_t offset, uint32_t whence);
+    int mq_open(const char *name);
+    int mq_send(int mq, void *buffer, uint32_t len);
+    int mq_receive(int mq, void *buffer, uint32_t max_len);
+    uint32_t uptime();
+    int poll(poll_entry_t *entries, uint32_t count, uint32_t timeout_ms);
+    void sleep(uint32_t ms);
+    int ring_setup(ring_t *ring);
+    uint32_t ring_enter();
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,289 @@
+#include <system.h>
+#include <sync.h>
+#include <memory.h>
+
+// Userspace allocator on top of brk(). Small blocks are rounded up to a size class
+// and recycled through a free list of their class, so most of malloc()/free() calls
+// never leave ring 3. Bigger blocks are taken first-fit from a list of free large
+// blocks which is kept sorted by address, so the neighbours can be merged together.
+
+#define ALIGNMENT       8
+#define SIZE_CLASSES    8                                       // 16B, 32B, ..., 2KB
+#define MIN_CLASS_SIZE  16
+#define MAX_SMALL_SIZE  (MIN_CLASS_SIZE << (SIZE_CLASSES - 1))
+#define LARGE_CLASS     SIZE_CLASSES
+#define CHUNK_SIZE      (64 * 1024)                             // the heap grows by at least this much at a time
+#define TRIM_THRESHOLD  (256 * 1024)                            // free memory at the end of the heap given back to the kernel
+#define PAGE_SIZE       4096
+
+typedef struct {
+    uint32_t size;                  // usable size of the block
+    uint32_t size_class;            // LARGE_CLASS if it's a large block
+} block_header_t;                   // 8B, so the blocks stay aligned
+
+typedef struct free_block {
+    struct free_block *next;
+} free_block_t;
+
+typedef struct large_block {
+    block_header_t header;
+    struct large_block *next;       // the next free large block (higher address)
+} large_block_t;
+
+typedef struct {
+    mutex_t lock;
+    free_block_t *free_lists[SIZE_CLASSES];
+    large_block_t *large_blocks;
+    uint32_t chunk;                 // rest of the last chunk of the heap, small blocks are carved out of it
+    uint32_t chunk_end;
+    uint32_t heap_end;              // the break as of the last time the allocator moved it
+} malloc_state_t;
+
+// only the initialized data of a program get mapped, so keep the state out of .bss
+static malloc_state_t state __attribute__((section(".data")));
+
+void *sbrk(int32_t increment) {
+    uint32_t old_brk = brk(0);
+    if (increment == 0)
+        return (void *)old_brk;
+    if (brk(old_brk + increment) != old_brk + increment)
+        return (void *)-1;
+    return (void *)old_brk;
+}
+
+static uint32_t get_size_class(uint32_t size) {
+    uint32_t size_class = 0;
+    uint32_t class_size = MIN_CLASS_SIZE;
+    while (class_size < size) {
+        class_size <<= 1;
+        size_class++;
+    }
+    return size_class;
+}
+
+static uint32_t grow_heap(uint32_t size) {
+    // returns the start of the new memory, or 0 if the heap cannot grow anymore
+    // (the break is not cached, the program may have moved it with sbrk() itself)
+    size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint32_t start = brk(0);
+    if (brk(start + size) != start + size)
+        return 0;
+    state.heap_end = start + size;
+    return start;
+}
+
+static uint32_t block_end(large_block_t *block) {
+    return (uint32_t)block + sizeof(block_header_t) + block->header.size;
+}
+
+static void insert_large_block(large_block_t *block) {
+    large_block_t *prev = NULL;
+    large_block_t *next = state.large_blocks;
+    while (next != NULL && next < block) {
+        prev = next;
+        next = next->next;
+    }
+
+    // merge the block with its neighbours if they're free as well
+    if (next != NULL && block_end(block) == (uint32_t)next) {
+        block->header.size += sizeof(block_header_t) + next->header.size;
+        next = next->next;
+    }
+    block->next = next;
+    if (prev != NULL && block_end(prev) == (uint32_t)block) {
+        prev->header.size += sizeof(block_header_t) + block->header.size;
+        prev->next = next;
+    } else if (prev != NULL) {
+        prev->next = block;
+    } else {
+        state.large_blocks = block;
+    }
+}
+
+static void trim_heap() {
+    // give the end of the heap back once there's plenty of free memory there
+    large_block_t *block = state.large_blocks;
+    while (block != NULL && block->next != NULL)
+        block = block->next;
+    if (block == NULL || block_end(block) != state.heap_end || block->header.size < TRIM_THRESHOLD || brk(0) != state.heap_end)
+        return;
+
+    uint32_t new_end = ((uint32_t)block + sizeof(large_block_t) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (brk(new_end) == new_end) {
+        block->header.size = new_end - (uint32_t)block - sizeof(block_header_t);
+        state.heap_end = new_end;
+    }
+}
+
+static void *malloc_small(uint32_t size_class) {
+    free_block_t *block = state.free_lists[size_class];
+    if (block != NULL) {
+        state.free_lists[size_class] = block->next;
+        return block;
+    }
+
+    // carve a new block out of the current chunk (the rest of the old one is left unused)
+    uint32_t block_size = sizeof(block_header_t) + (MIN_CLASS_SIZE << size_class);
+    if (state.chunk + block_size > state.chunk_end) {
+        uint32_t chunk = grow_heap(CHUNK_SIZE);
+        if (chunk == 0)
+            return NULL;
+        state.chunk = chunk;
+        state.chunk_end = chunk + CHUNK_SIZE;
+    }
+    block_header_t *header = (block_header_t *)state.chunk;
+    header->size = MIN_CLASS_SIZE << size_class;
+    header->size_class = size_class;
+    state.chunk += block_size;
+    return header + 1;
+}
+
+static large_block_t *find_large_block(uint32_t size) {
+    large_block_t *prev = NULL;
+    large_block_t *block = state.large_blocks;
+    while (block != NULL && block->header.size < size) {
+        prev = block;
+        block = block->next;
+    }
+    if (block == NULL)
+        return NULL;
+
+    // split the block if the rest of it is big enough to be used later on
+    large_block_t *next = block->next;
+    if (block->header.size >= size + sizeof(block_header_t) + MAX_SMALL_SIZE) {
+        large_block_t *rest = (large_block_t *)((uint32_t)block + sizeof(block_header_t) + size);
+        rest->header.size = block->header.size - size - sizeof(block_header_t);
+        rest->header.size_class = LARGE_CLASS;
+        rest->next = next;
+        next = rest;
+        block->header.size = size;
+    }
+    if (prev != NULL)
+        prev->next = next;
+    else
+        state.large_blocks = next;
+    return block;
+}
+
+static void *malloc_large(uint32_t size) {
+    large_block_t *block = find_large_block(size);
+    if (block == NULL) {
+        uint32_t grow_by = size + sizeof(block_header_t);
+        if (grow_by < CHUNK_SIZE)
+            grow_by = CHUNK_SIZE;
+        uint32_t start = grow_heap(grow_by);
+        if (start == 0)
+            return NULL;
+        block = (large_block_t *)start;
+        block->header.size = state.heap_end - start - sizeof(block_header_t);
+        block->header.size_class = LARGE_CLASS;
+        insert_large_block(block);
+        if ((block = find_large_block(size)) == NULL)
+            return NULL;
+    }
+    return &block->header + 1;
+}
+
+void *malloc(uint32_t size) {
+    void *addr;
+    if (size == 0)
+        size = 1;
+
+    mutex_lock(&state.lock);
+    if (size <= MAX_SMALL_SIZE)
+        addr = malloc_small(get_size_class(size));
+    else
+        addr = malloc_large((size + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+    mutex_unlock(&state.lock);
+    return addr;
+}
+
+void free(void *addr) {
+    if (addr == NULL)
+        return;
+    block_header_t *header = (block_header_t *)addr - 1;
+
+    mutex_lock(&state.lock);
+    if (header->size_class < LARGE_CLASS) {
+        free_block_t *block = (free_block_t *)addr;
+        block->next = state.free_lists[header->size_class];
+        state.free_lists[header->size_class] = block;
+    } else {
+        insert_large_block((large_block_t *)header);
+        trim_heap();
+    }
+    mutex_unlock(&state.lock);
+}
+
+static uint8_t grow_large_block(large_block_t *block, uint32_t size) {
+    // a large block can grow in place if it's followed by a free block that's big enough
+    large_block_t *prev = NULL;
+    large_block_t *next = state.large_blocks;
+    while (next != NULL && (uint32_t)next < block_end(block)) {
+        prev = next;
+        next = next->next;
+    }
+    if (next != NULL && (uint32_t)next == block_end(block) &&
+        block->header.size + sizeof(block_header_t) + next->header.size >= size) {
+        if (prev != NULL)
+            prev->next = next->next;
+        else
+            state.large_blocks = next->next;
+        block->header.size += sizeof(block_header_t) + next->header.size;
+    } else if (block_end(block) == state.heap_end && brk(0) == state.heap_end) {
+        // or if it's the last block of the heap (the heap grows right behind it)
+        if (grow_heap(size - block->header.size) == 0)
+            return 1;
+        block->header.size = state.heap_end - (uint32_t)block - sizeof(block_header_t);
+    } else {
+        return 1;
+    }
+
+    // give back whatever is left over
+    if (block->header.size >= size + sizeof(block_header_t) + MAX_SMALL_SIZE) {
+        large_block_t *rest = (large_block_t *)((uint32_t)block + sizeof(block_header_t) + size);
+        rest->header.size = block->header.size - size - sizeof(block_header_t);
+        rest->header.size_class = LARGE_CLASS;
+        block->header.size = size;
+        insert_large_block(rest);
+    }
+    return 0;
+}
+
+void *realloc(void *addr, uint32_t size) {
+    if (addr == NULL)
+        return malloc(size);
+    if (size == 0) {
+        free(addr);
+        return NULL;
+    }
+    block_header_t *header = (block_header_t *)addr - 1;
+
+    // the block may already be big enough (e.g. the size class is rounded up)
+    if (header->size >= size)
+        return addr;
+
+    mutex_lock(&state.lock);
+    uint8_t moved = header->size_class < LARGE_CLASS ||
+                    grow_large_block((large_block_t *)header, (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1)) != 0;
+    mutex_unlock(&state.lock);
+    if (moved == 0)
+        return addr;
+
+    void *new_addr = malloc(size);
+    if (new_addr == NULL)
+        return NULL;
+    memcpy(new_addr, addr, header->size);
+    free(addr);
+    return new_addr;
+}
+
+void *calloc(uint32_t count, uint32_t size) {
+    // make sure count * size does not overflow
+    if (size != 0 && count > 0xFFFFFFFF / size)
+        return NULL;
+    void *addr = malloc(count * size);
+    if (addr != NULL)
+        memset(addr, 0, count * size);
+    return addr;
+}
@@ -0,0 +1,24 @@
+#include <ring.h>
+
+ring_sqe_t *ring_get_sqe(ring_t *ring) {
+    // the entry is not seen by the kernel until ring_submit() has been called
+    if (ring->sq_tail - ring->sq_head == RING_ENTRIES)
+        return 0;
+    return &ring->sqes[ring->sq_tail % RING_ENTRIES];
+}
+
+void ring_submit(ring_t *ring) {
+    // the entry must be filled in before the kernel gets to see it
+    __sync_synchronize();
+    ring->sq_tail++;
+}
+
+ring_cqe_t *ring_peek_cqe(ring_t *ring) {
+    if (ring->cq_head == ring->cq_tail)
+        return 0;
+    return &ring->cqes[ring->cq_head % RING_ENTRIES];
+}
+
+void ring_cqe_seen(ring_t *ring) {
+    ring->cq_head++;
+}
@@ -22,4 +22,26 @@ spin_acquire:
 spinlock_release:
     mov eax, [esp + 4]       ; retrieve the address we wanna use as a lock
     mov dword [eax], 0       ; release the lock
-    ret                      ; lock is successfully released
\ No newline at end of file
+    ret                      ; lock is successfully released
+
+[global atomic_cmpxchg]
+atomic_cmpxchg:
+    mov edx, [esp + 4]       ; retrieve the address of the value
+    mov eax, [esp + 8]       ; value we expect to be there
+    mov ecx, [esp + 12]      ; value we wanna store there
+    lock cmpxchg [edx], ecx  ; store it only if the current value is the expected one
+    ret                      ; eax = previous value
+
+[global atomic_xchg]
+atomic_xchg:
+    mov edx, [esp + 4]       ; retrieve the address of the value
+    mov eax, [esp + 8]       ; value we wanna store there
+    xchg [edx], eax          ; swap them (xchg is always locked)
+    ret                      ; eax = previous value
+
+[global atomic_add]
+atomic_add:
+    mov edx, [esp + 4]       ; retrieve the address of the value
+    mov eax, [esp + 8]       ; value we wanna add to it
+    lock xadd [edx], eax     ; add it
+    ret                      ; eax = previous value
@@ -31,6 +31,14 @@ uint32_t strcmp(const char* str1, const char* str2, uint32_t n) {
     return str1[i] - str2[i];
 }
 
+uint32_t hash_string(const char *str) {
+    // djb2 (http://www.cse.yorku.ca/~oz/hash.html)
+    uint32_t hash = 5381;
+    while (*str != '\0')
+        hash = hash * 33 + (uint8_t)*str++;
+    return hash;
+}
+
 char* strncat(char* s1, const char* s2, uint32_t n)
 {
     // Pointer should not null pointer
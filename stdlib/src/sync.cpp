@@ -0,0 +1,91 @@
+#include <sync.h>
+#include <system.h>
+#include <spinlock.h>
+
+// https://www.akkadia.org/drepper/futex.pdf (mutex, take 2)
+
+#define FUTEX_WAKE_ALL 0xFFFFFFFF
+
+void mutex_init(mutex_t *mutex) {
+    mutex->state = MUTEX_UNLOCKED;
+}
+
+static void mutex_lock_contended(mutex_t *mutex) {
+    // we cannot tell whether there are other threads waiting,
+    // so we have to assume so when we eventually get the mutex
+    while (atomic_xchg(&mutex->state, MUTEX_CONTENDED) != MUTEX_UNLOCKED)
+        futex_wait(&mutex->state, MUTEX_CONTENDED);
+}
+
+void mutex_lock(mutex_t *mutex) {
+    if (atomic_cmpxchg(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED) != MUTEX_UNLOCKED)
+        mutex_lock_contended(mutex);
+}
+
+int mutex_trylock(mutex_t *mutex) {
+    return atomic_cmpxchg(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED) != MUTEX_UNLOCKED;
+}
+
+void mutex_unlock(mutex_t *mutex) {
+    if (atomic_xchg(&mutex->state, MUTEX_UNLOCKED) == MUTEX_CONTENDED)
+        futex_wake(&mutex->state, 1);
+}
+
+void condvar_init(condvar_t *cond) {
+    cond->seq = 0;
+    cond->waiters = 0;
+}
+
+void condvar_wait(condvar_t *cond, mutex_t *mutex) {
+    // a signal sent after we've read the sequence number changes it,
+    // so futex_wait() returns right away instead of missing it
+    atomic_add(&cond->waiters, 1);
+    uint32_t seq = cond->seq;
+    mutex_unlock(mutex);
+    futex_wait(&cond->seq, seq);
+    atomic_add(&cond->waiters, (uint32_t)-1);
+    mutex_lock_contended(mutex);
+}
+
+void condvar_signal(condvar_t *cond) {
+    atomic_add(&cond->seq, 1);
+    if (cond->waiters != 0)
+        futex_wake(&cond->seq, 1);
+}
+
+void condvar_broadcast(condvar_t *cond) {
+    atomic_add(&cond->seq, 1);
+    if (cond->waiters != 0)
+        futex_wake(&cond->seq, FUTEX_WAKE_ALL);
+}
+
+void semaphore_init(semaphore_t *sem, uint32_t value) {
+    sem->value = value;
+    sem->waiters = 0;
+}
+
+int semaphore_trywait(semaphore_t *sem) {
+    uint32_t value = sem->value;
+    while (value != 0) {
+        uint32_t prev = atomic_cmpxchg(&sem->value, value, value - 1);
+        if (prev == value)
+            return 0;
+        value = prev;
+    }
+    return 1;
+}
+
+void semaphore_wait(semaphore_t *sem) {
+    while (semaphore_trywait(sem) != 0) {
+        // if the value has been increased in the meantime, futex_wait() returns right away
+        atomic_add(&sem->waiters, 1);
+        futex_wait(&sem->value, 0);
+        atomic_add(&sem->waiters, (uint32_t)-1);
+    }
+}
+
+void semaphore_post(semaphore_t *sem) {
+    atomic_add(&sem->value, 1);
+    if (sem->waiters != 0)
+        futex_wake(&sem->value, 1);
+}
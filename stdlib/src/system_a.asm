@@ -19,20 +19,6 @@ read_line:
     int     0x80            ; call the interrupt (0x80 = system calls)
     ret                     ; return
 
-[global malloc]
-malloc:
-    mov     ebx, [esp + 4]  ; ebx = number of bytes to be allocated
-    mov     eax, 103        ; 103 = system call number (malloc)
-    int     0x80            ; call the interrupt (0x80 = system calls)
-    ret                     ; return
-
-[global free]
-free:
-    mov     ebx, [esp + 4]  ; ebx = address to the mem we want to free
-    mov     eax, 104        ; 104 = system call number (free)
-    int     0x80            ; call the interrupt (0x80 = system calls)
-    ret                     ; return
-
 [global get_pid]
 get_pid:
     mov     eax, 105        ; 105 = system call number (get_pid)
@@ -95,6 +81,7 @@ touch:
 
 [global ls]
 ls:
+    mov     ebx, [esp + 4]   ; ebx = path of the directory ("" = the root dir)
     mov     eax, 114         ; 114 = system call number (ls)
     int     0x80             ; call the interrupt (0x80 = system calls)
     ret                      ; return
@@ -180,4 +167,190 @@ set_cursor_command:
     mov     ecx, [esp + 8]   ; ecx = screen y axis
     mov     eax, 126         ; 126 = system call number (set cursor)
     int     0x80             ; call the interrupt (0x80 = system calls)
-    ret                      ; return
\ No newline at end of file
+    ret                      ; return
+
+[global thread_create]
+thread_create:
+    mov     ebx, thread_start ; ebx = entry point of the new thread
+    mov     ecx, [esp + 4]   ; ecx = function to be run by the thread
+    mov     edx, [esp + 8]   ; edx = argument of the function
+    mov     eax, 127         ; 127 = system call number (thread_create)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global thread_join]
+thread_join:
+    mov     ebx, [esp + 4]   ; ebx = thread's id
+    mov     eax, 128         ; 128 = system call number (thread_join)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global futex_wait]
+futex_wait:
+    mov     ebx, [esp + 4]   ; ebx = address of the futex
+    mov     ecx, [esp + 8]   ; ecx = value the futex is expected to hold
+    mov     eax, 129         ; 129 = system call number (futex_wait)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global futex_wake]
+futex_wake:
+    mov     ebx, [esp + 4]   ; ebx = address of the futex
+    mov     ecx, [esp + 8]   ; ecx = max number of threads to be woken up
+    mov     eax, 130         ; 130 = system call number (futex_wake)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global pipe]
+pipe:
+    mov     ebx, [esp + 4]   ; ebx = array of two fds (read end, write end)
+    mov     eax, 131         ; 131 = system call number (pipe)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global fd_read]
+fd_read:
+    mov     ebx, [esp + 4]   ; ebx = fd
+    mov     ecx, [esp + 8]   ; ecx = buffer
+    mov     edx, [esp + 12]  ; edx = max number of bytes to be read
+    mov     eax, 132         ; 132 = system call number (fd_read)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global fd_write]
+fd_write:
+    mov     ebx, [esp + 4]   ; ebx = fd
+    mov     ecx, [esp + 8]   ; ecx = buffer
+    mov     edx, [esp + 12]  ; edx = number of bytes to be written
+    mov     eax, 133         ; 133 = system call number (fd_write)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global fd_close]
+fd_close:
+    mov     ebx, [esp + 4]   ; ebx = fd
+    mov     eax, 134         ; 134 = system call number (fd_close)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global dup2]
+dup2:
+    mov     ebx, [esp + 4]   ; ebx = fd to be duplicated
+    mov     ecx, [esp + 8]   ; ecx = fd it's going to be duplicated into
+    mov     eax, 135         ; 135 = system call number (dup2)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global mq_open]
+mq_open:
+    mov     ebx, [esp + 4]   ; ebx = name of the queue
+    mov     eax, 136         ; 136 = system call number (mq_open)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global mq_send]
+mq_send:
+    mov     ebx, [esp + 4]   ; ebx = id of the queue
+    mov     ecx, [esp + 8]   ; ecx = message
+    mov     edx, [esp + 12]  ; edx = length of the message
+    mov     eax, 137         ; 137 = system call number (mq_send)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global mq_receive]
+mq_receive:
+    mov     ebx, [esp + 4]   ; ebx = id of the queue
+    mov     ecx, [esp + 8]   ; ecx = buffer
+    mov     edx, [esp + 12]  ; edx = size of the buffer
+    mov     eax, 138         ; 138 = system call number (mq_receive)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global uptime]
+uptime:
+    mov     eax, 139         ; 139 = system call number (uptime)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global poll]
+poll:
+    mov     ebx, [esp + 4]   ; ebx = entries
+    mov     ecx, [esp + 8]   ; ecx = number of entries
+    mov     edx, [esp + 12]  ; edx = timeout in ms
+    mov     eax, 140         ; 140 = system call number (poll)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global sleep]
+sleep:
+    mov     ebx, 0           ; ebx = no entries
+    mov     ecx, 0           ; ecx = number of entries
+    mov     edx, [esp + 4]   ; edx = timeout in ms
+    mov     eax, 140         ; 140 = system call number (poll)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global ring_setup]
+ring_setup:
+    mov     ebx, [esp + 4]   ; ebx = ring shared with the kernel
+    mov     eax, 141         ; 141 = system call number (ring_setup)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global ring_enter]
+ring_enter:
+    mov     eax, 142         ; 142 = system call number (ring_enter)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global brk]
+brk:
+    mov     ebx, [esp + 4]   ; ebx = new end of the heap (0 = just query it)
+    mov     eax, 143         ; 143 = system call number (brk)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global fd_open]
+fd_open:
+    mov     ebx, [esp + 4]   ; ebx = name of the file
+    mov     eax, 144         ; 144 = system call number (fd_open)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global lseek]
+lseek:
+    mov     ebx, [esp + 4]   ; ebx = fd
+    mov     ecx, [esp + 8]   ; ecx = offset
+    mov     edx, [esp + 12]  ; edx = what the offset is relative to (SEEK_SET, SEEK_CUR, SEEK_END)
+    mov     eax, 145         ; 145 = system call number (lseek)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global mkdir]
+mkdir:
+    mov     ebx, [esp + 4]   ; ebx = path of the directory
+    mov     eax, 146         ; 146 = system call number (mkdir)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global rmdir]
+rmdir:
+    mov     ebx, [esp + 4]   ; ebx = path of the directory
+    mov     eax, 147         ; 147 = system call number (rmdir)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+[global sync]
+sync:
+    mov     eax, 148         ; 148 = system call number (sync)
+    int     0x80             ; call the interrupt (0x80 = system calls)
+    ret                      ; return
+
+; the kernel starts a new thread here as if it was called as thread_start(fce, arg)
+thread_start:
+    mov     eax, [esp + 4]   ; eax = function to be run by the thread
+    push    dword [esp + 8]  ; pass the argument to the function
+    call    eax              ; run the function
+    add     esp, 4
+    push    dword 0          ; the thread terminates with exit code 0
+    call    exit
@@ -1,12 +1,16 @@
 #!/bin/bash
 
+# every program is linked on its own and packed into the initrd
+# GRUB loads as a module (the kernel doesn't have to be linked again)
+mkdir -p initrd
 for file in programs/*.cpp; do
     name=$(basename -- "$file")
     name="${name%.*}"
     
     cp programs/$name.cpp ./ && \
-    make $name.bin.h &&         \
-    mv $name.bin.h programs/ && \
-    rm *.bin *.o $name.cpp   && \
-    sed -i "s/crt0_bin/$name\_bin/" programs/$name.bin.h
-done
\ No newline at end of file
+    make crt0.bin &&            \
+    mv crt0.bin initrd/$name.exe && \
+    rm -f *.bin *.o $name.cpp
+done
+
+cd initrd && tar --format=ustar -cf ../initrd.tar *.exe
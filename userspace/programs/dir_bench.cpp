@@ -0,0 +1,77 @@
+#include <system.h>
+#include <string.h>
+
+#define FILES   10000
+#define BATCHES 5
+#define DIR     "dir_bench"
+
+static void get_filename(char *filename, uint32_t index) {
+    strcpy(filename, DIR "/f");
+    itoa_dec(&filename[strlen(filename)], index);
+}
+
+// creates the files one batch after another, so it's visible
+// whether creating a file gets slower as the directory grows
+static uint32_t create_files(uint32_t *batch_ms) {
+    char filename[32];
+    uint32_t files = 0;
+    uint32_t i, j;
+    for (i = 0; i < BATCHES; i++) {
+        uint32_t start = uptime();
+        for (j = 0; j < FILES / BATCHES; j++) {
+            get_filename(filename, files);
+            if (touch(filename) != 0)
+                break;
+            files++;
+        }
+        batch_ms[i] = uptime() - start;
+    }
+    return files;
+}
+
+// each lookup resolves the whole path
+static uint32_t look_up_files(uint32_t files) {
+    char filename[32];
+    uint32_t start = uptime();
+    uint32_t i;
+    for (i = 0; i < files; i++) {
+        get_filename(filename, i);
+        int fd = fd_open(filename);
+        if (fd >= 0)
+            fd_close(fd);
+    }
+    return uptime() - start;
+}
+
+static uint32_t delete_files(uint32_t files) {
+    char filename[32];
+    uint32_t start = uptime();
+    uint32_t i;
+    for (i = 0; i < files; i++) {
+        get_filename(filename, i);
+        rm(filename);
+    }
+    return uptime() - start;
+}
+
+int main() {
+    const char *ERROR = "could not create the directory\n\r";
+    const char *BATCH = "files %d - %d created in %d ms\n\r";
+    const char *RESULT = "%d files looked up in %d ms, deleted in %d ms\n\r";
+    uint32_t batch_ms[BATCHES];
+    uint32_t i;
+
+    if (mkdir(DIR) != 0) {
+        printf(ERROR);
+        return 1;
+    }
+    uint32_t files = create_files(batch_ms);
+    uint32_t lookup_ms = look_up_files(files);
+    uint32_t delete_ms = delete_files(files);
+    rmdir(DIR);
+
+    for (i = 0; i < BATCHES; i++)
+        printf(BATCH, i * (FILES / BATCHES), (i + 1) * (FILES / BATCHES) - 1, batch_ms[i]);
+    printf(RESULT, files, lookup_ms, delete_ms);
+    return 0;
+}
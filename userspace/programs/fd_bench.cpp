@@ -0,0 +1,82 @@
+#include <system.h>
+#include <string.h>
+#include <memory.h>
+
+#define CHUNK_SIZE 256
+#define CHUNKS     512
+
+static void print_result(const char *label, uint32_t ms) {
+    const char *RESULT = "%s: %d x %dB in %d ms\n\r";
+    printf(RESULT, label, CHUNKS, CHUNK_SIZE, ms);
+}
+
+// every call passes the name of the file and an offset, so the kernel looks the file up each time
+static void bench_names(char *filename, char *buffer) {
+    uint32_t start = uptime();
+    uint32_t i;
+    for (i = 0; i < CHUNKS; i++)
+        write(filename, buffer, i * CHUNK_SIZE, CHUNK_SIZE);
+    print_result("write by name", uptime() - start);
+
+    start = uptime();
+    for (i = 0; i < CHUNKS; i++)
+        read(filename, buffer, i * CHUNK_SIZE, CHUNK_SIZE);
+    print_result("read by name", uptime() - start);
+}
+
+// the descriptor remembers the position as well as where the file is
+static void bench_fd(int fd, char *buffer) {
+    uint32_t start = uptime();
+    uint32_t i;
+    for (i = 0; i < CHUNKS; i++)
+        fd_write(fd, buffer, CHUNK_SIZE);
+    print_result("fd_write", uptime() - start);
+
+    lseek(fd, 0, SEEK_SET);
+    start = uptime();
+    for (i = 0; i < CHUNKS; i++)
+        fd_read(fd, buffer, CHUNK_SIZE);
+    print_result("fd_read", uptime() - start);
+}
+
+int main() {
+    const char *ERROR = "could not open the file\n\r";
+    const char *SIZE = "size of the file: %d B\n\r";
+    const char *TMPFS = "tmpfs:\n\r";
+    char filename[16];
+    char buffer[CHUNK_SIZE];
+
+    strcpy(filename, "fd_bench.dat");
+    memset(buffer, 'x', CHUNK_SIZE);
+    touch(filename);
+
+    if (open(filename) != 0) {
+        printf(ERROR);
+        return 1;
+    }
+    bench_names(filename, buffer);
+    close(filename);
+
+    int fd = fd_open(filename);
+    if (fd < 0) {
+        printf(ERROR);
+        return 1;
+    }
+    bench_fd(fd, buffer);
+    printf(SIZE, lseek(fd, 0, SEEK_END));
+    fd_close(fd);
+    rm(filename);
+
+    // the same once again with the file kept in the tmpfs
+    printf(TMPFS);
+    strcpy(filename, "tmp/fd_bench");
+    touch(filename);
+    if ((fd = fd_open(filename)) < 0) {
+        printf(ERROR);
+        return 1;
+    }
+    bench_fd(fd, buffer);
+    fd_close(fd);
+    rm(filename);
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <system.h>
+#include <string.h>
+
+#define ROUNDS 3
+
+static void get_filename(char *filename, uint32_t index) {
+    strcpy(filename, "fs_bench_");
+    itoa_dec(&filename[9], index);
+}
+
+// creates empty files until the file system runs out of clusters
+static uint32_t fill(uint32_t *files) {
+    char filename[16];
+    uint32_t start = uptime();
+    *files = 0;
+    while (1) {
+        get_filename(filename, *files);
+        if (touch(filename) != 0)
+            break;
+        (*files)++;
+    }
+    return uptime() - start;
+}
+
+// deletes all the files again
+static uint32_t drain(uint32_t files) {
+    char filename[16];
+    uint32_t start = uptime();
+    uint32_t i;
+    for (i = 0; i < files; i++) {
+        get_filename(filename, i);
+        rm(filename);
+    }
+    return uptime() - start;
+}
+
+int main() {
+    const char *RESULT = "round %d: %d files created in %d ms, deleted in %d ms\n\r";
+    uint32_t files[ROUNDS];
+    uint32_t fill_ms[ROUNDS];
+    uint32_t drain_ms[ROUNDS];
+    int i;
+
+    // nothing can be printed out while the file system is full
+    // (stdout is a file as well), so the results are printed at the end
+    for (i = 0; i < ROUNDS; i++) {
+        fill_ms[i] = fill(&files[i]);
+        drain_ms[i] = drain(files[i]);
+    }
+    for (i = 0; i < ROUNDS; i++)
+        printf(RESULT, i + 1, files[i], fill_ms[i], drain_ms[i]);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <system.h>
+
+#define ROUNDS     5000
+#define SMALL_SIZE 64
+#define PAGE_SIZE  4096
+
+// the child echoes every message back until it receives an empty one
+static void echo(int ping, int pong, char *page) {
+    int len;
+    while ((len = mq_receive(ping, page, PAGE_SIZE)) > 0)
+        mq_send(pong, page, len);
+}
+
+static uint32_t ping_pong(int ping, int pong, char *page, uint32_t len) {
+    uint32_t start = uptime();
+    int i;
+    for (i = 0; i < ROUNDS; i++) {
+        mq_send(ping, page, len);
+        mq_receive(pong, page, PAGE_SIZE);
+    }
+    return uptime() - start;
+}
+
+static void print_result(const char *label, uint32_t ms) {
+    const char *RESULT = "%s: %d msgs/s (%d round trips in %d ms)\n\r";
+    if (ms == 0)
+        ms = 1;
+    printf(RESULT, label, 2 * ROUNDS * 1000 / ms, ROUNDS, ms);
+}
+
+int main() {
+    const char *OPEN_ERR = "error when opening the queues!\n\r";
+    const char *SMALL = "copied (64B)";
+    const char *PAGES = "remapped (4KB)";
+
+    // pages are moved only if they're page-aligned
+    char *mem = (char *)malloc(2 * PAGE_SIZE);
+    char *page = (char *)(((uint32_t)mem + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+
+    int ping = mq_open("bench_ping");
+    int pong = mq_open("bench_pong");
+    if (ping < 0 || pong < 0) {
+        printf(OPEN_ERR);
+        return 1;
+    }
+
+    int pid = fork();
+    if (pid == 0) {
+        echo(ping, pong, page);
+        return 0;
+    }
+
+    print_result(SMALL, ping_pong(ping, pong, page, SMALL_SIZE));
+    print_result(PAGES, ping_pong(ping, pong, page, PAGE_SIZE));
+
+    mq_send(ping, page, 0);
+    wait_for_child(pid);
+    free(mem);
+    return 0;
+}
@@ -4,6 +4,10 @@
 #define BLACK 0x00
 #define GREEN_FG 0x02
 #define GREENLIGHT_FG 0x0A
+#define WHITE_FG 0x0F
+
+#define FRAME_DELAY_MS 80
+#define LINE_SIZE 64
 
 static uint32_t next = 1;
 
@@ -62,10 +66,6 @@ void update_all_columns(int width, int height, int *y)
         // increment y
         y[x] = inScreenYPosition(y[x] + 1, height);
     }
-
-    for(volatile int i = 0; i < 0x8000000; i++){
-        ;
-    }
 }
 
 int main()
@@ -84,10 +84,24 @@ int main()
         y[x] = rand() % height;
     }
 
+    // wait for the next frame, unless something has been typed in ("q" quits)
+    poll_entry_t input;
+    input.type = POLL_KEYBOARD;
+    input.id = 0;
+    char line[LINE_SIZE];
+
     while (true)
     {
         update_all_columns(width, height, y);
+        if (poll(&input, 1, FRAME_DELAY_MS) > 0)
+        {
+            read_line(line);
+            if (strcmp(line, "q") == 0)
+                break;
+        }
     }
 
+    color_screen_command(WHITE_FG, BLACK);
+    clear_screen_command();
     return 0;
 }
\ No newline at end of file
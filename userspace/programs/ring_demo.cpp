@@ -0,0 +1,97 @@
+#include <system.h>
+#include <ring.h>
+
+#define WRITES 2000
+
+// reaps all completions posted so far, returns how many of them failed
+static uint32_t reap(ring_t *ring, uint32_t *reaped) {
+    uint32_t failed = 0;
+    ring_cqe_t *cqe;
+    while ((cqe = ring_peek_cqe(ring)) != 0) {
+        if (cqe->result != 0)
+            failed++;
+        (*reaped)++;
+        ring_cqe_seen(ring);
+    }
+    return failed;
+}
+
+static uint32_t append_with_syscalls(char *filename, char *text) {
+    uint32_t start = uptime();
+    int i;
+    for (i = 0; i < WRITES; i++)
+        file_append(filename, text);
+    return uptime() - start;
+}
+
+static uint32_t append_with_ring(ring_t *ring, char *filename, char *text, uint32_t *traps, uint32_t *failed) {
+    uint32_t start = uptime();
+    uint32_t submitted = 0;
+    uint32_t reaped = 0;
+
+    // fill up the ring and let the kernel go through all of it at once
+    while (reaped < WRITES) {
+        ring_sqe_t *sqe;
+        while (submitted < WRITES && (sqe = ring_get_sqe(ring)) != 0) {
+            sqe->op = RING_OP_APPEND;
+            sqe->user_data = submitted++;
+            sqe->args[0] = (uint32_t)filename;
+            sqe->args[1] = (uint32_t)text;
+            sqe->args[2] = 1;
+            ring_submit(ring);
+        }
+        ring_enter();
+        (*traps)++;
+        *failed += reap(ring, &reaped);
+    }
+    return uptime() - start;
+}
+
+static void print_result(const char *label, uint32_t traps, uint32_t ms) {
+    const char *RESULT = "%s: %d appends, %d traps, %d ms\n\r";
+    printf(RESULT, label, WRITES, traps, ms);
+}
+
+int main() {
+    const char *SETUP_ERR = "error when setting up the ring!\n\r";
+    const char *FAILED = "%d appends failed!\n\r";
+    const char *TICK = "completed by the timer tick after %d ms (no ring_enter)\n\r";
+    char SYS_FILE[] = "ring_sys.txt";
+    char RING_FILE[] = "ring_io.txt";
+    char TEXT[] = "x";
+
+    ring_t *ring = (ring_t *)malloc(sizeof(ring_t));
+    if (ring == 0 || ring_setup(ring) != 0) {
+        printf(SETUP_ERR);
+        return 1;
+    }
+    rm(SYS_FILE);
+    rm(RING_FILE);
+
+    print_result("file_append()", WRITES, append_with_syscalls(SYS_FILE, TEXT));
+
+    uint32_t traps = 0;
+    uint32_t failed = 0;
+    uint32_t ms = append_with_ring(ring, RING_FILE, TEXT, &traps, &failed);
+    print_result("ring", traps, ms);
+    if (failed != 0)
+        printf(FAILED, failed);
+
+    // queue up one more append and just wait for the kernel to pick it up on its own
+    ring_sqe_t *sqe = ring_get_sqe(ring);
+    sqe->op = RING_OP_APPEND;
+    sqe->user_data = WRITES;
+    sqe->args[0] = (uint32_t)RING_FILE;
+    sqe->args[1] = (uint32_t)TEXT;
+    sqe->args[2] = 1;
+    uint32_t start = uptime();
+    ring_submit(ring);
+    while (ring_peek_cqe(ring) == 0)
+        ;
+    printf(TICK, uptime() - start);
+    ring_cqe_seen(ring);
+
+    ring_setup(0);
+    free(ring);
+    return 0;
+}
@@ -6,18 +6,23 @@
 #define BUFFER_SIZE 256
 
 void printHelp();
+int runPipeline(char *line);
 
 int main() {
     const char *prompt = "C:/> ";
     const char *HELP = "help";
     const char *PS = "ps";
     const char *LS = "ls";
+    const char *LS_DIR = "ls ";
     const char *LP = "lp";
     const char *EXEC = "./";
     const char *KILL = "kill";
     const char *TOUCH = "touch";
     const char *CAT = "cat";
     const char *RM = "rm";
+    const char *MKDIR = "mkdir";
+    const char *RMDIR = "rmdir";
+    const char *SYNC = "sync";
     const char *CLEAR = "clear";
     const char *LAST_EXIT_CODE = "$?";
     const char *EXIT = "exit";
@@ -29,6 +34,10 @@ int main() {
     const char *FILE_CREATE_ERR = "File (%s) cannot be created!\n\r";
     const char *FILE_NOT_FOUND_ERR = "File (%s) not found!\n\r";
     const char *FILE_REMOVE_ERR = "File (%s) cannot be removed!\n\r";
+    const char *DIR_NOT_FOUND_ERR = "Directory (%s) not found!\n\r";
+    const char *DIR_CREATE_ERR = "Directory (%s) cannot be created!\n\r";
+    const char *DIR_REMOVE_ERR = "Directory (%s) cannot be removed (it must be empty)!\n\r";
+    const char *SYNC_ERR = "The file system cannot be written to the disk!\n\r";
 
     const char *PRINT_DECIMAL = "%d\n\r";
     const char *PRINT_STRING = "%s\n\r";
@@ -44,13 +53,20 @@ int main() {
         printf(prompt);
         read_line(buffer);
 
-        if (strcmp(buffer, HELP) == 0) {
+        if (runPipeline(buffer) == 0) {
+            // ./<program1> | ./<program2>
+        } else if (strcmp(buffer, HELP) == 0) {
             printHelp();
         }
         else if (strcmp(buffer, PS) == 0) {
             ps();
         } else if (strcmp(buffer, LS) == 0) {
-            ls();
+            ls("");
+        } else if (strcmp(buffer, LS_DIR, (uint32_t)strlen(LS_DIR)-1) == 0) {
+            char *dirName = buffer + strlen(LS_DIR);
+            if (ls(dirName) != 0){
+                printf(DIR_NOT_FOUND_ERR, dirName);
+            }
         } else if (strcmp(buffer, LP) == 0) {
             lp();
         } else if (strcmp(buffer, EXEC, (uint32_t)strlen(EXEC)-1) == 0) {
@@ -113,11 +129,25 @@ int main() {
                     }
                 }
             }
+        } else if (strcmp(buffer, MKDIR, (uint32_t)strlen(MKDIR)-1) == 0) {
+            char *dirName = buffer + strlen(MKDIR) + 1;
+            if (mkdir(dirName) != 0){
+                printf(DIR_CREATE_ERR, dirName);
+            }
+        } else if (strcmp(buffer, RMDIR, (uint32_t)strlen(RMDIR)-1) == 0) {
+            char *dirName = buffer + strlen(RMDIR) + 1;
+            if (rmdir(dirName) != 0){
+                printf(DIR_REMOVE_ERR, dirName);
+            }
         } else if (strcmp(buffer, RM, (uint32_t)strlen(RM)-1) == 0) {
             char *fileName = buffer + strlen(RM) + 1;
             if (rm(fileName) != 0){
                 printf(FILE_REMOVE_ERR, fileName);
             }
+        } else if (strcmp(buffer, SYNC) == 0) {
+            if (sync() != 0){
+                printf(SYNC_ERR);
+            }
         } else if (strcmp(buffer, CLEAR) == 0) {
             clear_screen_command();
         } else if (strcmp(buffer, LAST_EXIT_CODE) == 0) {
@@ -136,16 +166,73 @@ void printHelp(){
     printf("Available commands: \n\r");
     printf("> help              (Prints help) \n\r");
     printf("> ps                (Prints processes) \n\r");
-    printf("> ls                (Prints directory entities) \n\r");
+    printf("> ls [dir]          (Prints directory entities) \n\r");
     printf("> cp <src> <des>    (Copies file src into file des) \n\r");
     printf("> lp                (Prints available programs) \n\r");
     printf("> ./<program>       (Executes given program) \n\r");
+    printf("> ./<prog1> | ./<prog2>   (Pipes output of prog1 into prog2) \n\r");
     printf("> touch <file>      (Creates file) \n\r");
     printf("> echo \"<text>\"     (Prints text onto the screen) \n\r");
     printf("> echo \"<text>\" > <file>   (Echo into a file) \n\r");
     printf("> cat <file>        (Prints file) \n\r");
     printf("> rm <file>         (Removes file) \n\r");
+    printf("> mkdir <dir>       (Creates directory, e.g. docs/notes) \n\r");
+    printf("> rmdir <dir>       (Removes empty directory) \n\r");
+    printf("> sync              (Writes file system to disk) \n\r");
     printf("> clear             (Clears screen) \n\r");
     printf("> CTR+[1-4]         (Switches terminal) \n\r");
     printf("> exit              (Xxits shell) \n\r");
-}
\ No newline at end of file
+}
+
+static char *trimProgramName(char *name) {
+    uint32_t len;
+    while (*name == ' ')
+        name++;
+    if (name[0] == '.' && name[1] == '/')
+        name += 2;
+    for (len = strlen(name); len > 0 && name[len - 1] == ' '; len--)
+        name[len - 1] = '\0';
+    return name;
+}
+
+// returns 1 if the line is not a pipeline at all
+int runPipeline(char *line) {
+    char *separator;
+    for (separator = line; *separator && *separator != '|'; separator++)
+        ;
+    if (*separator == '\0')
+        return 1;
+
+    *separator = '\0';
+    char *writer = trimProgramName(line);
+    char *reader = trimProgramName(separator + 1);
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        printf("Pipe cannot be created!\n\r");
+        return 0;
+    }
+
+    // the children inherit the standard fds at the moment they're executed
+    dup2(fds[1], STDOUT);
+    int pidWriter = exec(writer);
+    fd_close(STDOUT);
+
+    dup2(fds[0], STDIN);
+    int pidReader = exec(reader);
+    fd_close(STDIN);
+
+    // the reader gets EOF only once every write end has been closed
+    fd_close(fds[0]);
+    fd_close(fds[1]);
+
+    if (pidWriter == 0)
+        printf("(%s) is not recognized as internal or external command\n\r", writer);
+    if (pidReader == 0)
+        printf("(%s) is not recognized as internal or external command\n\r", reader);
+    if (pidWriter != 0)
+        wait_for_child(pidWriter);
+    if (pidReader != 0)
+        wait_for_child(pidReader);
+    return 0;
+}
@@ -1,10 +1,64 @@
 #include <system.h>
 
-#define N 5
+#define N        5
+#define ROUNDS   100000
+#define BATCH    512
+
+static void print_result(const char *label, uint32_t ops, uint32_t ms) {
+    const char *RESULT = "%s: %d ops in %d ms (%d ops/ms)\n\r";
+    if (ms == 0)
+        ms = 1;
+    printf(RESULT, label, ops, ms, ops / ms);
+}
+
+// the same small block over and over again (served from the free list of its size class)
+static void bench_pairs() {
+    uint32_t start = uptime();
+    int i;
+    for (i = 0; i < ROUNDS; i++)
+        free(malloc(32));
+    print_result("malloc/free 32B", 2 * ROUNDS, uptime() - start);
+}
+
+// many blocks of different sizes alive at the same time
+static void bench_batches(const char *label, uint32_t min_size, uint32_t max_size) {
+    void *blocks[BATCH];
+    uint32_t seed = 42;
+    uint32_t start = uptime();
+    int i, j;
+    for (i = 0; i < ROUNDS / BATCH; i++) {
+        for (j = 0; j < BATCH; j++) {
+            seed = seed * 1103515245 + 12345;
+            blocks[j] = malloc(min_size + (seed >> 16) % (max_size - min_size + 1));
+        }
+        for (j = 0; j < BATCH; j++)
+            free(blocks[j]);
+    }
+    print_result(label, 2 * (ROUNDS / BATCH) * BATCH, uptime() - start);
+}
+
+// a buffer growing step by step (it mostly stays where it is)
+static void bench_realloc() {
+    const char *RESULT = "realloc 4KB..1MB: %d moves out of %d calls\n\r";
+    uint32_t moves = 0;
+    uint32_t calls = 0;
+    uint32_t size;
+    char *buffer = (char *)calloc(1, 4096);
+    for (size = 8192; size <= 1024 * 1024 && buffer != NULL; size += 4096) {
+        char *new_buffer = (char *)realloc(buffer, size);
+        if (new_buffer != buffer)
+            moves++;
+        buffer = new_buffer;
+        calls++;
+    }
+    free(buffer);
+    printf(RESULT, moves, calls);
+}
 
 int main() {
     const char *separator = "--------\n\r";
     const char *format = "0x%x %d\n\r";
+    const char *heap = "heap: %d KB\n\r";
 
     int *arr;
 
@@ -23,5 +77,14 @@ int main() {
         printf(format, &arr[i], arr[i]);
     }
     free(arr);
+
+    printf(separator);
+
+    uint32_t heap_start = (uint32_t)sbrk(0);
+    bench_pairs();
+    bench_batches("small 8-256B", 8, 256);
+    bench_batches("large 4-8KB", 4096, 8192);
+    bench_realloc();
+    printf(heap, ((uint32_t)sbrk(0) - heap_start) / 1024);
     return 0;
-}
\ No newline at end of file
+}
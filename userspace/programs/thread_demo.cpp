@@ -0,0 +1,46 @@
+#include <system.h>
+#include <sync.h>
+
+#define THREAD_COUNT 4
+#define ITERATIONS   1000000
+
+static int partial_sums[THREAD_COUNT];
+static int total;
+static mutex_t total_lock = MUTEX_INITIALIZER;
+
+static void worker(void *arg) {
+    int index = (int)arg;
+    int i;
+
+    // every thread works on its own slot of the (shared) array
+    for (i = 0; i < ITERATIONS; i++)
+        partial_sums[index] += i % (index + 2);
+
+    mutex_lock(&total_lock);
+    total += partial_sums[index];
+    mutex_unlock(&total_lock);
+}
+
+int main() {
+    const char *CREATE_ERR = "error when creating a thread!\n\r";
+    const char *RESULT = "thread %d: %d\n\r";
+    const char *TOTAL = "total: %d\n\r";
+
+    int tids[THREAD_COUNT];
+    int i;
+
+    for (i = 0; i < THREAD_COUNT; i++) {
+        tids[i] = thread_create(&worker, (void *)i);
+        if (tids[i] == 0) {
+            printf(CREATE_ERR);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < THREAD_COUNT; i++) {
+        thread_join(tids[i]);
+        printf(RESULT, tids[i], partial_sums[i]);
+    }
+    printf(TOTAL, total);
+    return 0;
+}
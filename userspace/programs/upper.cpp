@@ -0,0 +1,22 @@
+#include <system.h>
+#include <string.h>
+
+#define BUFF_SIZE 256
+
+// e.g. ./test_fork.exe | ./upper.exe
+int main() {
+    const char *PRINT_LINE = "%s\n\r";
+
+    char buff[BUFF_SIZE];
+    uint32_t i;
+
+    // read_line() returns 1 once the writer has closed the pipe
+    while (read_line(&buff[0]) == 0) {
+        for (i = 0; buff[i]; i++) {
+            if (buff[i] >= 'a' && buff[i] <= 'z')
+                buff[i] -= 'a' - 'A';
+        }
+        printf(PRINT_LINE, &buff[0]);
+    }
+    return 0;
+}